@@ -0,0 +1,69 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
+ */
+
+/* Client for the configurator admin socket (see prefix_config_admin_start()).
+
+     configurator_admin <socket> get <section>.<key>
+     configurator_admin <socket> set <section>.<key> <value>
+     configurator_admin <socket> origin <section>.<key>
+     configurator_admin <socket> list [<section>]
+     configurator_admin <socket> dump [text|ini|json|env]
+
+   Prints the reply to stdout, or the remote error to stderr (exiting 1). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configurator.h"
+
+#define ADMIN_MAX_REQUEST 4096
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    int i;
+    size_t len = 0;
+    size_t n;
+    char req[ADMIN_MAX_REQUEST];
+    char* reply = NULL;
+
+    if( argc < 3 ) {
+        fprintf(stderr,
+                "USAGE: %s <socket> get <section>.<key>\n"
+                "       %s <socket> set <section>.<key> <value>\n"
+                "       %s <socket> origin <section>.<key>\n"
+                "       %s <socket> list [<section>]\n"
+                "       %s <socket> dump [text|ini|json|env]\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 2;
+    }
+
+    // the request is the remaining arguments, separated by spaces
+    req[0] = '\0';
+    for( i=2; i < argc; i++ ) {
+        n = strlen(argv[i]);
+        if( (len + n + 2) > sizeof(req) ) {
+            fprintf(stderr, "%s: request too long\n", argv[0]);
+            return 2;
+        }
+        if( i > 2 )
+            req[len++] = ' ';
+        memcpy(req + len, argv[i], n + 1);
+        len += n;
+    }
+
+    rc = prefix_config_admin_query(argv[1], req, &reply, &len);
+    if( rc ) {
+        fprintf(stderr, "%s: %s\n", argv[0],
+                ((NULL != reply) && ('\0' != *reply)) ? reply : strerror(rc));
+        free(reply);
+        return 1;
+    }
+
+    fwrite(reply, 1, len, stdout);
+    free(reply);
+    return 0;
+}
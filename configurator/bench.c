@@ -0,0 +1,360 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
+ */
+
+/* Benchmark for configurator initialization and typed reads.
+
+   Build against a schema generated by bench_gen.bash (i.e., with
+   -DPREFIX_CONFIGS_HEADER="<base>.h"), then run as
+
+     configurator_bench_<N> [-l] [-n iterations] [-r read-rounds] [-f csv|json] <base>
+
+   where <base>.ini, <base>.json, <base>.env, and <base>.args are the files
+   produced by the generator. For each config file format, reports the
+   end-to-end prefix_config_init() latency, the time spent in each phase
+   (from a separate profiled pass), peak RSS, and the throughput of the
+   typed getters over all options. With -l, uses prefix_config_init_lazy(),
+   so validation cost moves from init to the first read of each option. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "configurator.h"
+
+#define BENCH_MAX_LINE 4096
+#define BENCH_MAX_ARGS 256
+
+static int lazy_init = 0;
+
+typedef struct {
+    const char* format;                        // config file format
+    unsigned iters;
+    double init_mean;                          // usecs
+    double init_min;
+    double init_p50;
+    double init_p99;
+    double init_max;
+    double phase[PREFIX_CFG_NUM_PHASES];       // usecs, mean of profiled runs
+    double reads_per_sec;
+    long peak_rss_kb;
+} bench_result_t;
+
+static unsigned long long now_nsecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int cmp_ull(const void* a,
+                   const void* b)
+{
+    unsigned long long x = *(const unsigned long long*) a;
+    unsigned long long y = *(const unsigned long long*) b;
+    return (x > y) - (x < y);
+}
+
+// open <base><ext>
+static FILE* open_input(const char* base,
+                        const char* ext)
+{
+    char path[BENCH_MAX_LINE];
+    FILE* fp;
+
+    snprintf(path, sizeof(path), "%s%s", base, ext);
+    fp = fopen(path, "r");
+    if( NULL == fp )
+        fprintf(stderr, "BENCH ERROR: failed to open %s - %s\n",
+                path, strerror(errno));
+    return fp;
+}
+
+// read next line without trailing newline, returns NULL at end of file
+static char* read_line(FILE* fp,
+                       char* buf,
+                       size_t len)
+{
+    size_t n;
+
+    if( NULL == fgets(buf, len, fp) )
+        return NULL;
+    n = strlen(buf);
+    if( n && ('\n' == buf[n-1]) )
+        buf[n-1] = '\0';
+    return buf;
+}
+
+// set environment from <base>.env
+static int load_env(const char* base)
+{
+    char line[BENCH_MAX_LINE];
+    char* eq;
+    FILE* fp = open_input(base, ".env");
+
+    if( NULL == fp )
+        return ENOENT;
+    while( NULL != read_line(fp, line, sizeof(line)) ) {
+        eq = strchr(line, '=');
+        if( NULL == eq )
+            continue;
+        *eq = '\0';
+        setenv(line, eq + 1, 1);
+    }
+    fclose(fp);
+    return 0;
+}
+
+// build argv from <base>.args, with room for "-c <file>" at the end
+static int load_args(const char* base,
+                     char** args,
+                     int* nargs)
+{
+    char line[BENCH_MAX_LINE];
+    FILE* fp = open_input(base, ".args");
+
+    if( NULL == fp )
+        return ENOENT;
+    args[(*nargs)++] = strdup("bench");
+    while( (*nargs < (BENCH_MAX_ARGS - 3))
+           && (NULL != read_line(fp, line, sizeof(line))) )
+        args[(*nargs)++] = strdup(line);
+    fclose(fp);
+    return 0;
+}
+
+static int init_once(prefix_cfg_t* cfg,
+                     int argc,
+                     char** argv)
+{
+    int rc;
+
+    if( lazy_init )
+        rc = prefix_config_init_lazy(cfg, argc, argv);
+    else
+        rc = prefix_config_init(cfg, argc, argv);
+    if( rc )
+        fprintf(stderr, "BENCH ERROR: prefix_config_init() failed - rc=%d (%s)\n",
+                rc, strerror(rc));
+    return rc;
+}
+
+// read every option through its typed getter
+static double read_all(const prefix_cfg_t* cfg)
+{
+    double sum = 0.0;
+
+#define BENCH_READ_BOOL(v)   sum += (v) ? 1.0 : 0.0;
+#define BENCH_READ_INT(v)    sum += (double) (v);
+#define BENCH_READ_FLOAT(v)  sum += (v);
+#define BENCH_READ_SIZE(v)   sum += (double) (v);
+#define BENCH_READ_DURATION(v) sum += (double) (v);
+#define BENCH_READ_ENUM(v)   sum += (double) (v);
+#define BENCH_READ_STRING(v) { const char* s = (v); if( NULL != s ) sum += s[0]; }
+
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) \
+    BENCH_READ_##typ(prefix_config_get_##sec##_##key(cfg))
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use) \
+    BENCH_READ_##typ(prefix_config_get_##sec##_##key(cfg))
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) \
+    sum += prefix_config_get_##sec##_##key(cfg)->count;
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
+    sum += prefix_config_get_##sec##_##key(cfg)->count;
+
+    PREFIX_CONFIGS;
+#undef PREFIX_CFG
+#undef PREFIX_CFG_CLI
+#undef PREFIX_CFG_MULTI
+#undef PREFIX_CFG_MULTI_CLI
+
+    return sum;
+}
+
+static int run_format(const char* base,
+                      const char* format,
+                      unsigned iters,
+                      unsigned rounds,
+                      char** args,
+                      int nargs,
+                      bench_result_t* res)
+{
+    int rc;
+    unsigned u, p;
+    char file[BENCH_MAX_LINE];
+    unsigned long long t;
+    unsigned long long* lat;
+    double total = 0.0;
+    volatile double sink = 0.0;
+    const prefix_cfg_profile_t* prof;
+    prefix_cfg_t cfg;
+    struct rusage ru;
+
+    memset((void*)res, 0, sizeof(*res));
+    res->format = format;
+    res->iters = iters;
+
+    snprintf(file, sizeof(file), "%s.%s", base, format);
+    args[nargs] = "-c";
+    args[nargs + 1] = file;
+    args[nargs + 2] = NULL;
+    nargs += 2;
+
+    lat = (unsigned long long*) calloc(iters, sizeof(*lat));
+    if( NULL == lat )
+        return ENOMEM;
+
+    // end-to-end latency, without profiling
+    prefix_config_profiling(false);
+    for( u=0; u < iters; u++ ) {
+        t = now_nsecs();
+        rc = init_once(&cfg, nargs, args);
+        lat[u] = now_nsecs() - t;
+        if( rc ) { free(lat); return rc; }
+        prefix_config_fini(&cfg);
+        total += lat[u];
+    }
+    qsort(lat, iters, sizeof(*lat), cmp_ull);
+    res->init_mean = (total / iters) / 1e3;
+    res->init_min = lat[0] / 1e3;
+    res->init_p50 = lat[iters / 2] / 1e3;
+    res->init_p99 = lat[(iters * 99) / 100] / 1e3;
+    res->init_max = lat[iters - 1] / 1e3;
+    free(lat);
+
+    // per-phase breakdown
+    prefix_config_profiling(true);
+    for( u=0; u < iters; u++ ) {
+        rc = init_once(&cfg, nargs, args);
+        if( rc ) return rc;
+        prof = prefix_config_profile(&cfg);
+        for( p=0; (NULL != prof) && (p < PREFIX_CFG_NUM_PHASES); p++ )
+            res->phase[p] += (prof->phase[p].nsecs / 1e3) / iters;
+        prefix_config_fini(&cfg);
+    }
+    prefix_config_profiling(false);
+
+    // typed read throughput
+    rc = init_once(&cfg, nargs, args);
+    if( rc ) return rc;
+    t = now_nsecs();
+    for( u=0; u < rounds; u++ )
+        sink += read_all(&cfg);
+    t = now_nsecs() - t;
+    prefix_config_fini(&cfg);
+    res->reads_per_sec = ((double) rounds * PREFIX_CFG_NUM_OPTIONS)
+                         / ((t ? t : 1) / 1e9);
+
+    getrusage(RUSAGE_SELF, &ru);
+    res->peak_rss_kb = ru.ru_maxrss;
+    return 0;
+}
+
+static const char* phase_fields[PREFIX_CFG_NUM_PHASES] = {
+    "defaults_us", "sysfile_us", "environ_us",
+    "cli_us", "clifile_us", "fragments_us", "validate_us"
+};
+
+static void print_csv(const bench_result_t* res,
+                      unsigned nres)
+{
+    unsigned u, p;
+
+    printf("options,format,iterations,init_mean_us,init_min_us,init_p50_us,"
+           "init_p99_us,init_max_us");
+    for( p=0; p < PREFIX_CFG_NUM_PHASES; p++ )
+        printf(",%s", phase_fields[p]);
+    printf(",reads_per_sec,peak_rss_kb\n");
+
+    for( u=0; u < nres; u++ ) {
+        printf("%d,%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f",
+               PREFIX_CFG_NUM_OPTIONS, res[u].format, res[u].iters,
+               res[u].init_mean, res[u].init_min, res[u].init_p50,
+               res[u].init_p99, res[u].init_max);
+        for( p=0; p < PREFIX_CFG_NUM_PHASES; p++ )
+            printf(",%.3f", res[u].phase[p]);
+        printf(",%.0f,%ld\n", res[u].reads_per_sec, res[u].peak_rss_kb);
+    }
+}
+
+static void print_json(const bench_result_t* res,
+                       unsigned nres)
+{
+    unsigned u, p;
+
+    printf("[\n");
+    for( u=0; u < nres; u++ ) {
+        printf("  {\"options\": %d, \"format\": \"%s\", \"iterations\": %u,"
+               " \"init_mean_us\": %.3f, \"init_min_us\": %.3f,"
+               " \"init_p50_us\": %.3f, \"init_p99_us\": %.3f,"
+               " \"init_max_us\": %.3f",
+               PREFIX_CFG_NUM_OPTIONS, res[u].format, res[u].iters,
+               res[u].init_mean, res[u].init_min, res[u].init_p50,
+               res[u].init_p99, res[u].init_max);
+        for( p=0; p < PREFIX_CFG_NUM_PHASES; p++ )
+            printf(", \"%s\": %.3f", phase_fields[p], res[u].phase[p]);
+        printf(", \"reads_per_sec\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+               res[u].reads_per_sec, res[u].peak_rss_kb,
+               (u + 1 < nres) ? "," : "");
+    }
+    printf("]\n");
+}
+
+static void usage(const char* arg0)
+{
+    fprintf(stderr, "USAGE: %s [-l] [-n iterations] [-r read-rounds] "
+            "[-f csv|json] <generated-base>\n", arg0);
+}
+
+int main(int argc, char* argv[])
+{
+    int c, rc;
+    unsigned u;
+    unsigned iters = 100;
+    unsigned rounds = 1000;
+    int json = 0;
+    int nargs = 0;
+    const char* base;
+    char* args[BENCH_MAX_ARGS];
+    const char* formats[] = { "ini", "json" };
+    bench_result_t res[2];
+
+    while( -1 != (c = getopt(argc, argv, "ln:r:f:")) ) {
+        switch( c ) {
+        case 'l': lazy_init = 1; break;
+        case 'n': iters = (unsigned) strtoul(optarg, NULL, 0); break;
+        case 'r': rounds = (unsigned) strtoul(optarg, NULL, 0); break;
+        case 'f': json = (0 == strcmp(optarg, "json")); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if( (optind != (argc - 1)) || (0 == iters) ) {
+        usage(argv[0]);
+        return 1;
+    }
+    base = argv[optind];
+
+    rc = load_env(base);
+    if( rc ) return 1;
+    rc = load_args(base, args, &nargs);
+    if( rc ) return 1;
+
+    for( u=0; u < 2; u++ ) {
+        rc = run_format(base, formats[u], iters, rounds, args, nargs, res + u);
+        if( rc ) return 1;
+    }
+
+    if( json )
+        print_json(res, 2);
+    else
+        print_csv(res, 2);
+
+    for( u=0; (int)u < nargs; u++ )
+        free(args[u]);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#!/bin/bash
+
+# Generates a synthetic configurator schema with the given number of options,
+# along with matching config files, environment, and command-line arguments:
+#   <base>.h     - PREFIX_CONFIGS (use with -DPREFIX_CONFIGS_HEADER)
+#   <base>.ini   - INI config file setting every other option
+#   <base>.json  - JSON config file with the same settings
+#   <base>.env   - NAME=VALUE environment settings, one per line
+#   <base>.args  - command-line arguments, one per line
+
+function usage_error {
+    echo "ERROR: USAGE - $0 num-options output-base"
+    exit 1
+}
+
+function cmd_error {
+    echo "ERROR: $0 - command failed: $*"
+    exit 3
+}
+
+if [[ $# -ne 2 ]]; then
+    usage_error
+fi
+
+nopts=$1
+base=$2
+[[ $nopts =~ ^[0-9]+$ ]] || usage_error
+
+# short options for the first few options (c and P are reserved)
+letters=(a b d e f g h i)
+
+# option attributes (set as globals to avoid subshells), by index mod 10:
+#   0-2 INT, 3-4 FLOAT, 5 BOOL, 6-7 STRING, 8 INT expression, 9 MULTI INT
+#   typ  - option type
+#   dv   - schema default
+#   ival - value in INI files, environment, and arguments
+#   jval - value in JSON files
+function opt_attrs {
+    local i=$1
+    case $(( i % 10 )) in
+        0|1|2) typ=INT; dv=$i; ival=$(( i + 7 )); jval=$ival ;;
+        3|4) typ=FLOAT; dv="$i.5"; ival="$i.25"; jval=$ival ;;
+        5) typ=BOOL; dv=off; ival=on; jval=true ;;
+        6|7) typ=STRING; dv="v$i"; ival="file_$i"; jval="\"$ival\"" ;;
+        8) typ=INT; dv="($i * 2)"; ival="($i+1)*3"; jval="\"$ival\"" ;;
+        9) typ=MULTI; dv=""; ival=$i; jval="[$i, $(( i + 1 )), \"($i * 4)\"]" ;;
+    esac
+}
+
+function gen_schema {
+    local i sec use
+    echo "/* generated by bench_gen.bash - $nopts options */"
+    echo "#define PREFIX_CONFIGS \\"
+    echo "    PREFIX_CFG_CLI(prefix, configfile, STRING, /etc/prefix-bench.conf, \"path to configuration file\", configurator_file_check, 'c', \"specify full path to config file\") \\"
+    echo "    PREFIX_CFG_CLI(prefix, profile, BOOL, off, \"print config startup profile\", NULL, 'P', \"on|off\") \\"
+    for (( i=0; i < nopts; i++ )); do
+        opt_attrs $i
+        sec="s$(( i / 100 ))"
+        use="\"bench option $i\""
+        if [[ $typ == MULTI ]]; then
+            if [[ $i -eq 9 ]]; then
+                echo "    PREFIX_CFG_MULTI_CLI($sec, k$i, INT, $use, NULL, 4, 'm', $use) \\"
+            else
+                echo "    PREFIX_CFG_MULTI($sec, k$i, INT, $use, NULL, 4) \\"
+            fi
+        elif [[ $i -lt ${#letters[@]} ]]; then
+            echo "    PREFIX_CFG_CLI($sec, k$i, $typ, $dv, $use, NULL, '${letters[$i]}', $use) \\"
+        else
+            echo "    PREFIX_CFG($sec, k$i, $typ, $dv, $use, NULL) \\"
+        fi
+    done
+    echo ""
+}
+
+# config files set every other option, and three values for each MULTI
+function gen_ini {
+    local i sec cursec=""
+    for (( i=0; i < nopts; i++ )); do
+        opt_attrs $i
+        if [[ $typ != MULTI ]] && (( i % 2 )); then
+            continue
+        fi
+        sec="s$(( i / 100 ))"
+        if [[ $sec != $cursec ]]; then
+            echo "[$sec]"
+            cursec=$sec
+        fi
+        if [[ $typ == MULTI ]]; then
+            echo "k$i = $i"
+            echo "k$i = $(( i + 1 ))"
+            echo "k$i = ($i * 4)"
+        else
+            echo "k$i = $ival"
+        fi
+    done
+}
+
+function gen_json {
+    local i sec cursec="" sep=""
+    printf '{'
+    for (( i=0; i < nopts; i++ )); do
+        opt_attrs $i
+        if [[ $typ != MULTI ]] && (( i % 2 )); then
+            continue
+        fi
+        sec="s$(( i / 100 ))"
+        if [[ $sec != $cursec ]]; then
+            [[ -n $cursec ]] && printf '\n  },'
+            printf '\n  "%s": {' "$sec"
+            cursec=$sec
+            sep=""
+        fi
+        printf '%s\n    "k%d": %s' "$sep" $i "$jval"
+        sep=","
+    done
+    [[ -n $cursec ]] && printf '\n  }'
+    printf '\n}\n'
+}
+
+# environment sets roughly one in fifty options
+function gen_env {
+    local i
+    for (( i=1; i < nopts; i += 50 )); do
+        opt_attrs $i
+        [[ $typ == MULTI ]] && continue
+        echo "PREFIX_S$(( i / 100 ))_K$i=$ival"
+    done
+}
+
+# command line sets the options that have short flags
+function gen_args {
+    local i
+    for (( i=0; i < nopts && i < ${#letters[@]}; i++ )); do
+        opt_attrs $i
+        echo "-${letters[$i]}$ival"
+    done
+    if [[ $nopts -gt 9 ]]; then
+        echo "-m"
+        echo "99"
+    fi
+}
+
+gen_schema > $base.h || cmd_error gen_schema
+gen_ini > $base.ini || cmd_error gen_ini
+gen_json > $base.json || cmd_error gen_json
+gen_env > $base.env || cmd_error gen_env
+gen_args > $base.args || cmd_error gen_args
+
+exit 0
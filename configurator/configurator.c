@@ -5,10 +5,16 @@
  *  MIT License - See https://github.com/MichaelBrim/tedium/blob/master/LICENSE
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE  // strtod_l()
+#endif
+
 #ifdef __cplusplus
 # include <cassert>
 # include <cctype>
 # include <cerrno>
+# include <cfloat>
+# include <clocale>
 # include <cstddef>
 # include <cstdlib>
 # include <cstring>
@@ -16,18 +22,33 @@
 # include <assert.h>
 # include <ctype.h>
 # include <errno.h>
+# include <float.h>  // FLT_EVAL_METHOD, DBL_MAX
+# include <locale.h> // newlocale()
 # include <stddef.h>
 # include <stdlib.h>
 # include <string.h>
 #endif
 
-#include <getopt.h>   // getopt_long()
+#include <dirent.h>   // opendir()
+#include <fcntl.h>
+#include <limits.h>   // PATH_MAX
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>    // sched_yield()
+#include <signal.h>   // pthread_sigmask()
+#include <stdint.h>
+#include <sys/mman.h> // mmap()
+#include <sys/socket.h>
 #include <sys/stat.h> // stat()
+#include <sys/un.h>   // sockaddr_un
+#include <time.h>     // clock_gettime()
 #include <unistd.h>
+#ifdef __APPLE__
+# include <xlocale.h> // strtod_l()
+#endif
 
 #include <ini.h>
 #include <tinyexpr.h>
-#include <parser.h>
 
 
 // CONFIGURATOR USAGE NOTE: update following to actual .h file name/location
@@ -38,856 +59,6327 @@
 #define stringify_indirect(x) #x
 #define stringify(x) stringify_indirect(x)
 
-
-// initialize configuration using all available methods
-int prefix_config_init(prefix_cfg_t* cfg,
-                       int argc,
-                       char** argv)
+// free a config string, unless it lives in a mapped snapshot
+static void cfg_free(prefix_cfg_t* cfg,
+                     char* str)
 {
-    int rc;
-    char* syscfg = NULL;
+    if( (NULL != cfg->_map)
+        && (str >= cfg->_map) && (str < (cfg->_map + cfg->_map_len)) )
+        return;
+    free(str);
+}
 
-    if( NULL == cfg )
-        return -1;
 
-    memset((void*)cfg, 0, sizeof(prefix_cfg_t));
-    
-    // set default configuration
-    rc = prefix_config_set_defaults(cfg);
-    if( rc ) return rc;
+/* option descriptors, generated from PREFIX_CONFIGS */
 
-    // process system config file (if available)
-    syscfg = cfg->prefix_configfile;
-    rc = configurator_file_check(NULL, NULL, syscfg, NULL);
-    if( 0 == rc ) {
-        rc = prefix_config_process_file(cfg, syscfg);
-        if( rc ) return rc;
-    }
-    if( NULL != syscfg )
-        free(syscfg);
-    cfg->prefix_configfile = NULL;
-    
-    // process environment (overrides defaults and system config)
-    rc = prefix_config_process_environ(cfg);
-    if( rc ) return rc;
-    
-    // process command-line args (overrides all previous)
-    rc = prefix_config_process_cli_args(cfg, argc, argv);
-    if( rc ) return rc;
+/* validate and enum_lookup fields of an option descriptor, for the type
+   of option (the function given for an ENUM is its CONFIGURATOR_ENUM) */
+#define CONFIGURATOR_CHECK_FNS_BOOL(vfn)      vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_INT(vfn)       vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_FLOAT(vfn)     vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_SIZE(vfn)      vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_DURATION(vfn)  vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_STRING(vfn)    vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_RANGELIST(vfn) vfn, NULL
+#define CONFIGURATOR_CHECK_FNS_ENUM(lookup)   NULL, lookup
 
-    // read config file passed on command-line (does not override cli args)
-    if( NULL != cfg->prefix_configfile ) {
-        rc = prefix_config_process_file(cfg, cfg->prefix_configfile);
-        if( rc ) return rc;
-    }
+const prefix_cfg_option_t prefix_cfg_options[] = {
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                        \
+    { #sec, #key, CONFIGURATOR_TYPE_##typ, false, stringify(dv), desc,  \
+      CONFIGURATOR_CHECK_FNS_##typ(vfn),                                \
+      offsetof(prefix_cfg_t, sec##_##key),                              \
+      offsetof(prefix_cfg_t, sec##_##key##_val),                        \
+      0, #sec "-" #key, NULL, 0 },
 
-    // validate settings
-    rc = prefix_config_validate(cfg);
-    if( rc ) return rc;
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)          \
+    { #sec, #key, CONFIGURATOR_TYPE_##typ, false, stringify(dv), desc,  \
+      CONFIGURATOR_CHECK_FNS_##typ(vfn),                                \
+      offsetof(prefix_cfg_t, sec##_##key),                              \
+      offsetof(prefix_cfg_t, sec##_##key##_val),                        \
+      opt, #sec "-" #key, use, 0 },
 
-    return 0;
-}
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)                  \
+    { #sec, #key, CONFIGURATOR_TYPE_##typ, true, NULL, desc,            \
+      CONFIGURATOR_CHECK_FNS_##typ(vfn),                                \
+      offsetof(prefix_cfg_t, sec##_##key), 0,                           \
+      0, #sec "-" #key, NULL, me },
 
-// cleanup allocated state
-int prefix_config_fini(prefix_cfg_t* cfg)
-{
-    unsigned u;
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
+    { #sec, #key, CONFIGURATOR_TYPE_##typ, true, NULL, desc,            \
+      CONFIGURATOR_CHECK_FNS_##typ(vfn),                                \
+      offsetof(prefix_cfg_t, sec##_##key), 0,                           \
+      opt, #sec "-" #key, use, me },
 
-    if( NULL == cfg )
-        return -1;
-    
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)        \
-    if( NULL != cfg->sec##_##key ) {                    \
-        free(cfg->sec##_##key);                         \
-        cfg->sec##_##key = NULL;                        \
-    }
-
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    if( NULL != cfg->sec##_##key ) {                            \
-        free(cfg->sec##_##key);                                 \
-        cfg->sec##_##key = NULL;                                \
-    }
-
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)      \
-    for( u=0; u < me; u++ ) {                                   \
-        if( NULL != cfg->sec##_##key[u] ) {                     \
-            free(cfg->sec##_##key[u]);                          \
-            cfg->sec##_##key[u] = NULL;                         \
-        }                                                       \
-    }                                                           \
-    cfg->n_##sec##_##key = 0;
-
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
-    for( u=0; u < me; u++ ) {                                           \
-        if( NULL != cfg->sec##_##key[u] ) {                             \
-            free(cfg->sec##_##key[u]);                                  \
-            cfg->sec##_##key[u] = NULL;                                 \
-        }                                                               \
-    }                                                                   \
-    cfg->n_##sec##_##key = 0;
-
-    PREFIX_CONFIGS;
+    PREFIX_CONFIGS
 #undef PREFIX_CFG
 #undef PREFIX_CFG_CLI
 #undef PREFIX_CFG_MULTI
 #undef PREFIX_CFG_MULTI_CLI
+};
 
-    return 0;
-}
+static const char* type_names[CONFIGURATOR_NUM_TYPES] = {
+    "BOOL", "INT", "FLOAT", "SIZE", "DURATION", "ENUM", "STRING", "RANGELIST"
+};
 
-// print configuration to specified file (or stderr)
-void prefix_config_print(prefix_cfg_t* cfg,
-                         FILE* fp)
+// storage of an option within cfg
+static char** opt_string(const prefix_cfg_t* cfg,
+                         const prefix_cfg_option_t* opt)
 {
-    unsigned u;
-    char msg[PREFIX_CFG_MAX_MSG];
-
-    if( NULL == fp )
-        fp = stderr;
+    return (char**)((char*)cfg + opt->offset);
+}
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                \
-    if( NULL != cfg->sec##_##key ) {                            \
-        snprintf(msg, sizeof(msg), "PREFIX CONFIG: %s.%s = %s", \
-                 #sec, #key, cfg->sec##_##key);                 \
-        fprintf(fp, "%s\n", msg);                               \
-    }
+static configurator_value_t* opt_value(const prefix_cfg_t* cfg,
+                                       const prefix_cfg_option_t* opt)
+{
+    return (configurator_value_t*)((char*)cfg + opt->val_offset);
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    if( NULL != cfg->sec##_##key ) {                            \
-        snprintf(msg, sizeof(msg), "PREFIX CONFIG: %s.%s = %s", \
-                 #sec, #key, cfg->sec##_##key);                 \
-        fprintf(fp, "%s\n", msg);                               \
-    }
+static configurator_multi_t* opt_multi(const prefix_cfg_t* cfg,
+                                       const prefix_cfg_option_t* opt)
+{
+    return (configurator_multi_t*)((char*)cfg + opt->offset);
+}
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)              \
-    for( u=0; u < me; u++ ) {                                           \
-        if( NULL != cfg->sec##_##key[u] ) {                             \
-            snprintf(msg, sizeof(msg), "PREFIX CONFIG: %s.%s[%u] = %s", \
-                     #sec, #key, u+1, cfg->sec##_##key[u]);             \
-            fprintf(fp, "%s\n", msg);                                   \
-        }                                                               \
-    }
+// lookup option id by section and key (-1 when unknown)
+static int option_id(const char* section,
+                     const char* kee)
+{
+    const prefix_cfg_option_t* opt = prefix_config_lookup(section, kee);
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
-    for( u=0; u < me; u++ ) {                                           \
-        if( NULL != cfg->sec##_##key[u] ) {                             \
-            snprintf(msg, sizeof(msg), "PREFIX CONFIG: %s.%s[%u] = %s", \
-                     #sec, #key, u+1, cfg->sec##_##key[u]);             \
-            fprintf(fp, "%s\n", msg);                                   \
-        }                                                               \
-    }
-    
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+    return (NULL != opt) ? (int)(opt - prefix_cfg_options) : -1;
+}
 
-    fflush(fp);
+// string storage of a single-valued option (NULL for _MULTI options)
+static char** option_string(prefix_cfg_t* cfg,
+                            int id)
+{
+    if( (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS)
+        || prefix_cfg_options[id].multi )
+        return NULL;
+    return opt_string(cfg, prefix_cfg_options + id);
 }
 
-// print configuration in .INI format to specified file (or stderr)
-void prefix_config_print_ini(prefix_cfg_t* cfg,
-                             FILE* inifp)
+// value list of a _MULTI option (NULL for single-valued options)
+static configurator_multi_t* option_multi(prefix_cfg_t* cfg,
+                                          int id)
 {
-    unsigned u;
-    const char* curr_sec = NULL;
-    const char* last_sec = NULL;
+    if( (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS)
+        || (! prefix_cfg_options[id].multi) )
+        return NULL;
+    return opt_multi(cfg, prefix_cfg_options + id);
+}
 
-    if( NULL == inifp )
-        inifp = stderr;
+// 64-bit FNV-1a hash
+static uint64_t fnv1a(uint64_t h,
+                      const void* data,
+                      size_t len)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    size_t i;
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                        \
-    if( NULL != cfg->sec##_##key ) {                                    \
-        curr_sec = #sec;                                                \
-        if( (NULL == last_sec) || (0 != strcmp(curr_sec, last_sec)) )   \
-            fprintf(inifp, "\n[%s]\n", curr_sec);                       \
-        fprintf(inifp, "%s = %s\n", #key, cfg->sec##_##key);            \
-        last_sec = curr_sec;                                            \
+    for( i=0; i < len; i++ ) {
+        h ^= (uint64_t) p[i];
+        h *= 0x100000001b3ULL;
     }
+    return h;
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)          \
-    if( NULL != cfg->sec##_##key ) {                                    \
-        curr_sec = #sec;                                                \
-        if( (NULL == last_sec) || (0 != strcmp(curr_sec, last_sec)) )   \
-            fprintf(inifp, "\n[%s]\n", curr_sec);                       \
-        fprintf(inifp, "%s = %s\n", #key, cfg->sec##_##key);            \
-        last_sec = curr_sec;                                            \
-    }
+#define FNV1A_INIT 0xcbf29ce484222325ULL
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)                  \
-    for( u=0; u < me; u++ ) {                                           \
-        if( NULL != cfg->sec##_##key[u] ) {                             \
-            curr_sec = #sec;                                            \
-            if( (NULL == last_sec) || (0 != strcmp(curr_sec, last_sec)) ) \
-                fprintf(inifp, "\n[%s]\n", curr_sec);                   \
-            fprintf(inifp, "%s = %s ; (instance %u)\n",                 \
-                    #key, cfg->sec##_##key[u], u+1);                    \
-            last_sec = curr_sec;                                        \
-        }                                                               \
-    }
+static uint64_t fnv1a_str(uint64_t h,
+                          const char* s)
+{
+    // include the terminator, so ("ab","c") differs from ("a","bc")
+    return fnv1a(h, s, strlen(s) + 1);
+}
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-    for( u=0; u < me; u++ ) {                                           \
-        if( NULL != cfg->sec##_##key[u] ) {                             \
-            curr_sec = #sec;                                            \
-            if( (NULL == last_sec) || (0 != strcmp(curr_sec, last_sec)) ) \
-                fprintf(inifp, "\n[%s]\n", curr_sec);                   \
-            fprintf(inifp, "%s = %s ; (instance %u)\n",                 \
-                    #key, cfg->sec##_##key[u], u+1);                    \
-            last_sec = curr_sec;                                        \
-        }                                                               \
-    }
-
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+// open-addressed table of option ids (plus one, so zero is empty)
+#define OPTION_HASH_SIZE ((2 * PREFIX_CFG_NUM_OPTIONS) + 1)
 
-    fflush(inifp);
-}
+static int option_hash[OPTION_HASH_SIZE];
+static pthread_once_t option_hash_once = PTHREAD_ONCE_INIT;
 
-// set default values given in PREFIX_CONFIGS
-int prefix_config_set_defaults(prefix_cfg_t* cfg)
+static size_t option_hash_slot(const char* section,
+                               const char* key)
 {
-    int rc;
-    char* val;
+    return (size_t)(fnv1a_str(fnv1a_str(FNV1A_INIT, section), key)
+                    % OPTION_HASH_SIZE);
+}
 
-    if( NULL == cfg )
-        return -1;
-    
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)        \
-    val = stringify(dv);                                \
-    if( 0 != strcmp(val, "NULLSTRING") ) {              \
-        cfg->sec##_##key = strdup(val);                 \
+static void option_hash_build(void)
+{
+    int id;
+    size_t h;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        h = option_hash_slot(prefix_cfg_options[id].section,
+                             prefix_cfg_options[id].key);
+        while( 0 != option_hash[h] )
+            h = (h + 1) % OPTION_HASH_SIZE;
+        option_hash[h] = id + 1;
     }
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    val = stringify(dv);                                        \
-    if( 0 != strcmp(val, "NULLSTRING") ) {                      \
-        cfg->sec##_##key = strdup(val);                         \
+// lookup an option descriptor by section and key (NULL when unknown)
+const prefix_cfg_option_t* prefix_config_lookup(const char* section,
+                                                const char* key)
+{
+    size_t h;
+    const prefix_cfg_option_t* opt;
+
+    if( (NULL == section) || (NULL == key) )
+        return NULL;
+
+    pthread_once(&option_hash_once, option_hash_build);
+    for( h = option_hash_slot(section, key); 0 != option_hash[h];
+         h = (h + 1) % OPTION_HASH_SIZE ) {
+        opt = prefix_cfg_options + (option_hash[h] - 1);
+        if( (0 == strcmp(opt->key, key)) && (0 == strcmp(opt->section, section)) )
+            return opt;
     }
+    return NULL;
+}
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)              \
-    cfg->n_##sec##_##key = 0;                                           \
-    memset((void*)cfg->sec##_##key, 0, sizeof(cfg->sec##_##key));
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
-    cfg->n_##sec##_##key = 0;                                           \
-    memset((void*)cfg->sec##_##key, 0, sizeof(cfg->sec##_##key));
+/* startup profiling */
 
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
-        
-    return 0;
-}
+char* getenv_helper(const char* section,
+                    const char* key,
+                    unsigned mentry);
 
+static bool profiling_enabled = false;
 
-// utility routine to print CLI usage (and optional usage error message)
-void prefix_config_cli_usage(char* arg0)
-{    
-    fprintf(stderr, "USAGE: %s [options]\n", arg0);
+static const char* phase_names[PREFIX_CFG_NUM_PHASES] = {
+    "defaults", "system file", "environment",
+    "command line", "command-line file", "fragments", "validation"
+};
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) 
+static const char* validator_names[CONFIGURATOR_NUM_VALIDATORS] = {
+    "BOOL", "INT", "FLOAT", "SIZE/DURATION", "RANGELIST", "ENUM", "path",
+    "custom"
+};
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)         \
-    fprintf(stderr, "    -%c,--%s-%s <%s>\t%s (default value: %s)\n",    \
-            opt, #sec, #key, #typ, use, stringify(dv));
+// enable profiling for all subsequent initializations
+void prefix_config_profiling(bool enable)
+{
+    __atomic_store_n(&profiling_enabled, enable, __ATOMIC_RELAXED);
+}
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) 
+// return the profile for cfg, or NULL if it was not profiled
+const prefix_cfg_profile_t* prefix_config_profile(const prefix_cfg_t* cfg)
+{
+    if( NULL == cfg )
+        return NULL;
+    return cfg->_profile;
+}
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
-    fprintf(stderr, "    -%c,--%s-%s <%s>\t%s (multiple values supported - max %u entries)\n", \
-            opt, #sec, #key, #typ, use, me);
+// current monotonic time in nanoseconds
+static unsigned long long profile_now(void)
+{
+    struct timespec ts;
 
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
 
-    fflush(stderr);
+// current time, or zero when not profiling
+static unsigned long long profile_clock(const prefix_cfg_t* cfg)
+{
+    if( NULL == cfg->_profile )
+        return 0;
+    return profile_now();
 }
 
-// print usage error message
-void prefix_config_cli_usage_error(char* arg0,
-                                   char* err_msg)
+// start recording a phase, returns its start time
+static unsigned long long profile_begin(prefix_cfg_t* cfg,
+                                        prefix_cfg_phase_e phase)
 {
-    if( NULL != err_msg )
-        fprintf(stderr, "USAGE ERROR: %s : %s\n\n", arg0, err_msg);
-    
-    prefix_config_cli_usage(arg0);
+    if( NULL == cfg->_profile )
+        return 0;
+    cfg->_profile->current = phase;
+    return profile_clock(cfg);
 }
 
+// finish recording the current phase
+static void profile_end(prefix_cfg_t* cfg,
+                        unsigned long long start)
+{
+    prefix_cfg_profile_t* prof = cfg->_profile;
 
-static struct option cli_options[] = {
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    { #sec "-" #key, required_argument, NULL, opt },
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
-    { #sec "-" #key, required_argument, NULL, opt },
-    PREFIX_CONFIGS
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
-    { NULL, 0, NULL, 0 }
-};
+    if( NULL == prof )
+        return;
+    prof->phase[prof->current].nsecs += profile_clock(cfg) - start;
+}
 
-// update config struct based on command line args
-int prefix_config_process_cli_args(prefix_cfg_t* cfg,
-                                   int argc,
-                                   char** argv)
+// add timing for a config file parse
+static void profile_file(prefix_cfg_t* cfg,
+                         const char* file,
+                         unsigned long long start,
+                         unsigned long keys,
+                         unsigned long allocs,
+                         unsigned long long bytes)
+{
+    prefix_cfg_profile_t* prof = cfg->_profile;
+    configurator_file_stats_t* files;
+    configurator_file_stats_t* fs;
+
+    if( NULL == prof )
+        return;
+    files = (configurator_file_stats_t*)
+        realloc(prof->files, (prof->num_files + 1) * sizeof(*files));
+    if( NULL == files )
+        return;
+    prof->files = files;
+    fs = files + prof->num_files;
+    fs->file = strdup(file);
+    if( NULL == fs->file )
+        return;
+    prof->num_files++;
+    fs->stats.nsecs = profile_clock(cfg) - start;
+    fs->stats.keys = prof->phase[prof->current].keys - keys;
+    fs->stats.allocs = prof->phase[prof->current].allocs - allocs;
+    fs->stats.bytes = prof->phase[prof->current].bytes - bytes;
+}
+
+static void profile_free(prefix_cfg_t* cfg)
+{
+    unsigned u;
+    prefix_cfg_profile_t* prof = cfg->_profile;
+
+    if( NULL == prof )
+        return;
+    for( u=0; u < prof->num_files; u++ )
+        free(prof->files[u].file);
+    free(prof->files);
+    free(prof);
+    cfg->_profile = NULL;
+}
+
+// called for each command-line option (val is NULL for a BOOL without one)
+typedef int (*cli_option_fn)(void* arg,
+                             const prefix_cfg_option_t* opt,
+                             const char* val);
+
+static int cli_scan(int argc,
+                    char** argv,
+                    cli_option_fn fn,
+                    void* arg,
+                    char* errmsg,
+                    size_t errlen);
+
+// record the last value given for prefix.profile
+static int cli_profile(void* arg,
+                       const prefix_cfg_option_t* opt,
+                       const char* val)
+{
+    if( (prefix_cfg_options + PREFIX_CFG_ID_prefix_profile) == opt )
+        *(const char**) arg = (NULL != val) ? val : "on";
+    return 0;
+}
+
+/* check whether profiling was requested, before the environment and
+   command line have been processed (i.e., PREFIX_PROFILE, or the
+   prefix.profile CLI option, scanned as the CLI parser does) */
+static bool profile_requested(int argc,
+                              char** argv)
 {
-    int rc, c;
-    int usage_err = 0;
-    int ondx = 0;
-    int sndx = 0;
+    bool b;
+    const char* val = NULL;
     char errmsg[PREFIX_CFG_MAX_MSG];
-    char short_opts[256];
-    extern char* optarg;
-    extern int optind, optopt;
 
-    if( NULL == cfg )
-        return -1;
+    if( __atomic_load_n(&profiling_enabled, __ATOMIC_RELAXED) )
+        return true;
 
-    // setup short_opts and cli_options
-    memset((void*)short_opts, 0, sizeof(short_opts));
-    short_opts[sndx++] = ':'; // report missing args
+    // usage errors are reported when the command line is processed
+    cli_scan(argc, argv, cli_profile, (void*)&val, errmsg, sizeof(errmsg));
+    if( NULL == val )
+        val = getenv_helper("prefix", "profile", 0);
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) 
+    b = false;
+    if( NULL != val )
+        configurator_bool_val(val, &b);
+    return b;
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    short_opts[sndx++] = opt;                                   \
-    if( 0 == strcmp(#typ, "BOOL") ) {                           \
-        short_opts[sndx++] = ':';                               \
-        short_opts[sndx++] = ':';                               \
-        cli_options[ondx++].has_arg = optional_argument;        \
-    }                                                           \
-    else {                                                      \
-        short_opts[sndx++] = ':';                               \
-        cli_options[ondx++].has_arg = required_argument;        \
+// duplicate a config string, accounting for it when profiling
+static char* cfg_strdup(prefix_cfg_t* cfg,
+                        const char* str)
+{
+    char* dup = strdup(str);
+    configurator_stats_t* st;
+
+    if( (NULL != cfg->_profile) && (NULL != dup) ) {
+        st = cfg->_profile->phase + cfg->_profile->current;
+        st->keys++;
+        st->allocs++;
+        st->bytes += strlen(str) + 1;
     }
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) 
+    return dup;
+}
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-    short_opts[sndx++] = opt;                                           \
-    if( 0 == strcmp(#typ, "BOOL") ) {                                   \
-        short_opts[sndx++] = ':';                                       \
-        short_opts[sndx++] = ':';                                       \
-        cli_options[ondx++].has_arg = optional_argument;                \
-    }                                                                   \
-    else {                                                              \
-        short_opts[sndx++] = ':';                                       \
-        cli_options[ondx++].has_arg = required_argument;                \
-    }
-
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+/* value origins */
 
-    //fprintf(stderr, "PREFIX CONFIG DEBUG: short-opts '%s'\n", short_opts);
+static const char* origin_names[PREFIX_CFG_NUM_ORIGINS] = {
+    "unset", "default", "fallback source", "fragment", "system file",
+    "environment", "command-line file", "command line", "runtime"
+};
 
-    // process argv
-    while( -1 != (c = getopt_long(argc, argv, short_opts, cli_options, NULL)) ) {
-        switch( c ) {
+// origin of the values of each source slot
+static const unsigned char slot_origins[] = {
+    PREFIX_CFG_ORIGIN_FALLBACK, PREFIX_CFG_ORIGIN_SYSFILE,
+    PREFIX_CFG_ORIGIN_ENVIRON, PREFIX_CFG_ORIGIN_CLI
+};
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) 
+/* claim an option for a value from origin, if that is at least the
+   precedence of its current value (_MULTI options, which take values
+   from every origin, just record the highest) */
+static bool origin_claim(prefix_cfg_t* cfg,
+                         int id,
+                         prefix_cfg_origin_e origin)
+{
+    if( cfg->_origin[id] > (unsigned char) origin )
+        return false;
+    cfg->_origin[id] = (unsigned char) origin;
+    return true;
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-            case opt: {                                         \
-                if( optarg )                                    \
-                    cfg->sec##_##key = strdup(optarg);          \
-                else if( 0 == strcmp(#typ, "BOOL") )            \
-                    cfg->sec##_##key = strdup("on");            \
-                break;                                          \
-            }
+// replace the value string of a single-valued option
+static int option_replace(prefix_cfg_t* cfg,
+                          const prefix_cfg_option_t* opt,
+                          const char* val)
+{
+    char* dup = cfg_strdup(cfg, val);
+    char** str = opt_string(cfg, opt);
+
+    if( NULL == dup )
+        return ENOMEM;
+    if( NULL != *str )
+        cfg_free(cfg, *str);
+    *str = dup;
+    return 0;
+}
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) 
+prefix_cfg_origin_e prefix_config_origin(const prefix_cfg_t* cfg,
+                                         int id)
+{
+    if( (NULL == cfg) || (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS) )
+        return PREFIX_CFG_ORIGIN_UNSET;
+    return (prefix_cfg_origin_e) __atomic_load_n(&(cfg->_origin[id]), __ATOMIC_RELAXED);
+}
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-            case opt: {                                                 \
-                cfg->sec##_##key[cfg->n_##sec##_##key++] = strdup(optarg); \
-                break;                                                  \
-            }
+const char* prefix_config_origin_name(prefix_cfg_origin_e origin)
+{
+    if( ((int) origin < 0) || (origin >= PREFIX_CFG_NUM_ORIGINS) )
+        return NULL;
+    return origin_names[origin];
+}
 
-            PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+// append a string to a _MULTI option, spilling to the heap when needed
+static int multi_push(configurator_multi_t* m,
+                      char* str)
+{
+    char** vals;
+    unsigned cap;
 
-        case ':':
-            usage_err = 1;
-            snprintf(errmsg, sizeof(errmsg), 
-                     "CLI option -%c requires operand", optopt);
-            break;
-        case '?':
-            usage_err = 1;
-            snprintf(errmsg, sizeof(errmsg), 
-                     "unknown CLI option -%c", optopt);
-            break;
-        default:
-            // should not reach here
-            fprintf(stderr, "PREFIX CONFIG DEBUG: unhandled option '%s'\n", optarg);
-            break;
-        }
-        if( usage_err ) break;
+    if( NULL == str )
+        return ENOMEM;
+
+    if( (NULL == m->heap) && (m->count < CONFIGURATOR_MULTI_INLINE) ) {
+        m->small[m->count++] = str;
+        return 0;
     }
 
-    if( ! usage_err ) 
-        rc = 0;
-    else {
-        rc = -1;
-        prefix_config_cli_usage_error(argv[0], errmsg);
+    if( (NULL == m->heap) || (m->count == m->cap) ) {
+        cap = (0 != m->cap) ? (2 * m->cap) : (2 * CONFIGURATOR_MULTI_INLINE);
+        vals = (char**) realloc(m->heap, cap * sizeof(char*));
+        if( NULL == vals )
+            return ENOMEM;
+        if( NULL == m->heap )
+            memcpy((void*)vals, (void*)m->small, m->count * sizeof(char*));
+        m->heap = vals;
+        m->cap = cap;
     }
-        
+    m->heap[m->count++] = str;
+    return 0;
+}
+
+// append a copy of val to a _MULTI option
+static int multi_append(prefix_cfg_t* cfg,
+                        configurator_multi_t* m,
+                        const char* val)
+{
+    int rc;
+    char* str = cfg_strdup(cfg, val);
+
+    rc = multi_push(m, str);
+    if( rc && (NULL != str) )
+        free(str);
     return rc;
 }
 
-// helper to check environment variable
-char* getenv_helper(const char* section,
-                    const char* key,
-                    unsigned mentry)
+// free the values of a _MULTI option
+static void multi_free(prefix_cfg_t* cfg,
+                       configurator_multi_t* m)
 {
-    static char envname[256];
     unsigned u;
-    size_t len;
-    size_t ndx = 0;
+    char* const* vals = configurator_multi_values(m);
 
-    memset((void*)envname, 0, sizeof(envname));
+    for( u=0; u < m->count; u++ )
+        cfg_free(cfg, vals[u]);
+    free(m->heap);
+    memset((void*)m, 0, sizeof(*m));
+}
 
-    
-    ndx += sprintf(envname, "PREFIX_");
+// print startup profile (to stderr if fp==NULL)
+void prefix_config_profile_print(const prefix_cfg_t* cfg,
+                                 FILE* fp)
+{
+    unsigned u;
+    const prefix_cfg_profile_t* prof;
+    const configurator_stats_t* st;
+    configurator_stats_t total;
 
-    if( 0 != strcmp(section, "prefix") ) {
-        len = strlen(section);
-        for( u=0; u < len; u++ )
-            envname[ndx+u] = toupper(section[u]);
-        ndx += len;
-        envname[ndx++] = '_';
+    if( NULL == fp )
+        fp = stderr;
+
+    prof = prefix_config_profile(cfg);
+    if( NULL == prof ) {
+        fprintf(fp, "PREFIX CONFIG PROFILE: not enabled\n");
+        return;
     }
 
-    len = strlen(key);
-    for( u=0; u < len; u++ )
-        envname[ndx+u] = toupper(key[u]);
-    ndx += len;
+    memset((void*)&total, 0, sizeof(total));
+    fprintf(fp, "PREFIX CONFIG PROFILE:\n");
+    fprintf(fp, "  %-20s %12s %8s %8s %10s\n",
+            "phase", "usecs", "keys", "allocs", "bytes");
+    for( u=0; u < PREFIX_CFG_NUM_PHASES; u++ ) {
+        st = prof->phase + u;
+        fprintf(fp, "  %-20s %12.3f %8lu %8lu %10llu\n", phase_names[u],
+                st->nsecs / 1e3, st->keys, st->allocs, st->bytes);
+        total.nsecs += st->nsecs;
+        total.keys += st->keys;
+        total.allocs += st->allocs;
+        total.bytes += st->bytes;
+    }
+    fprintf(fp, "  %-20s %12.3f %8lu %8lu %10llu\n", "total",
+            total.nsecs / 1e3, total.keys, total.allocs, total.bytes);
+
+    for( u=0; u < prof->num_files; u++ ) {
+        st = &(prof->files[u].stats);
+        fprintf(fp, "  file %s: %.3f usecs, %lu keys, %lu allocs, %llu bytes\n",
+                prof->files[u].file, st->nsecs / 1e3,
+                st->keys, st->allocs, st->bytes);
+    }
 
-    if( mentry )
-        ndx += sprintf(envname+ndx, "_%u", mentry);
-    
-    //fprintf(stderr, "PREFIX CONFIG DEBUG: checking env var %s\n", envname);
-    return getenv(envname);
+    for( u=0; u < CONFIGURATOR_NUM_VALIDATORS; u++ ) {
+        st = prof->validator + u;
+        if( 0 == st->keys )
+            continue;
+        fprintf(fp, "  validator %s: %.3f usecs, %lu values\n",
+                validator_names[u], st->nsecs / 1e3, st->keys);
+    }
+    fflush(fp);
 }
-                    
 
-// update config struct based on environment variables
+// growable string buffer
+typedef struct {
+    char* s;
+    size_t len;
+    size_t cap;
+} cfg_strbuf_t;
+
+static int strbuf_append(cfg_strbuf_t* sb,
+                         const char* s,
+                         size_t len)
+{
+    char* grown;
+    size_t cap;
+
+    if( (sb->len + len + 1) > sb->cap ) {
+        cap = (sb->cap ? (2 * sb->cap) : 64);
+        while( cap < (sb->len + len + 1) )
+            cap *= 2;
+        grown = (char*) realloc(sb->s, cap);
+        if( NULL == grown )
+            return ENOMEM;
+        sb->s = grown;
+        sb->cap = cap;
+    }
+    memcpy(sb->s + sb->len, s, len);
+    sb->len += len;
+    sb->s[sb->len] = '\0';
+    return 0;
+}
+
+
+// initialize configuration using all available methods
+struct configurator_fetch;
+static unsigned sources_start(struct configurator_fetch** fetches);
+static int sources_merge(prefix_cfg_t* cfg,
+                         struct configurator_fetch** fetches,
+                         unsigned count,
+                         prefix_cfg_source_slot_e slot);
+static void sources_finish(struct configurator_fetch** fetches,
+                           unsigned count);
+
+static int config_load(prefix_cfg_t* cfg,
+                       int argc,
+                       char** argv,
+                       bool lazy,
+                       struct configurator_fetch** fetches,
+                       unsigned nfetches)
+{
+    int rc;
+    bool print_profile;
+    char* syscfg = NULL;
+    unsigned long long t;
+
+    if( profile_requested(argc, argv) )
+        cfg->_profile = (prefix_cfg_profile_t*)
+            calloc(1, sizeof(prefix_cfg_profile_t));
+    
+    // set default configuration
+    t = profile_begin(cfg, PREFIX_CFG_PHASE_DEFAULTS);
+    rc = prefix_config_set_defaults(cfg);
+    profile_end(cfg, t);
+    if( rc ) return rc;
+
+    // process system config file (if available)
+    t = profile_begin(cfg, PREFIX_CFG_PHASE_SYSFILE);
+    syscfg = cfg->prefix_configfile;
+    rc = configurator_file_check(NULL, NULL, syscfg, NULL);
+    if( 0 == rc ) {
+        cfg->_loading = PREFIX_CFG_ORIGIN_SYSFILE;
+        rc = prefix_config_process_file(cfg, syscfg);
+        if( rc ) return rc;
+    }
+    if( NULL != syscfg )
+        free(syscfg);
+    cfg->prefix_configfile = NULL;
+    cfg->_origin[PREFIX_CFG_ID_prefix_configfile] = PREFIX_CFG_ORIGIN_UNSET;
+    rc = sources_merge(cfg, fetches, nfetches, PREFIX_CFG_SOURCE_SYSFILE);
+    profile_end(cfg, t);
+    if( rc ) return rc;
+    
+    // process environment (overrides defaults and system config)
+    t = profile_begin(cfg, PREFIX_CFG_PHASE_ENVIRON);
+    rc = prefix_config_process_environ(cfg);
+    if( 0 == rc )
+        rc = sources_merge(cfg, fetches, nfetches, PREFIX_CFG_SOURCE_ENVIRON);
+    profile_end(cfg, t);
+    if( rc ) return rc;
+    
+    // process command-line args (overrides all previous)
+    t = profile_begin(cfg, PREFIX_CFG_PHASE_CLI);
+    rc = prefix_config_process_cli_args(cfg, argc, argv);
+    if( 0 == rc )
+        rc = sources_merge(cfg, fetches, nfetches, PREFIX_CFG_SOURCE_CLI);
+    profile_end(cfg, t);
+    if( rc ) return rc;
+
+    // read config file passed on command-line (does not override cli args)
+    if( NULL != cfg->prefix_configfile ) {
+        t = profile_begin(cfg, PREFIX_CFG_PHASE_CLIFILE);
+        cfg->_loading = PREFIX_CFG_ORIGIN_CLIFILE;
+        rc = prefix_config_process_file(cfg, cfg->prefix_configfile);
+        cfg->_loading = 0;
+        profile_end(cfg, t);
+        if( rc ) return rc;
+    }
+
+    // merge config fragments, then fallback sources (do not override any of the above)
+    t = profile_begin(cfg, PREFIX_CFG_PHASE_FRAGMENTS);
+    rc = prefix_config_process_fragments(cfg);
+    if( 0 == rc )
+        rc = sources_merge(cfg, fetches, nfetches, PREFIX_CFG_SOURCE_FALLBACK);
+    profile_end(cfg, t);
+    if( rc ) return rc;
+
+    if( lazy ) {
+        // options are validated on first access instead
+        cfg->_lazy = (unsigned char*) calloc(PREFIX_CFG_NUM_OPTIONS + 1, 1);
+        if( NULL == cfg->_lazy ) return ENOMEM;
+    }
+    else {
+        // validate settings
+        t = profile_begin(cfg, PREFIX_CFG_PHASE_VALIDATE);
+        rc = prefix_config_validate(cfg);
+        profile_end(cfg, t);
+        if( rc ) return rc;
+    }
+
+    print_profile = prefix_config_get_prefix_profile(cfg);
+    if( print_profile )
+        prefix_config_profile_print(cfg, stderr);
+
+    return 0;
+}
+
+static int config_init(prefix_cfg_t* cfg,
+                       int argc,
+                       char** argv,
+                       bool lazy)
+{
+    int rc;
+    unsigned nfetches;
+    struct configurator_fetch* fetches[PREFIX_CFG_MAX_SOURCES];
+
+    if( NULL == cfg )
+        return -1;
+
+    memset((void*)cfg, 0, sizeof(prefix_cfg_t));
+
+    // sources are fetched while the built-in sources are processed
+    nfetches = sources_start(fetches);
+    rc = config_load(cfg, argc, argv, lazy, fetches, nfetches);
+    sources_finish(fetches, nfetches);
+    return rc;
+}
+
+int prefix_config_init(prefix_cfg_t* cfg,
+                       int argc,
+                       char** argv)
+{
+    return config_init(cfg, argc, argv, false);
+}
+
+int prefix_config_init_lazy(prefix_cfg_t* cfg,
+                            int argc,
+                            char** argv)
+{
+    return config_init(cfg, argc, argv, true);
+}
+
+typedef struct {
+    prefix_cfg_init_t* inits;
+    unsigned count;
+    unsigned next;        // next config to initialize, claimed atomically
+} init_batch_t;
+
+static void* init_batch_worker(void* arg)
+{
+    init_batch_t* b = (init_batch_t*) arg;
+    prefix_cfg_init_t* in;
+    unsigned u;
+
+    while( (u = __atomic_fetch_add(&(b->next), 1, __ATOMIC_RELAXED)) < b->count ) {
+        in = b->inits + u;
+        in->rc = prefix_config_init(in->cfg, in->argc, in->argv);
+    }
+    return NULL;
+}
+
+// initialize a batch of configs concurrently, see configurator.h
+int prefix_config_init_batch(prefix_cfg_init_t* inits,
+                             unsigned count,
+                             unsigned nthreads)
+{
+    unsigned u, t;
+    unsigned started = 0;
+    pthread_t* threads;
+    init_batch_t b;
+
+    if( (NULL == inits) && (0 != count) )
+        return EINVAL;
+
+    b.inits = inits;
+    b.count = count;
+    b.next = 0;
+
+    if( 0 == nthreads )
+        nthreads = PREFIX_CFG_INIT_THREADS;
+    if( nthreads > count )
+        nthreads = count;
+
+    // the calling thread works too, and alone if no helpers can be started
+    threads = (pthread_t*) calloc((nthreads > 1) ? (nthreads - 1) : 1, sizeof(pthread_t));
+    while( (NULL != threads) && ((started + 1) < nthreads) ) {
+        if( 0 != pthread_create(&threads[started], NULL, init_batch_worker, &b) )
+            break;
+        started++;
+    }
+    init_batch_worker(&b);
+    for( t=0; t < started; t++ )
+        pthread_join(threads[t], NULL);
+    free(threads);
+
+    for( u=0; u < count; u++ ) {
+        if( inits[u].rc )
+            return inits[u].rc;
+    }
+    return 0;
+}
+
+static void subscriptions_free(prefix_cfg_t* cfg);
+static void value_free(const prefix_cfg_option_t* opt,
+                       configurator_value_t* v);
+
+// cleanup allocated state
+int prefix_config_fini(prefix_cfg_t* cfg)
+{
+    int id;
+    char** str;
+    const prefix_cfg_option_t* opt;
+
+    if( NULL == cfg )
+        return -1;
+
+    if( NULL != cfg->_admin )
+        prefix_config_admin_stop(cfg);
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( opt->multi ) {
+            multi_free(cfg, opt_multi(cfg, opt));
+            continue;
+        }
+        str = opt_string(cfg, opt);
+        if( NULL != *str ) {
+            cfg_free(cfg, *str);
+            *str = NULL;
+        }
+        value_free(opt, opt_value(cfg, opt));
+    }
+
+    prefix_config_reclaim(cfg);
+    profile_free(cfg);
+    subscriptions_free(cfg);
+
+    if( NULL != cfg->_lazy ) {
+        free(cfg->_lazy);
+        cfg->_lazy = NULL;
+    }
+
+    if( NULL != cfg->_map ) {
+        munmap(cfg->_map, cfg->_map_len);
+        cfg->_map = NULL;
+        cfg->_map_len = 0;
+    }
+
+    return 0;
+}
+
+// value of a single-valued option for display (ENUM options by item name)
+static const char* display_value(const prefix_cfg_option_t* opt,
+                                 const char* str,
+                                 const configurator_value_t* v)
+{
+    int e;
+    const char* name;
+
+    if( (NULL == str) || (CONFIGURATOR_TYPE_ENUM != opt->type) )
+        return str;
+    e = (int) v->i;
+    name = opt->enum_lookup(NULL, &e);
+    return (NULL != name) ? name : str;
+}
+
+// environment variable name of an option (entry mentry of a _MULTI, if nonzero)
+static void env_name(char* name,
+                     size_t len,
+                     const char* section,
+                     const char* key,
+                     unsigned mentry)
+{
+    size_t ndx = 0;
+    size_t max = len - 8;  // room for "_<mentry>" and the NUL
+
+    memcpy(name, "PREFIX_", 7);
+    ndx = 7;
+
+    if( 0 != strcmp(section, "prefix") ) {
+        for( ; ('\0' != *section) && (ndx < max); section++ )
+            name[ndx++] = toupper(*section);
+        name[ndx++] = '_';
+    }
+
+    for( ; ('\0' != *key) && (ndx < max); key++ )
+        name[ndx++] = toupper(*key);
+
+    if( mentry )
+        snprintf(name + ndx, len - ndx, "_%u", mentry);
+    else
+        name[ndx] = '\0';
+}
+
+/* bulk export, rendering all set options in one pass */
+
+static int convert_value(const prefix_cfg_option_t* opt,
+                         const char* val,
+                         configurator_value_t* v);
+
+static void format_double(char* buf,
+                          size_t len,
+                          double f);
+
+typedef struct {
+    char* buf;
+    size_t cap;                 // size of buf, including the NUL
+    size_t len;                 // full rendered length, which may exceed cap
+    bool grow;                  // realloc buf as needed, rather than truncate
+    int err;
+    prefix_cfg_format_e fmt;
+    const char* section;        // open section (INI and JSON), or NULL
+    unsigned nsections;
+    unsigned nkeys;             // keys rendered in the open section
+} export_writer_t;
+
+// append n bytes, copying only what fits when not growing
+static void export_put(export_writer_t* w,
+                       const char* s,
+                       size_t n)
+{
+    char* grown;
+    size_t cap;
+    size_t avail;
+
+    if( w->grow && ((w->len + n + 1) > w->cap) && (ENOMEM != w->err) ) {
+        cap = (w->cap ? (2 * w->cap) : 4096);
+        while( cap < (w->len + n + 1) )
+            cap *= 2;
+        grown = (char*) realloc(w->buf, cap);
+        if( NULL == grown )
+            w->err = ENOMEM;
+        else {
+            w->buf = grown;
+            w->cap = cap;
+        }
+    }
+    if( (w->len + 1) < w->cap ) {
+        avail = w->cap - 1 - w->len;
+        memcpy(w->buf + w->len, s, (n < avail) ? n : avail);
+    }
+    w->len += n;
+}
+
+static void export_str(export_writer_t* w,
+                       const char* s)
+{
+    export_put(w, s, strlen(s));
+}
+
+// JSON string, escaping quotes, backslashes, and control characters
+static void export_json_string(export_writer_t* w,
+                               const char* s)
+{
+    const char* run = s;
+    char esc[8];
+
+    export_put(w, "\"", 1);
+    for( ; '\0' != *s; s++ ) {
+        if( ((unsigned char)*s >= 0x20) && ('"' != *s) && ('\\' != *s) )
+            continue;
+        export_put(w, run, (size_t)(s - run));
+        switch( *s ) {
+        case '"':  export_put(w, "\\\"", 2); break;
+        case '\\': export_put(w, "\\\\", 2); break;
+        case '\n': export_put(w, "\\n", 2); break;
+        case '\r': export_put(w, "\\r", 2); break;
+        case '\t': export_put(w, "\\t", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)(unsigned char)*s);
+            export_str(w, esc);
+        }
+        run = s + 1;
+    }
+    export_put(w, run, (size_t)(s - run));
+    export_put(w, "\"", 1);
+}
+
+// single-quoted shell word, with embedded quotes as '\''
+static void export_shell_string(export_writer_t* w,
+                                const char* s)
+{
+    const char* q;
+
+    export_put(w, "'", 1);
+    while( NULL != (q = strchr(s, '\'')) ) {
+        export_put(w, s, (size_t)(q - s));
+        export_put(w, "'\\''", 4);
+        s = q + 1;
+    }
+    export_str(w, s);
+    export_put(w, "'", 1);
+}
+
+/* INI values are written as-is, since inih has no quoting. A line break
+   would start a new line, so such values are reported as EINVAL. */
+static void export_ini_string(export_writer_t* w,
+                              const char* s)
+{
+    if( (NULL != strpbrk(s, "\r\n")) && (0 == w->err) )
+        w->err = EINVAL;
+    export_str(w, s);
+}
+
+// JSON value in the option's native type, when the string converts
+static void export_json_value(export_writer_t* w,
+                              const prefix_cfg_option_t* opt,
+                              const char* str)
+{
+    configurator_value_t v;
+    char num[32];
+
+    // RANGELIST values have no JSON form other than their string
+    if( (CONFIGURATOR_TYPE_STRING == opt->type)
+        || (CONFIGURATOR_TYPE_RANGELIST == opt->type)
+        || convert_value(opt, str, &v) ) {
+        export_json_string(w, str);
+        return;
+    }
+
+    if( CONFIGURATOR_TYPE_BOOL == opt->type )
+        export_str(w, v.b ? "true" : "false");
+    else if( CONFIGURATOR_TYPE_FLOAT == opt->type ) {
+        // inf and nan have no JSON literal
+        if( !((v.f >= -DBL_MAX) && (v.f <= DBL_MAX)) ) {
+            export_json_string(w, str);
+            return;
+        }
+        format_double(num, sizeof(num), v.f);
+        export_str(w, num);
+    }
+    else if( CONFIGURATOR_TYPE_ENUM == opt->type )
+        export_json_string(w, display_value(opt, str, &v));
+    else {
+        snprintf(num, sizeof(num), "%ld", v.i);
+        export_str(w, num);
+    }
+}
+
+static void export_section_end(export_writer_t* w)
+{
+    if( NULL == w->section )
+        return;
+    if( PREFIX_CFG_FORMAT_JSON == w->fmt )
+        export_str(w, "\n  }");
+    w->section = NULL;
+}
+
+// start an option entry (entry mentry of a _MULTI, if nonzero)
+static void export_key(export_writer_t* w,
+                       const prefix_cfg_option_t* opt,
+                       unsigned mentry)
+{
+    char name[256];
+    const char* section = opt->section;
+    const char* key = opt->key;
+
+    if( ((PREFIX_CFG_FORMAT_INI == w->fmt)
+         || (PREFIX_CFG_FORMAT_JSON == w->fmt))
+        && ((NULL == w->section) || (0 != strcmp(w->section, section))) ) {
+        export_section_end(w);
+        if( PREFIX_CFG_FORMAT_JSON == w->fmt ) {
+            export_str(w, w->nsections ? ",\n  " : "\n  ");
+            export_json_string(w, section);
+            export_str(w, ": {");
+        }
+        else {
+            export_str(w, w->nsections ? "\n[" : "[");
+            export_str(w, section);
+            export_str(w, "]\n");
+        }
+        w->section = section;
+        w->nsections++;
+        w->nkeys = 0;
+    }
+
+    switch( w->fmt ) {
+    case PREFIX_CFG_FORMAT_TEXT:
+        if( mentry )
+            snprintf(name, sizeof(name), "PREFIX CONFIG: %s.%s[%u] = ",
+                     section, key, mentry);
+        else
+            snprintf(name, sizeof(name), "PREFIX CONFIG: %s.%s = ",
+                     section, key);
+        export_str(w, name);
+        break;
+    case PREFIX_CFG_FORMAT_INI:
+        export_str(w, key);
+        export_str(w, " = ");
+        break;
+    case PREFIX_CFG_FORMAT_JSON:
+        export_str(w, w->nkeys ? ",\n    " : "\n    ");
+        export_json_string(w, key);
+        export_str(w, ": ");
+        break;
+    case PREFIX_CFG_FORMAT_ENV:
+        env_name(name, sizeof(name), section, key, mentry);
+        export_str(w, name);
+        export_put(w, "=", 1);
+        break;
+    }
+    w->nkeys++;
+}
+
+static void export_single(export_writer_t* w,
+                          const prefix_cfg_option_t* opt,
+                          const char* str,
+                          const configurator_value_t* v)
+{
+    if( NULL == str )
+        return;
+
+    export_key(w, opt, 0);
+    switch( w->fmt ) {
+    case PREFIX_CFG_FORMAT_TEXT:
+        export_str(w, display_value(opt, str, v));
+        break;
+    case PREFIX_CFG_FORMAT_INI:
+        export_ini_string(w, str);
+        break;
+    case PREFIX_CFG_FORMAT_JSON:
+        export_json_value(w, opt, str);
+        return;
+    case PREFIX_CFG_FORMAT_ENV:
+        export_shell_string(w, str);
+        break;
+    }
+    export_put(w, "\n", 1);
+}
+
+static void export_multi(export_writer_t* w,
+                         const prefix_cfg_option_t* opt,
+                         const configurator_multi_t* m)
+{
+    unsigned u;
+    const char* str;
+
+    if( 0 == m->count )
+        return;
+
+    if( PREFIX_CFG_FORMAT_JSON == w->fmt ) {
+        export_key(w, opt, 0);
+        export_put(w, "[", 1);
+        for( u=0; u < m->count; u++ ) {
+            if( u )
+                export_put(w, ", ", 2);
+            export_json_value(w, opt, configurator_multi_get(m, u));
+        }
+        export_put(w, "]", 1);
+        return;
+    }
+
+    for( u=0; u < m->count; u++ ) {
+        str = configurator_multi_get(m, u);
+        export_key(w, opt, u+1);
+        if( PREFIX_CFG_FORMAT_INI == w->fmt )
+            export_ini_string(w, str);
+        else if( PREFIX_CFG_FORMAT_ENV == w->fmt )
+            export_shell_string(w, str);
+        else
+            export_str(w, str);
+        export_put(w, "\n", 1);
+    }
+}
+
+/* render order of the option ids: schema order, except that the options
+   of a section are grouped at its first option, so each section is
+   rendered once even if its options are not contiguous (built once) */
+static int export_order[PREFIX_CFG_NUM_OPTIONS + 1];
+static int export_first[PREFIX_CFG_NUM_OPTIONS + 1]; // first id of each option's section
+static pthread_once_t export_once = PTHREAD_ONCE_INIT;
+
+static int export_section_cmp(const void* a,
+                              const void* b)
+{
+    int ida = *(const int*) a;
+    int idb = *(const int*) b;
+    int c = strcmp(prefix_cfg_options[ida].section, prefix_cfg_options[idb].section);
+
+    return c ? c : (ida - idb);
+}
+
+static int export_order_cmp(const void* a,
+                            const void* b)
+{
+    int ida = *(const int*) a;
+    int idb = *(const int*) b;
+
+    if( export_first[ida] != export_first[idb] )
+        return export_first[ida] - export_first[idb];
+    return ida - idb;
+}
+
+static void export_setup(void)
+{
+    int u;
+    int first = 0;
+
+    for( u=0; u < PREFIX_CFG_NUM_OPTIONS; u++ )
+        export_order[u] = u;
+
+    // sorted by section, the first id of each run is its section's first
+    qsort(export_order, PREFIX_CFG_NUM_OPTIONS, sizeof(int), export_section_cmp);
+    for( u=0; u < PREFIX_CFG_NUM_OPTIONS; u++ ) {
+        if( (0 == u)
+            || (0 != strcmp(prefix_cfg_options[export_order[u-1]].section,
+                            prefix_cfg_options[export_order[u]].section)) )
+            first = export_order[u];
+        export_first[export_order[u]] = first;
+    }
+    qsort(export_order, PREFIX_CFG_NUM_OPTIONS, sizeof(int), export_order_cmp);
+}
+
+static void export_render(const prefix_cfg_t* cfg,
+                          export_writer_t* w)
+{
+    int id;
+    unsigned u;
+    const char* str;
+    configurator_value_t v;
+    const prefix_cfg_option_t* opt;
+
+    pthread_once(&export_once, export_setup);
+
+    if( PREFIX_CFG_FORMAT_JSON == w->fmt )
+        export_put(w, "{", 1);
+
+    for( u=0; u < PREFIX_CFG_NUM_OPTIONS; u++ ) {
+        id = export_order[u];
+        opt = prefix_cfg_options + id;
+        if( opt->multi ) {
+            export_multi(w, opt, opt_multi(cfg, opt));
+            continue;
+        }
+        // same loads as the getters, as updates may be in progress
+        str = CONFIGURATOR_LOAD_STRING(*opt_string(cfg, opt), v);
+        __atomic_load(opt_value(cfg, opt), &v, __ATOMIC_RELAXED);
+        export_single(w, opt, str, &v);
+    }
+
+    export_section_end(w);
+    if( PREFIX_CFG_FORMAT_JSON == w->fmt )
+        export_put(w, "\n}\n", 3);
+}
+
+static int export_init(export_writer_t* w,
+                       prefix_cfg_format_e fmt,
+                       char* buf,
+                       size_t cap,
+                       bool grow)
+{
+    memset((void*)w, 0, sizeof(*w));
+    switch( fmt ) {
+    case PREFIX_CFG_FORMAT_TEXT:
+    case PREFIX_CFG_FORMAT_INI:
+    case PREFIX_CFG_FORMAT_JSON:
+    case PREFIX_CFG_FORMAT_ENV:
+        break;
+    default:
+        return EINVAL;
+    }
+    w->fmt = fmt;
+    w->buf = buf;
+    w->cap = cap;
+    w->grow = grow;
+    return 0;
+}
+
+// render cfg into buf of size *len (snprintf-like), see configurator.h
+int prefix_config_export(const prefix_cfg_t* cfg,
+                         prefix_cfg_format_e fmt,
+                         char* buf,
+                         size_t* len)
+{
+    int rc;
+    export_writer_t w;
+
+    if( (NULL == cfg) || (NULL == len) )
+        return EINVAL;
+
+    rc = export_init(&w, fmt, buf, (NULL == buf) ? 0 : *len, false);
+    if( rc )
+        return rc;
+
+    export_render(cfg, &w);
+    if( w.cap > 0 )
+        w.buf[(w.len < w.cap) ? w.len : (w.cap - 1)] = '\0';
+    *len = w.len;
+    if( w.len >= w.cap )
+        return ERANGE;
+    return w.err;
+}
+
+// render cfg into a new buffer, which the caller frees
+int prefix_config_export_alloc(const prefix_cfg_t* cfg,
+                               prefix_cfg_format_e fmt,
+                               char** buf,
+                               size_t* len)
+{
+    int rc;
+    export_writer_t w;
+
+    if( (NULL == cfg) || (NULL == buf) )
+        return EINVAL;
+    *buf = NULL;
+
+    rc = export_init(&w, fmt, NULL, 0, true);
+    if( rc )
+        return rc;
+
+    export_render(cfg, &w);
+    if( (0 == w.cap) && (0 == w.err) )
+        export_put(&w, "", 0);
+    if( ENOMEM == w.err ) {
+        free(w.buf);
+        return ENOMEM;
+    }
+    w.buf[w.len] = '\0';
+    *buf = w.buf;
+    if( NULL != len )
+        *len = w.len;
+    return w.err;
+}
+
+// render cfg and write it to fd with a single write()
+int prefix_config_export_fd(const prefix_cfg_t* cfg,
+                            prefix_cfg_format_e fmt,
+                            int fd)
+{
+    int rc;
+    char* buf = NULL;
+    size_t len = 0;
+    size_t off = 0;
+    ssize_t n;
+
+    rc = prefix_config_export_alloc(cfg, fmt, &buf, &len);
+    if( ENOMEM == rc )
+        return rc;
+
+    // write() may still be partial, e.g. for pipes and sockets
+    while( off < len ) {
+        n = write(fd, buf + off, len - off);
+        if( n < 0 ) {
+            if( EINTR == errno )
+                continue;
+            rc = errno;
+            break;
+        }
+        off += (size_t) n;
+    }
+    free(buf);
+    return rc;
+}
+
+// render cfg and write it to fp (or stderr) with a single fwrite()
+static void export_file(prefix_cfg_t* cfg,
+                        prefix_cfg_format_e fmt,
+                        FILE* fp)
+{
+    char* buf = NULL;
+    size_t len = 0;
+
+    if( NULL == fp )
+        fp = stderr;
+
+    if( ENOMEM != prefix_config_export_alloc(cfg, fmt, &buf, &len) ) {
+        fwrite(buf, 1, len, fp);
+        free(buf);
+    }
+    fflush(fp);
+}
+
+// print configuration to specified file (or stderr)
+void prefix_config_print(prefix_cfg_t* cfg,
+                         FILE* fp)
+{
+    export_file(cfg, PREFIX_CFG_FORMAT_TEXT, fp);
+}
+
+// print configuration in .INI format to specified file (or stderr)
+void prefix_config_print_ini(prefix_cfg_t* cfg,
+                             FILE* inifp)
+{
+    export_file(cfg, PREFIX_CFG_FORMAT_INI, inifp);
+}
+
+// set default values given in PREFIX_CONFIGS
+int prefix_config_set_defaults(prefix_cfg_t* cfg)
+{
+    int id;
+    const prefix_cfg_option_t* opt;
+
+    if( NULL == cfg )
+        return -1;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        cfg->_origin[id] = PREFIX_CFG_ORIGIN_UNSET;
+        if( opt->multi )
+            memset((void*)opt_multi(cfg, opt), 0, sizeof(configurator_multi_t));
+        else if( 0 != strcmp(opt->default_value, "NULLSTRING") ) {
+            if( 0 != option_replace(cfg, opt, opt->default_value) )
+                return ENOMEM;
+            cfg->_origin[id] = PREFIX_CFG_ORIGIN_DEFAULT;
+        }
+    }
+
+    return 0;
+}
+
+
+// utility routine to print CLI usage (and optional usage error message)
+void prefix_config_cli_usage(char* arg0)
+{
+    int id;
+    const prefix_cfg_option_t* opt;
+
+    fprintf(stderr, "USAGE: %s [options]\n", arg0);
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( 0 == opt->cli_opt )
+            continue;
+        if( opt->multi )
+            fprintf(stderr, "    -%c,--%s <%s>\t%s (multiple values supported - max %u entries)\n",
+                    opt->cli_opt, opt->cli_name, type_names[opt->type],
+                    opt->cli_use, opt->max_entries);
+        else
+            fprintf(stderr, "    -%c,--%s <%s>\t%s (default value: %s)\n",
+                    opt->cli_opt, opt->cli_name, type_names[opt->type],
+                    opt->cli_use, opt->default_value);
+    }
+
+    fflush(stderr);
+}
+
+// print usage error message
+void prefix_config_cli_usage_error(char* arg0,
+                                   char* err_msg)
+{
+    if( NULL != err_msg )
+        fprintf(stderr, "USAGE ERROR: %s : %s\n\n", arg0, err_msg);
+    
+    prefix_config_cli_usage(arg0);
+}
+
+/* command-line arguments are scanned in place, without permuting argv or
+   using the getopt() globals, so configs may be initialized concurrently.
+   As with getopt_long(), short options may be grouped until one taking a
+   value (even a BOOL's optional one, so -dv5 sets prefix.debug to "v5"),
+   with the value attached or in the next argument, long options may be
+   abbreviated to a unique prefix, with "=value" or the next argument,
+   BOOL values are optional (and must be attached), other arguments are
+   skipped, and "--" ends the options. */
+
+// ids of the CLI options, and the option id of each short option (built once)
+static int cli_list[PREFIX_CFG_NUM_OPTIONS + 1];
+static unsigned cli_count;
+static int cli_ids[256];
+static pthread_once_t cli_once = PTHREAD_ONCE_INIT;
+
+static void cli_setup(void)
+{
+    int c, id;
+
+    for( c=0; c < 256; c++ )
+        cli_ids[c] = -1;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        c = (unsigned char) prefix_cfg_options[id].cli_opt;
+        if( (0 == c) || (-1 != cli_ids[c]) )
+            continue;
+        cli_ids[c] = id;
+        cli_list[cli_count++] = id;
+    }
+}
+
+// id of the long option named by (a unique prefix of) name, -1 if unknown, -2 if ambiguous
+static int cli_long_option(const char* name,
+                           size_t len)
+{
+    int id;
+    int found = -1;
+    unsigned u;
+    const char* cli_name;
+
+    for( u=0; u < cli_count; u++ ) {
+        id = cli_list[u];
+        cli_name = prefix_cfg_options[id].cli_name;
+        if( 0 != strncmp(cli_name, name, len) )
+            continue;
+        if( '\0' == cli_name[len] )
+            return id;
+        found = (-1 == found) ? id : -2;
+    }
+    return found;
+}
+
+// set a CLI option (val is NULL for a BOOL given without a value)
+static int cli_set(void* arg,
+                   const prefix_cfg_option_t* opt,
+                   const char* val)
+{
+    prefix_cfg_t* cfg = (prefix_cfg_t*) arg;
+    int id = (int)(opt - prefix_cfg_options);
+
+    if( opt->multi ) {
+        origin_claim(cfg, id, PREFIX_CFG_ORIGIN_CLI);
+        return multi_append(cfg, opt_multi(cfg, opt), val);
+    }
+    if( ! origin_claim(cfg, id, PREFIX_CFG_ORIGIN_CLI) )
+        return 0;
+    return option_replace(cfg, opt, (NULL != val) ? val : "on");
+}
+
+/* scan the command line, calling fn for each option until it returns
+   nonzero. Returns fn's result, or -1 with errmsg set on a usage error. */
+static int cli_scan(int argc,
+                    char** argv,
+                    cli_option_fn fn,
+                    void* arg,
+                    char* errmsg,
+                    size_t errlen)
+{
+    int rc, i, id;
+    bool optional;
+    size_t len;
+    const char* opts;
+    const char* val;
+    const char* eq;
+    const prefix_cfg_option_t* opt;
+
+    pthread_once(&cli_once, cli_setup);
+
+    errmsg[0] = '\0';
+    for( i=1; i < argc; i++ ) {
+        opts = argv[i];
+        if( ('-' != opts[0]) || ('\0' == opts[1]) )
+            continue;
+        if( 0 == strcmp(opts, "--") )
+            break;
+
+        if( '-' == opts[1] ) {
+            opts += 2;
+            eq = strchr(opts, '=');
+            len = (NULL != eq) ? (size_t)(eq - opts) : strlen(opts);
+            id = cli_long_option(opts, len);
+            if( id < 0 ) {
+                snprintf(errmsg, errlen, "%s CLI option --%.*s",
+                         (-1 == id) ? "unknown" : "ambiguous", (int) len, opts);
+                return -1;
+            }
+            opt = prefix_cfg_options + id;
+            optional = (CONFIGURATOR_TYPE_BOOL == opt->type);
+            if( NULL != eq )
+                val = eq + 1;
+            else if( optional )
+                val = NULL;
+            else if( (i + 1) < argc )
+                val = argv[++i];
+            else {
+                snprintf(errmsg, errlen,
+                         "CLI option --%s requires operand", opt->cli_name);
+                return -1;
+            }
+            rc = fn(arg, opt, val);
+            if( rc ) return rc;
+            continue;
+        }
+
+        // grouped short options, where one taking a value ends the group
+        for( opts++; '\0' != *opts; opts++ ) {
+            id = cli_ids[(unsigned char) *opts];
+            if( -1 == id ) {
+                snprintf(errmsg, errlen, "unknown CLI option -%c", *opts);
+                return -1;
+            }
+            opt = prefix_cfg_options + id;
+            optional = (CONFIGURATOR_TYPE_BOOL == opt->type);
+            val = NULL;
+            if( '\0' != opts[1] )
+                val = opts + 1;
+            else if( (! optional) && ((i + 1) < argc) )
+                val = argv[++i];
+            else if( ! optional ) {
+                snprintf(errmsg, errlen,
+                         "CLI option -%c requires operand", *opts);
+                return -1;
+            }
+            rc = fn(arg, opt, val);
+            if( rc ) return rc;
+            if( NULL != val )
+                break;
+        }
+    }
+    return 0;
+}
+
+// update config struct based on command line args
+int prefix_config_process_cli_args(prefix_cfg_t* cfg,
+                                   int argc,
+                                   char** argv)
+{
+    int rc;
+    char errmsg[PREFIX_CFG_MAX_MSG];
+
+    if( NULL == cfg )
+        return -1;
+
+    rc = cli_scan(argc, argv, cli_set, (void*) cfg, errmsg, sizeof(errmsg));
+    if( '\0' != errmsg[0] )
+        prefix_config_cli_usage_error(argv[0], errmsg);
+    return rc;
+}
+
+// helper to check environment variable
+char* getenv_helper(const char* section,
+                    const char* key,
+                    unsigned mentry)
+{
+    char envname[256];
+
+    env_name(envname, sizeof(envname), section, key, mentry);
+
+    //fprintf(stderr, "PREFIX CONFIG DEBUG: checking env var %s\n", envname);
+    return getenv(envname);
+}
+                    
+
+// update config struct based on environment variables
 int prefix_config_process_environ(prefix_cfg_t* cfg)
 {
-    char* envval;
+    int rc;
+    int id;
+    unsigned u;
+    char* envval;
+    const prefix_cfg_option_t* opt;
+
+    if( NULL == cfg )
+        return -1;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( ! opt->multi ) {
+            envval = getenv_helper(opt->section, opt->key, 0);
+            if( (NULL != envval)
+                && origin_claim(cfg, id, PREFIX_CFG_ORIGIN_ENVIRON) ) {
+                rc = option_replace(cfg, opt, envval);
+                if( rc ) return rc;
+            }
+            continue;
+        }
+
+        /* indices may have gaps up to max-entries, and any contiguous
+           values beyond that are kept so validation can report the excess */
+        for( u=1; ; u++ ) {
+            envval = getenv_helper(opt->section, opt->key, u);
+            if( NULL != envval ) {
+                origin_claim(cfg, id, PREFIX_CFG_ORIGIN_ENVIRON);
+                rc = multi_append(cfg, opt_multi(cfg, opt), envval);
+                if( rc ) return rc;
+            }
+            else if( u >= opt->max_entries )
+                break;
+        }
+    }
+
+    return 0;
+}
+
+// inih callback handler
+int inih_config_handler(void* user,
+                        const char* section,
+                        const char* kee,
+                        const char* val)
+{
+    int id;
+    prefix_cfg_origin_e origin;
+    const prefix_cfg_option_t* opt;
+    prefix_cfg_t* cfg = (prefix_cfg_t*) user;
+    assert( NULL != cfg );
+
+    opt = prefix_config_lookup(section, kee);
+    if( NULL == opt )
+        return 1;
+    id = (int)(opt - prefix_cfg_options);
+    origin = (0 != cfg->_loading) ? (prefix_cfg_origin_e) cfg->_loading
+                                  : PREFIX_CFG_ORIGIN_SYSFILE;
+
+    if( opt->multi ) {
+        origin_claim(cfg, id, origin);
+        if( 0 != multi_append(cfg, opt_multi(cfg, opt), val) )
+            return 0;
+        return 1;
+    }
+
+    // unless set from a higher-precedence origin (e.g., CLI args)
+    if( origin_claim(cfg, id, origin)
+        && (0 != option_replace(cfg, opt, val)) )
+        return 0;
+
+    return 1;
+}
+
+/* streaming JSON config parser
+
+   Reads the file in fixed-size chunks, emitting a (section, key, value)
+   event for each scalar member. Nested objects extend the section with
+   dotted names (e.g., {"a":{"b":{"k":1}}} gives section "a.b", key "k"),
+   and each element of an array is emitted with the same key, so arrays
+   feed _MULTI options. Memory use is bounded by the longest token plus
+   the current section path, regardless of file size.
+
+   Returns 0 on success, -1 when the file cannot be opened, -2 on memory
+   allocation failure, or the line number of the first parse error. */
+
+#define PREFIX_CFG_JSON_CHUNK     4096
+#define PREFIX_CFG_JSON_MAX_DEPTH 64
+
+typedef struct {
+    int fd;
+    size_t pos;
+    size_t len;
+    int line;
+    int err;
+    cfg_strbuf_t tok;     // current string or scalar token
+    bool quoted;          // current token is a string (not a literal)
+    cfg_strbuf_t path;    // dotted section path, plus current key
+    ini_handler handler;
+    void* user;
+    char chunk[PREFIX_CFG_JSON_CHUNK];
+} json_reader_t;
+
+// record the first error (memory failures, or the current line)
+static int json_fail(json_reader_t* r,
+                     int err)
+{
+    if( 0 == r->err )
+        r->err = err ? err : r->line;
+    return r->err;
+}
+
+// peek at the next character, refilling the chunk as needed (EOF at end)
+static int json_peek(json_reader_t* r)
+{
+    ssize_t n;
+
+    if( r->pos == r->len ) {
+        do {
+            n = read(r->fd, r->chunk, sizeof(r->chunk));
+        } while( (n < 0) && (EINTR == errno) );
+        if( n <= 0 )
+            return EOF;
+        r->pos = 0;
+        r->len = (size_t) n;
+    }
+    return (unsigned char) r->chunk[r->pos];
+}
+
+static int json_next(json_reader_t* r)
+{
+    int c = json_peek(r);
+
+    if( EOF != c ) {
+        r->pos++;
+        if( '\n' == c )
+            r->line++;
+    }
+    return c;
+}
+
+// skip whitespace, returning the next character without consuming it
+static int json_skip_ws(json_reader_t* r)
+{
+    int c;
+
+    while( (' ' == (c = json_peek(r))) || ('\t' == c) || ('\n' == c) || ('\r' == c) )
+        json_next(r);
+    return c;
+}
+
+static int json_tok_char(json_reader_t* r,
+                         char c)
+{
+    if( strbuf_append(&(r->tok), &c, 1) )
+        return json_fail(r, -2);
+    return 0;
+}
+
+// append a code point to the token as UTF-8
+static int json_tok_utf8(json_reader_t* r,
+                         unsigned long cp)
+{
+    char u[4];
+    size_t n;
+
+    if( cp < 0x80 ) {
+        u[0] = (char) cp;
+        n = 1;
+    } else if( cp < 0x800 ) {
+        u[0] = (char)(0xC0 | (cp >> 6));
+        u[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if( cp < 0x10000 ) {
+        u[0] = (char)(0xE0 | (cp >> 12));
+        u[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        u[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        u[0] = (char)(0xF0 | (cp >> 18));
+        u[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        u[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        u[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    if( strbuf_append(&(r->tok), u, n) )
+        return json_fail(r, -2);
+    return 0;
+}
+
+static int json_read_hex4(json_reader_t* r,
+                          unsigned long* cp)
+{
+    int i, c;
+
+    *cp = 0;
+    for( i=0; i < 4; i++ ) {
+        c = json_next(r);
+        if( ! isxdigit(c) )
+            return json_fail(r, 0);
+        *cp = (*cp << 4)
+            | (unsigned long)(isdigit(c) ? (c - '0') : ((tolower(c) - 'a') + 10));
+    }
+    return 0;
+}
+
+// read a string token (opening quote already consumed), unescaping it
+static int json_read_string(json_reader_t* r)
+{
+    int c;
+    unsigned long cp, lo;
+
+    r->tok.len = 0;
+    if( strbuf_append(&(r->tok), "", 0) )
+        return json_fail(r, -2);
+
+    while( '"' != (c = json_next(r)) ) {
+        if( (EOF == c) || ('\n' == c) )
+            return json_fail(r, 0);
+        if( '\\' != c ) {
+            if( json_tok_char(r, (char) c) ) return r->err;
+            continue;
+        }
+        switch( c = json_next(r) ) {
+        case '"':
+        case '\\':
+        case '/': c = json_tok_char(r, (char) c); break;
+        case 'b': c = json_tok_char(r, '\b'); break;
+        case 'f': c = json_tok_char(r, '\f'); break;
+        case 'n': c = json_tok_char(r, '\n'); break;
+        case 'r': c = json_tok_char(r, '\r'); break;
+        case 't': c = json_tok_char(r, '\t'); break;
+        case 'u':
+            if( json_read_hex4(r, &cp) ) return r->err;
+            if( (cp >= 0xD800) && (cp < 0xDC00) ) {
+                // surrogate pair
+                if( ('\\' != json_next(r)) || ('u' != json_next(r))
+                    || json_read_hex4(r, &lo) || (lo < 0xDC00) || (lo > 0xDFFF) )
+                    return json_fail(r, 0);
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            c = json_tok_utf8(r, cp);
+            break;
+        default:
+            return json_fail(r, 0);
+        }
+        if( c ) return r->err;
+    }
+    return 0;
+}
+
+// read a number or literal (true, false, null) token
+static int json_read_scalar(json_reader_t* r)
+{
+    int c;
+
+    r->tok.len = 0;
+    while( (EOF != (c = json_peek(r)))
+           && (NULL == strchr(",}] \t\r\n", c)) ) {
+        if( ! (isalnum(c) || ('+' == c) || ('-' == c) || ('.' == c)) )
+            return json_fail(r, 0);
+        if( json_tok_char(r, (char) json_next(r)) ) return r->err;
+    }
+    if( 0 == r->tok.len )
+        return json_fail(r, 0);
+    return 0;
+}
+
+/* emit the current token for the key at the end of the path, where seclen
+   is the length of its section prefix (zero for top-level keys) */
+static int json_emit(json_reader_t* r,
+                     size_t seclen)
+{
+    int ok;
+    char* path = r->path.s;
+
+    if( (! r->quoted) && (0 == strcmp(r->tok.s, "null")) )
+        return 0;
+
+    if( 0 == seclen )
+        ok = r->handler(r->user, "", path, r->tok.s);
+    else {
+        path[seclen] = '\0';
+        ok = r->handler(r->user, path, path + seclen + 1, r->tok.s);
+        path[seclen] = '.';
+    }
+    return ok ? 0 : json_fail(r, 0);
+}
+
+static int json_parse_object(json_reader_t* r,
+                             int depth);
+
+// parse a member value (or array element) for the key ending the path
+static int json_parse_value(json_reader_t* r,
+                            size_t seclen,
+                            int depth)
+{
+    int c = json_skip_ws(r);
+
+    if( depth > PREFIX_CFG_JSON_MAX_DEPTH )
+        return json_fail(r, 0);
+
+    if( '{' == c ) {
+        json_next(r);
+        return json_parse_object(r, depth + 1);
+    }
+    else if( '[' == c ) {
+        json_next(r);
+        if( ']' == json_skip_ws(r) ) {
+            json_next(r);
+            return 0;
+        }
+        for( ;; ) {
+            if( json_parse_value(r, seclen, depth + 1) ) return r->err;
+            c = json_skip_ws(r);
+            json_next(r);
+            if( ']' == c ) return 0;
+            if( ',' != c ) return json_fail(r, 0);
+        }
+    }
+    r->quoted = ('"' == c);
+    if( r->quoted ) {
+        json_next(r);
+        if( json_read_string(r) ) return r->err;
+    }
+    else if( json_read_scalar(r) )
+        return r->err;
+
+    return json_emit(r, seclen);
+}
+
+// parse object members (opening brace already consumed)
+static int json_parse_object(json_reader_t* r,
+                             int depth)
+{
+    int c;
+    size_t seclen = r->path.len;
+
+    if( '}' == json_skip_ws(r) ) {
+        json_next(r);
+        return 0;
+    }
+    for( ;; ) {
+        // member name extends the path as the current key
+        json_skip_ws(r);
+        if( '"' != json_next(r) ) return json_fail(r, 0);
+        if( json_read_string(r) ) return r->err;
+        if( ( (0 != seclen) && strbuf_append(&(r->path), ".", 1) )
+            || strbuf_append(&(r->path), r->tok.s, r->tok.len) )
+            return json_fail(r, -2);
+
+        if( ':' != json_skip_ws(r) ) return json_fail(r, 0);
+        json_next(r);
+        if( json_parse_value(r, seclen, depth) ) return r->err;
+
+        r->path.len = seclen;
+        r->path.s[seclen] = '\0';
+
+        c = json_skip_ws(r);
+        json_next(r);
+        if( '}' == c ) return 0;
+        if( ',' != c ) return json_fail(r, 0);
+    }
+}
+
+int json_parse(const char* filename,
+               ini_handler handler,
+               void* user)
+{
+    int rc;
+    json_reader_t* r;
+
+    r = (json_reader_t*) calloc(1, sizeof(json_reader_t));
+    if( NULL == r )
+        return -2;
+
+    r->fd = open(filename, O_RDONLY);
+    if( -1 == r->fd ) {
+        free(r);
+        return -1;
+    }
+    r->line = 1;
+    r->handler = handler;
+    r->user = user;
+
+    if( strbuf_append(&(r->path), "", 0) )
+        json_fail(r, -2);
+    else if( '{' != json_skip_ws(r) )
+        json_fail(r, 0);
+    else {
+        json_next(r);
+        if( (0 == json_parse_object(r, 1)) && (EOF != json_skip_ws(r)) )
+            json_fail(r, 0);
+    }
+
+    rc = r->err;
+    close(r->fd);
+    free(r->tok.s);
+    free(r->path.s);
+    free(r);
+    return rc;
+}
+
+/* single-pass YAML config parser
+
+   Supports the block-mapping subset of YAML used for configuration:
+   top-level keys without values start a section, nested keys extend it
+   with dotted names (as for JSON), and "key: value" lines set values.
+   Values may be plain, 'single-quoted', or "double-quoted" scalars, and
+   block ("- item") or flow ("[a, b]") sequences give multiple values for
+   a key, as used by _MULTI options. Comments and document markers are
+   skipped. Null values (~ or null) are ignored.
+
+   The file is mapped and scanned in one pass, with keys and values copied
+   into fixed buffers in the parser state, so there is no heap allocation.
+
+   Returns 0 on success, -1 when the file cannot be opened, or the line
+   number of the first parse error. */
+
+#define PREFIX_CFG_YAML_MAX_DEPTH 16
+#define PREFIX_CFG_YAML_MAX_VALUE 4096
+
+typedef struct {
+    int line;
+    ini_handler handler;
+    void* user;
+    unsigned depth;                           // open mapping keys
+    int indent[PREFIX_CFG_YAML_MAX_DEPTH];    // indentation of each key
+    size_t seclen[PREFIX_CFG_YAML_MAX_DEPTH]; // path length before each key
+    size_t keyend[PREFIX_CFG_YAML_MAX_DEPTH]; // path length after each key
+    char path[PREFIX_CFG_MAX_MSG];            // dotted names of open keys
+    char key[PREFIX_CFG_MAX_MSG];
+    char val[PREFIX_CFG_YAML_MAX_VALUE];
+    bool quoted;                              // last scalar was quoted
+} yaml_reader_t;
+
+// copy the scalar in [s, e) into r->val, removing quotes and escapes
+static int yaml_scalar(yaml_reader_t* r,
+                       const char* s,
+                       const char* e)
+{
+    size_t n = 0;
+    char q = *s;
+    char c;
+
+    r->quoted = (('"' == q) || ('\'' == q));
+    if( r->quoted ) {
+        if( ((e - s) < 2) || (q != e[-1]) )
+            return r->line;
+        for( s++, e--; s < e; s++ ) {
+            c = *s;
+            if( ('\'' == q) && ('\'' == c) ) {
+                if( ((s + 1) == e) || ('\'' != *(++s)) )
+                    return r->line;
+            }
+            else if( ('"' == q) && ('\\' == c) ) {
+                if( (++s) == e )
+                    return r->line;
+                switch( *s ) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                case '"':
+                case '\\':
+                case '/': c = *s; break;
+                default: return r->line;
+                }
+            }
+            else if( (('"' == q) && ('"' == c)) )
+                return r->line;
+            if( n == (sizeof(r->val) - 1) )
+                return r->line;
+            r->val[n++] = c;
+        }
+    }
+    else {
+        if( (size_t)(e - s) >= sizeof(r->val) )
+            return r->line;
+        n = (size_t)(e - s);
+        memcpy(r->val, s, n);
+    }
+    r->val[n] = '\0';
+    return 0;
+}
+
+// emit r->val for key in the section given by the first seclen path chars
+static int yaml_emit(yaml_reader_t* r,
+                     size_t seclen,
+                     const char* key)
+{
+    int ok;
+
+    if( (! r->quoted)
+        && ((0 == strcmp(r->val, "~")) || (0 == strcmp(r->val, "null"))) )
+        return 0;
+
+    if( 0 == seclen )
+        ok = r->handler(r->user, "", key, r->val);
+    else {
+        r->path[seclen] = '\0';
+        ok = r->handler(r->user, r->path, key, r->val);
+        r->path[seclen] = '.';
+    }
+    return ok ? 0 : r->line;
+}
+
+static int yaml_space(char c)
+{
+    return ((' ' == c) || ('\t' == c));
+}
+
+// find the end of a (possibly quoted) scalar starting at s
+static const char* yaml_scalar_end(const char* s,
+                                   const char* e,
+                                   char stop)
+{
+    char q = *s;
+
+    if( ('"' == q) || ('\'' == q) ) {
+        for( s++; s < e; s++ ) {
+            if( ('"' == q) && ('\\' == *s) && ((s + 1) < e) )
+                s++;
+            else if( q == *s )
+                return s + 1;
+        }
+        return e;
+    }
+    while( (s < e) && (stop != *s) )
+        s++;
+    return s;
+}
+
+// emit each element of the flow sequence in [s, e), i.e. "[a, b, ...]"
+static int yaml_flow_sequence(yaml_reader_t* r,
+                              size_t seclen,
+                              const char* s,
+                              const char* e)
+{
+    int rc;
+    const char* iend;
+    const char* next;
+
+    if( ']' != e[-1] )
+        return r->line;
+    for( s++, e--; s < e; s = next + 1 ) {
+        while( (s < e) && yaml_space(*s) )
+            s++;
+        iend = yaml_scalar_end(s, e, ',');
+        next = iend;
+        while( (next < e) && yaml_space(*next) )
+            next++;
+        if( (next < e) && (',' != *next) )
+            return r->line;
+        while( (iend > s) && yaml_space(iend[-1]) )
+            iend--;
+        if( s < iend ) {
+            rc = yaml_scalar(r, s, iend);
+            if( 0 == rc ) rc = yaml_emit(r, seclen, r->key);
+            if( rc ) return rc;
+        }
+        if( next == e )
+            break;
+    }
+    return 0;
+}
+
+// process the content [s, e) of a line indented by indent spaces
+static int yaml_line(yaml_reader_t* r,
+                     int indent,
+                     const char* s,
+                     const char* e)
+{
+    int rc;
+    size_t len;
+    size_t sec;
+    const char* kend;
+    const char* v;
+    int item = (('-' == *s) && (((s + 1) == e) || yaml_space(s[1])));
+
+    // close keys indented deeper than this line, or as deep for mapping
+    // entries (sequence items may share the indentation of their key)
+    while( (r->depth > 0)
+           && ((r->indent[r->depth - 1] > indent)
+               || ((! item) && (r->indent[r->depth - 1] == indent))) )
+        r->depth--;
+    len = (r->depth > 0) ? r->keyend[r->depth - 1] : 0;
+    r->path[len] = '\0';
+
+    if( item ) {
+        // value for the innermost open key
+        if( 0 == r->depth )
+            return r->line;
+        for( v = s + 1; (v < e) && yaml_space(*v); v++ ) ;
+        if( v == e )
+            return r->line;
+        rc = yaml_scalar(r, v, e);
+        if( 0 == rc ) {
+            sec = r->seclen[r->depth - 1];
+            rc = yaml_emit(r, sec, r->path + sec + ((0 != sec) ? 1 : 0));
+        }
+        return rc;
+    }
+
+    // find the "key:" separator, where plain keys may contain other colons
+    if( ('"' == *s) || ('\'' == *s) ) {
+        kend = yaml_scalar_end(s, e, ':');
+        for( v = kend; (v < e) && yaml_space(*v); v++ ) ;
+    }
+    else {
+        for( v = s; v < e; v++ ) {
+            if( (':' == *v) && (((v + 1) == e) || yaml_space(v[1])) )
+                break;
+        }
+        for( kend = v; (kend > s) && yaml_space(kend[-1]); kend-- ) ;
+    }
+    if( (v == e) || (':' != *v) || (kend == s) )
+        return r->line;
+    rc = yaml_scalar(r, s, kend);
+    if( rc ) return rc;
+    if( strlen(r->val) >= sizeof(r->key) )
+        return r->line;
+    strcpy(r->key, r->val);
+
+    for( v++; (v < e) && yaml_space(*v); v++ ) ;
+    if( v == e ) {
+        // key without a value opens a nested mapping or a block sequence
+        if( (PREFIX_CFG_YAML_MAX_DEPTH == r->depth)
+            || ((len + strlen(r->key) + 2) > sizeof(r->path)) )
+            return r->line;
+        r->indent[r->depth] = indent;
+        r->seclen[r->depth] = len;
+        if( 0 != len )
+            r->path[len++] = '.';
+        strcpy(r->path + len, r->key);
+        r->keyend[r->depth] = len + strlen(r->key);
+        r->depth++;
+        return 0;
+    }
+    else if( '[' == *v )
+        return yaml_flow_sequence(r, len, v, e);
+    else if( NULL != strchr("{|>&*!", *v) )
+        return r->line; // unsupported YAML features
+
+    rc = yaml_scalar(r, v, e);
+    if( 0 == rc )
+        rc = yaml_emit(r, len, r->key);
+    return rc;
+}
+
+static int yaml_parse_buffer(yaml_reader_t* r,
+                             const char* p,
+                             const char* end)
+{
+    int rc;
+    int indent;
+    char inq;
+    const char* s;
+    const char* e;
+    const char* eol;
+
+    for( r->line = 1; p < end; p = eol + 1, r->line++ ) {
+        eol = (const char*) memchr(p, '\n', (size_t)(end - p));
+        if( NULL == eol )
+            eol = end;
+
+        for( s = p; (s < eol) && (' ' == *s); s++ ) ;
+        indent = (int)(s - p);
+
+        // strip comment, i.e. '#' at start or after whitespace, unquoted
+        for( e = s, inq = 0; e < eol; e++ ) {
+            if( inq ) {
+                if( ('"' == inq) && ('\\' == *e) && ((e + 1) < eol) )
+                    e++;
+                else if( inq == *e )
+                    inq = 0;
+            }
+            else if( ('"' == *e) || ('\'' == *e) )
+                inq = *e;
+            else if( ('#' == *e) && ((e == s) || yaml_space(e[-1])) )
+                break;
+        }
+        while( (e > s) && (yaml_space(e[-1]) || ('\r' == e[-1])) )
+            e--;
+        if( s == e )
+            continue;
+        if( '\t' == *s )
+            return r->line; // tabs may not be used for indentation
+        if( (0 == indent) && ((e - s) == 3)
+            && ((0 == strncmp(s, "---", 3)) || (0 == strncmp(s, "...", 3))) )
+            continue;
+
+        rc = yaml_line(r, indent, s, e);
+        if( rc ) return rc;
+    }
+    return 0;
+}
+
+static int yaml_parse(const char* filename,
+                      ini_handler handler,
+                      void* user)
+{
+    int fd;
+    int rc;
+    struct stat st;
+    char* map;
+    yaml_reader_t r;
+
+    fd = open(filename, O_RDONLY);
+    if( -1 == fd )
+        return -1;
+    if( 0 != fstat(fd, &st) ) {
+        close(fd);
+        return -1;
+    }
+    if( 0 == st.st_size ) {
+        close(fd);
+        return 0;
+    }
+    map = (char*) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( MAP_FAILED == map )
+        return -1;
+
+    memset((void*)&r, 0, offsetof(yaml_reader_t, path));
+    r.path[0] = '\0';
+    r.handler = handler;
+    r.user = user;
+    rc = yaml_parse_buffer(&r, map, map + st.st_size);
+
+    munmap(map, (size_t) st.st_size);
+    return rc;
+}
+
+int ini_error_handler(const int errcode, const char* file_path) {
+    int rc;
+    char errmsg[PREFIX_CFG_MAX_MSG];
+    switch( errcode ) {
+    case 0:
+        rc = 0;
+        break;
+    case -1:
+        snprintf(errmsg, sizeof(errmsg),
+                 "failed to open config file %s",
+                 file_path);
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        rc = ENOENT;
+        break;
+    case -2:
+        snprintf(errmsg, sizeof(errmsg),
+                 "failed to parse config file %s",
+                 file_path);
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        rc = ENOMEM;
+        break;
+    default:
+        /* > 0  indicates parse error at line */
+        if( errcode > 0 )
+            snprintf(errmsg, sizeof(errmsg),
+                     "parse error at line %d of config file %s",
+                     errcode, file_path);
+        else
+            snprintf(errmsg, sizeof(errmsg),
+                     "failed to parse config file %s",
+                     file_path);
+        rc = EINVAL;
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        break;
+    }
+    return rc;
+}
+
+int json_error_handler(const int errcode, const char* file_path)
+{
+    int rc;
+    char errmsg[PREFIX_CFG_MAX_MSG];
+    switch( errcode ) {
+    case 0:
+            rc = 0;
+        break;
+    case -1:
+        snprintf(errmsg, sizeof(errmsg),
+                     "failed to open config file %s",
+                     file_path);
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        rc = ENOENT;
+        break;
+    case -2:
+        snprintf(errmsg, sizeof(errmsg),
+                     "failed to parse config file %s",
+                     file_path);
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        rc = ENOMEM;
+        break;
+    default:
+        /* > 0  indicates parse error at line */
+        if( errcode > 0 )
+            snprintf(errmsg, sizeof(errmsg),
+                     "parse error at line %d of config file %s",
+                     errcode, file_path);
+        else
+            snprintf(errmsg, sizeof(errmsg),
+                     "failed to parse config file %s",
+                     file_path);
+        rc = EINVAL;
+        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
+        break;
+    }
+    return rc;
+}
+
+static int yaml_error_handler(const int errcode, const char* file_path)
+{
+    // yaml_parse() reports errors the same way as inih
+    return ini_error_handler(errcode, file_path);
+}
+
+// parse a config file of any supported format, passing values to handler
+static int parse_file(const char* file,
+                      ini_handler handler,
+                      void* user)
+{
+    int rc;
+
+    // Determine the filetype based on extension
+    const char* ext = strrchr(file, '.');
+    if (!ext) {
+        // no extension, so assume ini
+        ext = "ini";
+    }
+    else
+    {
+        ext++;
+    }
+
+    if (strcmp(ext, "json") == 0) {
+        const int json_error = json_parse(file, handler, user);
+        rc = json_error_handler(json_error, file);
+    }
+    else if (strcmp(ext, "yaml") == 0 || strcmp(ext, "yml") == 0) {
+        const int yaml_error = yaml_parse(file, handler, user);
+        rc = yaml_error_handler(yaml_error, file);
+    }
+    else {
+        // .cfg, .ini, .conf, or other, so assume ini
+        const int ini_error = ini_parse(file, handler, user);
+        rc = ini_error_handler(ini_error, file);
+    }
+    return rc;
+}
+
+// update config struct based on config file, using inih
+int prefix_config_process_file(prefix_cfg_t* cfg,
+                               const char* file)
+{
+    int rc;
+    unsigned long long t;
+    configurator_stats_t st;
+
+    if( NULL == cfg )
+        return EINVAL;
+    
+    if( NULL == file )
+        return EINVAL;
+
+    memset((void*)&st, 0, sizeof(st));
+    t = profile_clock(cfg);
+    if( NULL != cfg->_profile )
+        st = cfg->_profile->phase[cfg->_profile->current];
+
+    rc = parse_file(file, inih_config_handler, cfg);
+
+    if( NULL != cfg->_profile )
+        profile_file(cfg, file, t, st.keys, st.allocs, st.bytes);
+
+    return rc;
+}
+
+
+/* config fragments
+
+   When the schema has prefix.configdir (a directory) and/or
+   prefix.fragments (a _MULTI list of files), each named file is parsed
+   concurrently into its own staging table. The tables are then merged in
+   order: the directory's config files sorted by name, followed by the
+   listed files. Like the command-line config file, a fragment only sets
+   options still at their default values, except that later fragments
+   override earlier ones. */
+
+#define PREFIX_CFG_FRAGMENT_THREADS 16
+
+typedef struct {
+    char* section;
+    char* key;
+    char* val;
+} fragment_entry_t;
+
+// staging table for one fragment file
+typedef struct {
+    char* file;
+    fragment_entry_t* ents;
+    size_t count;
+    size_t cap;
+    int rc;                       // parse result
+    unsigned long long nsecs;     // parse time, when profiling
+} fragment_t;
+
+typedef struct {
+    fragment_t* frags;
+    unsigned count;
+    unsigned next;                // next fragment to parse, claimed atomically
+    bool profile;
+} fragment_set_t;
+
+// inih callback handler that stages values in a fragment_t
+static int fragment_handler(void* user,
+                            const char* section,
+                            const char* kee,
+                            const char* val)
+{
+    size_t cap;
+    fragment_entry_t* grown;
+    fragment_entry_t* e;
+    fragment_t* f = (fragment_t*) user;
+
+    if( f->count == f->cap ) {
+        cap = f->cap ? (2 * f->cap) : 32;
+        grown = (fragment_entry_t*) realloc(f->ents, cap * sizeof(*grown));
+        if( NULL == grown )
+            return 0;
+        f->ents = grown;
+        f->cap = cap;
+    }
+    e = f->ents + f->count;
+    e->section = strdup(section);
+    e->key = strdup(kee);
+    e->val = strdup(val);
+    if( (NULL == e->section) || (NULL == e->key) || (NULL == e->val) ) {
+        free(e->section);
+        free(e->key);
+        free(e->val);
+        return 0;
+    }
+    f->count++;
+    return 1;
+}
+
+static void* fragment_worker(void* arg)
+{
+    fragment_set_t* fs = (fragment_set_t*) arg;
+    fragment_t* f;
+    unsigned long long t = 0;
+    unsigned i;
+
+    while( (i = __atomic_fetch_add(&(fs->next), 1, __ATOMIC_RELAXED)) < fs->count ) {
+        f = fs->frags + i;
+        if( fs->profile )
+            t = profile_now();
+        f->rc = parse_file(f->file, fragment_handler, f);
+        if( fs->profile )
+            f->nsecs = profile_now() - t;
+    }
+    return NULL;
+}
+
+// only config files are used from the fragment directory
+static int fragment_is_config(const char* name)
+{
+    const char* ext = strrchr(name, '.');
+
+    // skip hidden files and those without an extension (e.g., backups)
+    if( ('.' == name[0]) || (NULL == ext) )
+        return 0;
+    ext++;
+    return ( (0 == strcmp(ext, "conf")) || (0 == strcmp(ext, "cfg"))
+             || (0 == strcmp(ext, "ini")) || (0 == strcmp(ext, "json"))
+             || (0 == strcmp(ext, "yaml")) || (0 == strcmp(ext, "yml")) );
+}
+
+static int fragment_name_cmp(const void* a,
+                             const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void fragment_list_free(char** files,
+                               unsigned count)
+{
+    unsigned u;
+
+    for( u=0; u < count; u++ )
+        free(files[u]);
+    free(files);
+}
+
+static int fragment_list_add(char*** files,
+                             unsigned* count,
+                             unsigned* cap,
+                             char* file)
+{
+    char** grown;
+
+    if( NULL == file )
+        return ENOMEM;
+    if( *count == *cap ) {
+        *cap = *cap ? (2 * *cap) : 16;
+        grown = (char**) realloc(*files, *cap * sizeof(char*));
+        if( NULL == grown ) {
+            free(file);
+            return ENOMEM;
+        }
+        *files = grown;
+    }
+    (*files)[(*count)++] = file;
+    return 0;
+}
+
+/* list fragment files in merge order: config files in prefix.configdir,
+   sorted by name, then those in prefix.fragments */
+static int fragment_list(prefix_cfg_t* cfg,
+                         char*** out_files,
+                         unsigned* out_count)
+{
+    int rc = 0;
+    int id;
+    unsigned u;
+    unsigned count = 0;
+    unsigned cap = 0;
+    size_t len;
+    char* path;
+    char** files = NULL;
+    char** dir;
+    configurator_multi_t* m;
+    DIR* dp;
+    struct dirent* de;
+
+    id = option_id("prefix", "configdir");
+    dir = (id >= 0) ? option_string(cfg, id) : NULL;
+    if( (NULL != dir) && (NULL != *dir) ) {
+        dp = opendir(*dir);
+        if( NULL == dp ) {
+            rc = errno;
+            fprintf(stderr, "PREFIX CONFIG ERROR: failed to open config directory %s - %s\n",
+                    *dir, strerror(rc));
+            return rc;
+        }
+        while( (0 == rc) && (NULL != (de = readdir(dp))) ) {
+            if( (DT_DIR == de->d_type) || (! fragment_is_config(de->d_name)) )
+                continue;
+            len = strlen(*dir) + strlen(de->d_name) + 2;
+            path = (char*) malloc(len);
+            if( NULL != path )
+                snprintf(path, len, "%s/%s", *dir, de->d_name);
+            rc = fragment_list_add(&files, &count, &cap, path);
+        }
+        closedir(dp);
+        if( count > 1 )
+            qsort(files, count, sizeof(char*), fragment_name_cmp);
+    }
+
+    id = option_id("prefix", "fragments");
+    m = (id >= 0) ? option_multi(cfg, id) : NULL;
+    for( u=0; (0 == rc) && (NULL != m) && (u < m->count); u++ )
+        rc = fragment_list_add(&files, &count, &cap,
+                               strdup(configurator_multi_get(m, u)));
+
+    if( rc ) {
+        fragment_list_free(files, count);
+        return rc;
+    }
+    *out_files = files;
+    *out_count = count;
+    return 0;
+}
+
+/* merge the staged values of a fragment or source, overriding
+   those of no higher precedence than origin */
+static int stage_merge(prefix_cfg_t* cfg,
+                       const fragment_t* stage,
+                       prefix_cfg_origin_e origin)
+{
+    int rc;
+    int id;
+    size_t i;
+    const fragment_entry_t* e;
+    const prefix_cfg_option_t* opt;
+
+    for( i=0; i < stage->count; i++ ) {
+        e = stage->ents + i;
+        opt = prefix_config_lookup(e->section, e->key);
+        if( NULL == opt )
+            continue;
+        id = (int)(opt - prefix_cfg_options);
+
+        if( opt->multi ) {
+            origin_claim(cfg, id, origin);
+            rc = multi_append(cfg, opt_multi(cfg, opt), e->val);
+            if( rc ) return rc;
+            continue;
+        }
+
+        if( origin_claim(cfg, id, origin) ) {
+            rc = option_replace(cfg, opt, e->val);
+            if( rc ) return rc;
+        }
+    }
+    return 0;
+}
+
+static void fragment_free(fragment_t* f)
+{
+    size_t i;
+
+    for( i=0; i < f->count; i++ ) {
+        free(f->ents[i].section);
+        free(f->ents[i].key);
+        free(f->ents[i].val);
+    }
+    free(f->ents);
+}
+
+// parse config fragments concurrently, then merge them in order
+int prefix_config_process_fragments(prefix_cfg_t* cfg)
+{
+    int rc;
+    unsigned u, t;
+    unsigned nthreads = 0;
+    unsigned long long start;
+    char** files = NULL;
+    configurator_stats_t st;
+    fragment_set_t fs;
+    pthread_t threads[PREFIX_CFG_FRAGMENT_THREADS];
+
+    if( NULL == cfg )
+        return EINVAL;
+
+    memset((void*)&fs, 0, sizeof(fs));
+    rc = fragment_list(cfg, &files, &(fs.count));
+    if( rc || (0 == fs.count) )
+        return rc;
+
+    fs.frags = (fragment_t*) calloc(fs.count, sizeof(fragment_t));
+    if( NULL == fs.frags ) {
+        fragment_list_free(files, fs.count);
+        return ENOMEM;
+    }
+    for( u=0; u < fs.count; u++ )
+        fs.frags[u].file = files[u];
+    fs.profile = (NULL != cfg->_profile);
+
+    // the calling thread works too, so one fragment needs no helpers
+    while( ((nthreads + 1) < fs.count) && (nthreads < PREFIX_CFG_FRAGMENT_THREADS) ) {
+        if( 0 != pthread_create(&threads[nthreads], NULL, fragment_worker, &fs) )
+            break;
+        nthreads++;
+    }
+    fragment_worker(&fs);
+    for( t=0; t < nthreads; t++ )
+        pthread_join(threads[t], NULL);
+
+    // report the first failure in merge order
+    for( u=0; (0 == rc) && (u < fs.count); u++ )
+        rc = fs.frags[u].rc;
+
+    for( u=0; (0 == rc) && (u < fs.count); u++ ) {
+        memset((void*)&st, 0, sizeof(st));
+        start = profile_clock(cfg);
+        if( NULL != cfg->_profile )
+            st = cfg->_profile->phase[cfg->_profile->current];
+        rc = stage_merge(cfg, fs.frags + u, PREFIX_CFG_ORIGIN_FRAGMENT);
+        // per-file time is the (concurrent) parse plus the merge
+        if( NULL != cfg->_profile )
+            profile_file(cfg, fs.frags[u].file, start - fs.frags[u].nsecs,
+                         st.keys, st.allocs, st.bytes);
+    }
+
+    for( u=0; u < fs.count; u++ )
+        fragment_free(fs.frags + u);
+    free(fs.frags);
+    fragment_list_free(files, fs.count);
+    return rc;
+}
+
+/* configuration sources. Registered sources are copied at the start of
+   each initialization, and fetched concurrently into their own staging
+   tables (as for fragments), which are merged at each source's slot. A
+   fetch that times out is abandoned to its thread, which frees it. */
+
+static prefix_cfg_source_t sources[PREFIX_CFG_MAX_SOURCES];
+static unsigned num_sources;
+static pthread_mutex_t sources_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct configurator_fetch {
+    prefix_cfg_source_t src;
+    fragment_t stage;
+    int rc;                       // fetch result
+    bool done;
+    bool abandoned;               // no longer waited for, freed by its thread
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    struct timespec deadline;     // CLOCK_REALTIME, when timeout_ms is set
+    unsigned long long nsecs;     // fetch time
+};
+
+// register a source for later initializations
+int prefix_config_add_source(const prefix_cfg_source_t* src)
+{
+    unsigned u;
+    int rc = 0;
+
+    if( (NULL == src) || (NULL == src->name) || (NULL == src->fetch)
+        || (src->slot > PREFIX_CFG_SOURCE_CLI) )
+        return EINVAL;
+
+    pthread_mutex_lock(&sources_lock);
+    for( u=0; u < num_sources; u++ ) {
+        if( 0 == strcmp(sources[u].name, src->name) )
+            rc = EEXIST;
+    }
+    if( (0 == rc) && (num_sources == PREFIX_CFG_MAX_SOURCES) )
+        rc = ENOSPC;
+    if( 0 == rc )
+        sources[num_sources++] = *src;
+    pthread_mutex_unlock(&sources_lock);
+    return rc;
+}
+
+int prefix_config_remove_source(const char* name)
+{
+    unsigned u;
+    int rc = ENOENT;
+
+    if( NULL == name )
+        return EINVAL;
+
+    pthread_mutex_lock(&sources_lock);
+    for( u=0; u < num_sources; u++ ) {
+        if( 0 == strcmp(sources[u].name, name) ) {
+            memmove(sources + u, sources + u + 1,
+                    (num_sources - u - 1) * sizeof(prefix_cfg_source_t));
+            num_sources--;
+            rc = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sources_lock);
+    return rc;
+}
+
+static bool sources_registered(void)
+{
+    return (0 != __atomic_load_n(&num_sources, __ATOMIC_RELAXED));
+}
+
+static void fetch_free(struct configurator_fetch* f)
+{
+    if( f->threaded ) {
+        pthread_mutex_destroy(&(f->lock));
+        pthread_cond_destroy(&(f->cv));
+    }
+    fragment_free(&(f->stage));
+    free(f);
+}
+
+static void fetch_run(struct configurator_fetch* f)
+{
+    unsigned long long t = profile_now();
+
+    f->rc = f->src.fetch(f->src.ctx, prefix_cfg_options, PREFIX_CFG_NUM_OPTIONS,
+                         f->src.timeout_ms, fragment_handler, &(f->stage));
+    f->nsecs = profile_now() - t;
+}
+
+static void* fetch_worker(void* arg)
+{
+    bool abandoned;
+    struct configurator_fetch* f = (struct configurator_fetch*) arg;
+
+    fetch_run(f);
+
+    pthread_mutex_lock(&(f->lock));
+    f->done = true;
+    abandoned = f->abandoned;
+    pthread_cond_signal(&(f->cv));
+    pthread_mutex_unlock(&(f->lock));
+
+    if( abandoned )
+        fetch_free(f);
+    return NULL;
+}
+
+// start fetching all registered sources, returning how many
+static unsigned sources_start(struct configurator_fetch** fetches)
+{
+    unsigned u;
+    unsigned n = 0;
+    unsigned long long ns;
+    struct configurator_fetch* f;
+    prefix_cfg_source_t srcs[PREFIX_CFG_MAX_SOURCES];
+    unsigned count;
+
+    if( ! sources_registered() )
+        return 0;
+
+    pthread_mutex_lock(&sources_lock);
+    count = num_sources;
+    memcpy(srcs, sources, count * sizeof(prefix_cfg_source_t));
+    pthread_mutex_unlock(&sources_lock);
+
+    for( u=0; u < count; u++ ) {
+        f = (struct configurator_fetch*) calloc(1, sizeof(struct configurator_fetch));
+        if( NULL == f )
+            break;
+        f->src = srcs[u];
+        f->stage.file = (char*) f->src.name;
+        fetches[n++] = f;
+
+        if( f->src.timeout_ms ) {
+            clock_gettime(CLOCK_REALTIME, &(f->deadline));
+            ns = (unsigned long long) f->deadline.tv_nsec
+                + (f->src.timeout_ms * 1000000ULL);
+            f->deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+            f->deadline.tv_nsec = (long)(ns % 1000000000ULL);
+        }
+
+        // sources that cannot be fetched in the background are fetched when merged
+        pthread_mutex_init(&(f->lock), NULL);
+        pthread_cond_init(&(f->cv), NULL);
+        f->threaded = true;
+        if( 0 != pthread_create(&(f->thread), NULL, fetch_worker, f) ) {
+            pthread_mutex_destroy(&(f->lock));
+            pthread_cond_destroy(&(f->cv));
+            f->threaded = false;
+        }
+        else
+            pthread_detach(f->thread);
+    }
+    return n;
+}
+
+// wait for a fetch, returning its result (*fp is cleared if abandoned at its deadline)
+static int fetch_wait(struct configurator_fetch** fp)
+{
+    int rc = 0;
+    struct configurator_fetch* f = *fp;
+
+    if( ! f->threaded ) {
+        fetch_run(f);
+        return f->rc;
+    }
+
+    pthread_mutex_lock(&(f->lock));
+    while( (! f->done) && (ETIMEDOUT != rc) ) {
+        if( f->src.timeout_ms )
+            rc = pthread_cond_timedwait(&(f->cv), &(f->lock), &(f->deadline));
+        else
+            pthread_cond_wait(&(f->cv), &(f->lock));
+    }
+    if( ! f->done ) {
+        // freed by its thread from now on
+        f->abandoned = true;
+        pthread_mutex_unlock(&(f->lock));
+        *fp = NULL;
+        return ETIMEDOUT;
+    }
+    pthread_mutex_unlock(&(f->lock));
+    return f->rc;
+}
+
+// release fetches not merged (after a failure), abandoning any in progress
+static void sources_finish(struct configurator_fetch** fetches,
+                           unsigned count)
+{
+    unsigned u;
+    bool done;
+    struct configurator_fetch* f;
+
+    for( u=0; u < count; u++ ) {
+        f = fetches[u];
+        if( NULL == f )
+            continue;
+        done = true;
+        if( f->threaded ) {
+            pthread_mutex_lock(&(f->lock));
+            done = f->done;
+            f->abandoned = ! done;
+            pthread_mutex_unlock(&(f->lock));
+        }
+        if( done )
+            fetch_free(f);
+        fetches[u] = NULL;
+    }
+}
+
+// merge the sources in a slot, in registration order
+static int sources_merge(prefix_cfg_t* cfg,
+                         struct configurator_fetch** fetches,
+                         unsigned count,
+                         prefix_cfg_source_slot_e slot)
+{
+    int rc = 0;
+    unsigned u;
+    unsigned long long start;
+    configurator_stats_t st;
+    prefix_cfg_source_t src;
+    struct configurator_fetch* f;
+
+    for( u=0; (0 == rc) && (u < count); u++ ) {
+        f = fetches[u];
+        if( (NULL == f) || (slot != f->src.slot) )
+            continue;
+
+        memset((void*)&st, 0, sizeof(st));
+        start = profile_clock(cfg);
+        if( NULL != cfg->_profile )
+            st = cfg->_profile->phase[cfg->_profile->current];
+
+        src = f->src;
+        rc = fetch_wait(fetches + u);
+        f = fetches[u];
+        if( 0 == rc )
+            rc = stage_merge(cfg, &(f->stage), (prefix_cfg_origin_e) slot_origins[slot]);
+        else {
+            fprintf(stderr, "PREFIX CONFIG %s: failed to fetch source %s (%s)\n",
+                    src.required ? "ERROR" : "WARNING", src.name, strerror(rc));
+            if( ! src.required )
+                rc = 0;
+        }
+
+        // per-source time is the (concurrent) fetch plus the merge
+        if( NULL != cfg->_profile )
+            profile_file(cfg, src.name, start - ((NULL != f) ? f->nsecs : 0),
+                         st.keys, st.allocs, st.bytes);
+
+        if( NULL != f )
+            fetch_free(f);
+        fetches[u] = NULL;
+    }
+    return rc;
+}
+
+/* local file source */
+
+static char* source_trim(char* s)
+{
+    char* end;
+
+    while( isspace((unsigned char) *s) )
+        s++;
+    end = s + strlen(s);
+    while( (end > s) && isspace((unsigned char) end[-1]) )
+        *--end = '\0';
+    return s;
+}
+
+static int source_file_fetch(void* ctx,
+                             const prefix_cfg_option_t* options,
+                             unsigned count,
+                             unsigned timeout_ms,
+                             prefix_cfg_put_fn put,
+                             void* user)
+{
+    int rc = 0;
+    int lineno = 0;
+    char line[PREFIX_CFG_MAX_MSG];
+    char* name;
+    char* val;
+    char* dot;
+    const char* path = (const char*) ctx;
+    const prefix_cfg_option_t* opt;
+    unsigned long long deadline = 0;
+    FILE* fp;
+
+    if( timeout_ms )
+        deadline = profile_now() + (timeout_ms * 1000000ULL);
+
+    // the whole store is read at once, keeping only the requested options
+    fp = fopen(path, "r");
+    if( NULL == fp )
+        return errno;
+
+    while( (0 == rc) && (NULL != fgets(line, sizeof(line), fp)) ) {
+        lineno++;
+        if( deadline && (profile_now() > deadline) ) {
+            rc = ETIMEDOUT;
+            break;
+        }
+        name = source_trim(line);
+        if( ('\0' == *name) || ('#' == *name) )
+            continue;
+        val = strchr(name, '=');
+        dot = strchr(name, '.');
+        if( (NULL == val) || (NULL == dot) || (dot > val) ) {
+            fprintf(stderr, "PREFIX CONFIG ERROR: parse error at line %d of source %s\n",
+                    lineno, path);
+            rc = EINVAL;
+            break;
+        }
+        *val++ = '\0';
+        *dot++ = '\0';
+        name = source_trim(name);
+        dot = source_trim(dot);
+        opt = prefix_config_lookup(name, dot);
+        if( (NULL == opt) || (opt < options) || (opt >= (options + count)) )
+            continue;
+        if( 0 == put(user, name, dot, source_trim(val)) )
+            rc = ENOMEM;
+    }
+
+    fclose(fp);
+    return rc;
+}
+
+// create a source reading the file at path
+int prefix_config_source_file(prefix_cfg_source_t* src,
+                              const char* path,
+                              prefix_cfg_source_slot_e slot)
+{
+    char* p;
+
+    if( (NULL == src) || (NULL == path) )
+        return EINVAL;
+    p = strdup(path);
+    if( NULL == p )
+        return ENOMEM;
+
+    memset((void*)src, 0, sizeof(*src));
+    src->name = p;
+    src->slot = slot;
+    src->ctx = p;
+    src->fetch = source_file_fetch;
+    return 0;
+}
+
+void prefix_config_source_file_fini(prefix_cfg_source_t* src)
+{
+    if( (NULL == src) || (NULL == src->ctx) )
+        return;
+    free(src->ctx);
+    memset((void*)src, 0, sizeof(*src));
+}
+
+/* predefined validation functions */
+
+// utility routine to validate a single value of an option
+int validate_value(const prefix_cfg_option_t* opt,
+                   const char* val,
+                   char** new_val)
+{
+    const char* section = opt->section;
+    const char* key = opt->key;
+
+    if( CONFIGURATOR_TYPE_ENUM == opt->type )
+        return configurator_enum_check(opt->enum_lookup, section, key, val);
+    else if( NULL != opt->validate )
+        return opt->validate(section, key, val, new_val);
+
+    switch( opt->type ) {
+    case CONFIGURATOR_TYPE_BOOL:
+        return configurator_bool_check(section, key, val, NULL);
+    case CONFIGURATOR_TYPE_INT:
+        return configurator_int_check(section, key, val, new_val);
+    case CONFIGURATOR_TYPE_FLOAT:
+        return configurator_float_check(section, key, val, new_val);
+    case CONFIGURATOR_TYPE_SIZE:
+        return configurator_size_check(section, key, val, new_val);
+    case CONFIGURATOR_TYPE_DURATION:
+        return configurator_duration_check(section, key, val, new_val);
+    case CONFIGURATOR_TYPE_RANGELIST:
+        return configurator_rangelist_check(section, key, val, new_val);
+    default:
+        break;
+    }
+    return 0;
+}
+
+/* utility routine to convert a validated value to its typed storage (a
+   RANGELIST value is allocated, see value_free()) */
+static int convert_value(const prefix_cfg_option_t* opt,
+                         const char* val,
+                         configurator_value_t* v)
+{
+    int rc;
+    int e;
+
+    memset((void*)v, 0, sizeof(*v));
+    if( NULL == val )
+        return 0;
+
+    switch( opt->type ) {
+    case CONFIGURATOR_TYPE_BOOL:
+        return configurator_bool_val(val, &(v->b));
+    case CONFIGURATOR_TYPE_INT:
+        return configurator_int_val(val, &(v->i));
+    case CONFIGURATOR_TYPE_FLOAT:
+        return configurator_float_val(val, &(v->f));
+    case CONFIGURATOR_TYPE_SIZE:
+        return configurator_size_val(val, &(v->i));
+    case CONFIGURATOR_TYPE_DURATION:
+        return configurator_duration_val(val, &(v->i));
+    case CONFIGURATOR_TYPE_ENUM:
+        rc = configurator_enum_val(opt->enum_lookup, val, &e);
+        v->i = e;
+        return rc;
+    case CONFIGURATOR_TYPE_RANGELIST:
+        return configurator_rangelist_val(val, (configurator_rangelist_t**) &(v->r));
+    default:
+        break;
+    }
+    return 0;
+}
+
+// free the allocated part of a converted value
+static void value_free(const prefix_cfg_option_t* opt,
+                configurator_value_t* v)
+{
+    if( (CONFIGURATOR_TYPE_RANGELIST == opt->type) && (NULL != v->r) ) {
+        free((void*) v->r);
+        v->r = NULL;
+    }
+}
+
+
+/* cross-option references in numeric values, i.e. ${section.key} */
+
+// resolution state of each option during validation
+#define RESOLVE_PENDING CONFIGURATOR_RESOLVE_PENDING
+#define RESOLVE_ACTIVE  CONFIGURATOR_RESOLVE_ACTIVE
+#define RESOLVE_DONE    CONFIGURATOR_RESOLVE_DONE
+#define RESOLVE_FAILED  CONFIGURATOR_RESOLVE_FAILED
+
+// default value string of a single-valued option (NULL when none)
+static const char* option_default(int id)
+{
+    const char* val;
+
+    if( (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS) )
+        return NULL;
+    val = prefix_cfg_options[id].default_value;
+    if( (NULL != val) && (0 == strcmp(val, "NULLSTRING")) )
+        return NULL;
+    return val;
+}
+
+/* batched checks of path options
+
+   Rather than each file/directory check doing its own blocking stat(),
+   validation first collects the distinct paths named by options using
+   those validators, and stats them concurrently. The checks then use
+   the collected results. */
+
+#define PREFIX_CFG_STAT_THREADS 16
+
+typedef struct {
+    const char* path;
+    int err;              // stat() errno, or zero
+    mode_t mode;
+} path_stat_t;
+
+typedef struct {
+    path_stat_t* ents;
+    size_t count;
+    size_t cap;
+    size_t next;          // next entry to stat, claimed atomically
+} path_batch_t;
+
+// state of a validation pass
+typedef struct {
+    unsigned char* state;            // per option, see RESOLVE_xxx
+    path_batch_t paths;
+    prefix_cfg_profile_t* profile;   // NULL unless profiling
+} validate_ctx_t;
+
+static int is_path_check(configurator_validate_fn vfn)
+{
+    return ( (configurator_file_check == vfn)
+             || (configurator_directory_check == vfn) );
+}
+
+static int file_check_result(int err,
+                             mode_t mode)
+{
+    if( err )
+        return err;
+    return (mode & S_IFREG) ? 0 : ENOENT;
+}
+
+static int directory_check_result(int err,
+                                  mode_t mode)
+{
+    if( err )
+        return err;
+    return (mode & S_IFDIR) ? 0 : ENOTDIR;
+}
+
+static void path_batch_add(path_batch_t* b,
+                           configurator_validate_fn vfn,
+                           const char* path)
+{
+    path_stat_t* grown;
+    size_t cap;
+
+    if( (NULL == path) || (! is_path_check(vfn)) )
+        return;
+    if( b->count == b->cap ) {
+        cap = b->cap ? (2 * b->cap) : 16;
+        grown = (path_stat_t*) realloc(b->ents, cap * sizeof(path_stat_t));
+        if( NULL == grown )
+            return; // checked individually instead
+        b->ents = grown;
+        b->cap = cap;
+    }
+    b->ents[b->count].path = path;
+    b->ents[b->count].err = ENOENT;
+    b->ents[b->count].mode = 0;
+    b->count++;
+}
+
+static int path_stat_cmp(const void* a,
+                         const void* b)
+{
+    return strcmp(((const path_stat_t*)a)->path, ((const path_stat_t*)b)->path);
+}
+
+static void* path_batch_worker(void* arg)
+{
+    path_batch_t* b = (path_batch_t*) arg;
+    struct stat st;
+    size_t i;
+
+    while( (i = __atomic_fetch_add(&(b->next), 1, __ATOMIC_RELAXED)) < b->count ) {
+        if( 0 == stat(b->ents[i].path, &st) ) {
+            b->ents[i].err = 0;
+            b->ents[i].mode = st.st_mode;
+        }
+        else
+            b->ents[i].err = errno;
+    }
+    return NULL;
+}
+
+// remove duplicate paths, then stat the rest using a pool of threads
+static void path_batch_run(path_batch_t* b)
+{
+    pthread_t threads[PREFIX_CFG_STAT_THREADS];
+    size_t i, n;
+    unsigned t;
+    unsigned nthreads = 0;
+
+    if( 0 == b->count )
+        return;
+
+    qsort(b->ents, b->count, sizeof(path_stat_t), path_stat_cmp);
+    for( i=1, n=1; i < b->count; i++ ) {
+        if( 0 != strcmp(b->ents[i].path, b->ents[n-1].path) )
+            b->ents[n++] = b->ents[i];
+    }
+    b->count = n;
+    b->next = 0;
+
+    // the calling thread works too, so one path needs no helpers
+    while( ((nthreads + 1) < b->count) && (nthreads < PREFIX_CFG_STAT_THREADS) ) {
+        if( 0 != pthread_create(&threads[nthreads], NULL, path_batch_worker, b) )
+            break;
+        nthreads++;
+    }
+    path_batch_worker(b);
+    for( t=0; t < nthreads; t++ )
+        pthread_join(threads[t], NULL);
+}
+
+/* validate a value, using the batched stat() result for path checks
+   (ctx may be NULL, e.g. for runtime updates) */
+static int check_value(validate_ctx_t* ctx,
+                       const prefix_cfg_option_t* opt,
+                       const char* val,
+                       char** new_val)
+{
+    int rc;
+    unsigned long long t = 0;
+    configurator_stats_t* st;
+    configurator_validator_e kind;
+    configurator_validate_fn vfn = opt->validate;
+    path_stat_t probe;
+    path_stat_t* ps = NULL;
+
+    if( (NULL != ctx) && (NULL != ctx->profile) )
+        t = profile_now();
+
+    if( (NULL != ctx) && (NULL != val) && (0 != ctx->paths.count)
+        && is_path_check(vfn) ) {
+        probe.path = val;
+        ps = (path_stat_t*) bsearch(&probe, ctx->paths.ents, ctx->paths.count,
+                                    sizeof(path_stat_t), path_stat_cmp);
+    }
+    if( NULL == ps )
+        rc = validate_value(opt, val, new_val);
+    else if( configurator_file_check == vfn )
+        rc = file_check_result(ps->err, ps->mode);
+    else
+        rc = directory_check_result(ps->err, ps->mode);
+
+    if( (NULL != ctx) && (NULL != ctx->profile) ) {
+        if( CONFIGURATOR_TYPE_ENUM == opt->type )
+            kind = CONFIGURATOR_VALIDATOR_ENUM;
+        else if( is_path_check(vfn) )
+            kind = CONFIGURATOR_VALIDATOR_PATH;
+        else if( NULL != vfn )
+            kind = CONFIGURATOR_VALIDATOR_CUSTOM;
+        else if( CONFIGURATOR_TYPE_BOOL == opt->type )
+            kind = CONFIGURATOR_VALIDATOR_BOOL;
+        else if( CONFIGURATOR_TYPE_INT == opt->type )
+            kind = CONFIGURATOR_VALIDATOR_INT;
+        else if( CONFIGURATOR_TYPE_FLOAT == opt->type )
+            kind = CONFIGURATOR_VALIDATOR_FLOAT;
+        else if( (CONFIGURATOR_TYPE_SIZE == opt->type)
+                 || (CONFIGURATOR_TYPE_DURATION == opt->type) )
+            kind = CONFIGURATOR_VALIDATOR_UNIT;
+        else if( CONFIGURATOR_TYPE_RANGELIST == opt->type )
+            kind = CONFIGURATOR_VALIDATOR_RANGELIST;
+        else
+            return rc;
+        st = ctx->profile->validator + kind;
+        st->nsecs += profile_now() - t;
+        st->keys++;
+        ctx->profile->phase[ctx->profile->current].keys++;
+    }
+    return rc;
+}
+
+static int resolve_option(prefix_cfg_t* cfg,
+                          int id,
+                          validate_ctx_t* ctx);
+
+/* replace each ${section.key} in val with the (parenthesized) value of the
+   referenced option. When ctx is non-NULL, referenced options that have
+   not yet been validated are resolved first, and cycles are rejected. */
+static int expand_references(prefix_cfg_t* cfg,
+                             validate_ctx_t* ctx,
+                             const char* section,
+                             const char* key,
+                             const char* val,
+                             char** out_val)
+{
+    int rc = 0;
+    int id;
+    size_t len;
+    char* dot;
+    char** refval;
+    const char* ref;
+    const char* end;
+    char name[PREFIX_CFG_MAX_MSG];
+    cfg_strbuf_t sb = { NULL, 0, 0 };
+
+    while( (0 == rc) && (NULL != (ref = strstr(val, "${"))) ) {
+        end = strchr(ref, '}');
+        len = (NULL != end) ? (size_t)(end - (ref + 2)) : 0;
+        if( (0 == len) || (len >= sizeof(name)) ) {
+            fprintf(stderr, "PREFIX CONFIG ERROR: malformed reference in '%s' for %s.%s\n",
+                    val, section, key);
+            rc = EINVAL;
+            break;
+        }
+        memcpy(name, ref + 2, len);
+        name[len] = '\0';
+        dot = strchr(name, '.');
+        id = -1;
+        if( NULL != dot ) {
+            *dot = '\0';
+            id = option_id(name, dot + 1);
+            *dot = '.';
+        }
+        refval = (id >= 0) ? option_string(cfg, id) : NULL;
+        if( NULL == refval ) {
+            fprintf(stderr, "PREFIX CONFIG ERROR: %s.%s references unknown option '%s'\n",
+                    section, key, name);
+            rc = EINVAL;
+            break;
+        }
+
+        if( NULL != ctx ) {
+            if( RESOLVE_ACTIVE == ctx->state[id] ) {
+                fprintf(stderr, "PREFIX CONFIG ERROR: %s.%s reference to '%s' forms a cycle\n",
+                        section, key, name);
+                rc = EINVAL;
+                break;
+            }
+            rc = resolve_option(cfg, id, ctx);
+            if( rc ) break;
+        }
+        if( NULL == *refval ) {
+            fprintf(stderr, "PREFIX CONFIG ERROR: %s.%s references unset option '%s'\n",
+                    section, key, name);
+            rc = EINVAL;
+            break;
+        }
+
+        rc = strbuf_append(&sb, val, (size_t)(ref - val));
+        if( 0 == rc ) rc = strbuf_append(&sb, "(", 1);
+        if( 0 == rc ) rc = strbuf_append(&sb, *refval, strlen(*refval));
+        if( 0 == rc ) rc = strbuf_append(&sb, ")", 1);
+        val = end + 1;
+    }
+    if( 0 == rc )
+        rc = strbuf_append(&sb, val, strlen(val));
+
+    if( rc ) {
+        free(sb.s);
+        return rc;
+    }
+    *out_val = sb.s;
+    return 0;
+}
+
+// check if a value of the given type may contain option references
+static int has_references(configurator_type_e typ,
+                          const char* val)
+{
+    return ( (NULL != val)
+             && ((CONFIGURATOR_TYPE_INT == typ) || (CONFIGURATOR_TYPE_FLOAT == typ)
+                 || (CONFIGURATOR_TYPE_SIZE == typ)
+                 || (CONFIGURATOR_TYPE_DURATION == typ))
+             && (NULL != strstr(val, "${")) );
+}
+
+// validate, evaluate, and convert a single-valued option
+static int validate_single(prefix_cfg_t* cfg,
+                           validate_ctx_t* ctx,
+                           const prefix_cfg_option_t* opt)
+{
+    int rc;
+    char* new_val = NULL;
+    char** str = opt_string(cfg, opt);
+
+    if( has_references(opt->type, *str) ) {
+        rc = expand_references(cfg, ctx, opt->section, opt->key, *str, &new_val);
+        if( rc ) return rc;
+        cfg_free(cfg, *str);
+        *str = new_val;
+        new_val = NULL;
+    }
+
+    rc = check_value(ctx, opt, *str, &new_val);
+    if( rc ) {
+        fprintf(stderr, "PREFIX CONFIG ERROR: value '%s' for %s.%s is INVALID %s\n",
+                *str, opt->section, opt->key, type_names[opt->type]);
+        return rc;
+    }
+    if( NULL != new_val ) {
+        if( NULL != *str ) cfg_free(cfg, *str);
+        *str = new_val;
+    }
+    value_free(opt, opt_value(cfg, opt));
+    convert_value(opt, *str, opt_value(cfg, opt));
+    return 0;
+}
+
+// validate all values of a _MULTI option
+static int validate_multi(prefix_cfg_t* cfg,
+                          validate_ctx_t* ctx,
+                          const prefix_cfg_option_t* opt)
+{
+    unsigned u;
+    int rc = 0;
+    int vrc;
+    char* new_val = NULL;
+    configurator_multi_t* m = opt_multi(cfg, opt);
+    char** vals = (char**) configurator_multi_values(m);
+
+    if( m->count > opt->max_entries ) {
+        rc = ERANGE;
+        fprintf(stderr, "PREFIX CONFIG ERROR: %u values for %s.%s exceeds max-entries (%u)\n",
+                m->count, opt->section, opt->key, opt->max_entries);
+    }
+
+    for( u=0; u < m->count; u++ ) {
+        vrc = check_value(ctx, opt, vals[u], &new_val);
+        if( vrc ) {
+            rc = vrc;
+            fprintf(stderr, "PREFIX CONFIG ERROR: value[%u] '%s' for %s.%s is INVALID %s\n",
+                    u+1, vals[u], opt->section, opt->key, type_names[opt->type]);
+        } else if( NULL != new_val ) {
+            if( NULL != vals[u] ) cfg_free(cfg, vals[u]);
+            vals[u] = new_val;
+            new_val = NULL;
+        }
+    }
+    return rc;
+}
+
+// validate an option, after first resolving any options it references
+static int resolve_option(prefix_cfg_t* cfg,
+                          int id,
+                          validate_ctx_t* ctx)
+{
+    int rc = 0;
+
+    if( RESOLVE_FAILED == ctx->state[id] )
+        return EINVAL;
+    if( RESOLVE_PENDING != ctx->state[id] )
+        return 0;
+    __atomic_store_n(&(ctx->state[id]), RESOLVE_ACTIVE, __ATOMIC_RELAXED);
+
+    if( prefix_cfg_options[id].multi )
+        rc = validate_multi(cfg, ctx, prefix_cfg_options + id);
+    else
+        rc = validate_single(cfg, ctx, prefix_cfg_options + id);
+
+    // for lazy configs, this publishes the value to readers
+    __atomic_store_n(&(ctx->state[id]), (rc ? RESOLVE_FAILED : RESOLVE_DONE),
+                     __ATOMIC_RELEASE);
+    return rc;
+}
+
+static void cfg_lock(prefix_cfg_t* cfg);
+static void cfg_unlock(prefix_cfg_t* cfg);
+
+/* validate configuration, resolving option references in dependency order.
+   For lazy configs, only options not yet accessed are validated. */
+int prefix_config_validate(prefix_cfg_t* cfg)
+{
+    unsigned u;
+    int id;
+    const prefix_cfg_option_t* opt;
+    const configurator_multi_t* m;
+    int rc = 0;
+    int vrc;
+    bool lazy;
+    unsigned long long t;
+    validate_ctx_t ctx;
+
+    if( NULL == cfg )
+        return EINVAL;
+
+    memset((void*)&ctx, 0, sizeof(ctx));
+    ctx.profile = cfg->_profile;
+
+    lazy = (NULL != cfg->_lazy);
+    if( lazy ) {
+        cfg_lock(cfg);
+        ctx.state = cfg->_lazy;
+    }
+    else {
+        ctx.state = (unsigned char*) calloc(PREFIX_CFG_NUM_OPTIONS + 1, 1);
+        if( NULL == ctx.state )
+            return ENOMEM;
+    }
+
+    // check all paths up front (path options never contain references)
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( (RESOLVE_PENDING != ctx.state[id]) || (! is_path_check(opt->validate)) )
+            continue;
+        if( ! opt->multi ) {
+            path_batch_add(&(ctx.paths), opt->validate, *opt_string(cfg, opt));
+            continue;
+        }
+        m = opt_multi(cfg, opt);
+        for( u=0; u < m->count; u++ )
+            path_batch_add(&(ctx.paths), opt->validate, configurator_multi_get(m, u));
+    }
+
+    // the batched stat() pass counts toward path validation time
+    t = profile_clock(cfg);
+    path_batch_run(&(ctx.paths));
+    if( NULL != ctx.profile )
+        ctx.profile->validator[CONFIGURATOR_VALIDATOR_PATH].nsecs +=
+            profile_clock(cfg) - t;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        vrc = resolve_option(cfg, id, &ctx);
+        if( vrc ) rc = vrc;
+    }
+
+    free(ctx.paths.ents);
+    if( lazy )
+        cfg_unlock(cfg);
+    else
+        free(ctx.state);
+    return rc;
+}
+
+// validate a single option of a lazy config on first access
+int prefix_config_resolve(prefix_cfg_t* cfg,
+                          int id)
+{
+    int rc;
+    validate_ctx_t ctx;
+
+    if( (NULL == cfg) || (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS) )
+        return EINVAL;
+    if( NULL == cfg->_lazy )
+        return 0;
+
+    memset((void*)&ctx, 0, sizeof(ctx));
+    ctx.state = cfg->_lazy;
+
+    cfg_lock(cfg);
+    rc = resolve_option(cfg, id, &ctx);
+    cfg_unlock(cfg);
+    return rc;
+}
+
+
+/* runtime updates of individual options */
+
+// take the writer lock (runtime updates are rare, so a spin suffices)
+static void cfg_lock(prefix_cfg_t* cfg)
+{
+    while( __atomic_test_and_set(&(cfg->_lock), __ATOMIC_ACQUIRE) )
+        sched_yield();
+}
+
+static void cfg_unlock(prefix_cfg_t* cfg)
+{
+    __atomic_clear(&(cfg->_lock), __ATOMIC_RELEASE);
+}
+
+/* validate and convert a new value for a single-valued option (ctx is
+   non-NULL for lazy configs, to resolve referenced options first) */
+static int prepare_value(prefix_cfg_t* cfg,
+                         validate_ctx_t* ctx,
+                         const prefix_cfg_option_t* opt,
+                         const char* val,
+                         char** out_val,
+                         configurator_value_t* v)
+{
+    int rc;
+    char* new_val = NULL;
+    char* expanded = NULL;
+
+    // references use the current values of the referenced options
+    if( has_references(opt->type, val) ) {
+        rc = expand_references(cfg, ctx, opt->section, opt->key, val, &expanded);
+        if( rc ) return rc;
+        val = expanded;
+    }
+
+    rc = validate_value(opt, val, &new_val);
+    if( rc ) {
+        fprintf(stderr, "PREFIX CONFIG ERROR: value '%s' for %s.%s is INVALID %s\n",
+                val, opt->section, opt->key, type_names[opt->type]);
+        if( NULL != expanded ) free(expanded);
+        return rc;
+    }
+    if( NULL == new_val ) {
+        new_val = (NULL != expanded) ? expanded : strdup(val);
+        expanded = NULL;
+        if( NULL == new_val )
+            return ENOMEM;
+    }
+    if( NULL != expanded ) free(expanded);
+    rc = convert_value(opt, new_val, v);
+    if( rc ) {
+        free(new_val);
+        return rc;
+    }
+    *out_val = new_val;
+    return 0;
+}
+
+// change subscription (entries are only freed by prefix_config_fini())
+struct configurator_sub {
+    struct configurator_sub* next;
+    int id;
+    prefix_cfg_subscriber_fn fn;    // NULL once unsubscribed
+    void* arg;
+};
+
+// call the subscribers of an option (outside the lock)
+static void notify_subscribers(prefix_cfg_t* cfg,
+                               int id,
+                               const char* old_val,
+                               const char* new_val)
+{
+    struct configurator_sub* sub;
+    prefix_cfg_subscriber_fn fn;
+
+    sub = __atomic_load_n(&(cfg->_subs), __ATOMIC_ACQUIRE);
+    for( ; NULL != sub; sub = sub->next ) {
+        fn = __atomic_load_n(&(sub->fn), __ATOMIC_ACQUIRE);
+        if( (id == sub->id) && (NULL != fn) )
+            fn(cfg, id, old_val, new_val, sub->arg);
+    }
+}
+
+static int str_differ(const char* x,
+                      const char* y)
+{
+    if( x == y )
+        return 0;
+    if( (NULL == x) || (NULL == y) )
+        return 1;
+    return (0 != strcmp(x, y));
+}
+
+// check if a value changed (typed options compare converted values)
+static int value_differs(configurator_type_e typ,
+                         const char* old_str,
+                         const char* new_str,
+                         const configurator_value_t* old_v,
+                         const configurator_value_t* new_v)
+{
+    switch( typ ) {
+    case CONFIGURATOR_TYPE_BOOL:
+        return (old_v->b != new_v->b);
+    case CONFIGURATOR_TYPE_FLOAT:
+        // a NaN compares unequal to itself, but two NaNs are no change
+        return (old_v->f != new_v->f)
+               && ((old_v->f == old_v->f) || (new_v->f == new_v->f));
+    case CONFIGURATOR_TYPE_INT:
+    case CONFIGURATOR_TYPE_SIZE:
+    case CONFIGURATOR_TYPE_DURATION:
+    case CONFIGURATOR_TYPE_ENUM:
+        return (old_v->i != new_v->i);
+    default:
+        break;
+    }
+    return str_differ(old_str, new_str);
+}
+
+// validate and publish a new value for a single-valued option from origin
+static int store_value(prefix_cfg_t* cfg,
+                       int id,
+                       const char* val,
+                       prefix_cfg_origin_e origin)
+{
+    int rc;
+    char** str;
+    configurator_value_t* tval;
+    const prefix_cfg_option_t* opt = prefix_cfg_options + id;
+    bool lazy;
+    bool old_valid = true;
+    char* new_val = NULL;
+    char* old_val;
+    configurator_value_t v;
+    configurator_value_t old_v;
+    configurator_retired_t* r;
+    configurator_retired_t* rv = NULL;
+    validate_ctx_t ctx;
+
+    if( (NULL == cfg) || (NULL == val) || opt->multi )
+        return EINVAL;
+    str = opt_string(cfg, opt);
+    tval = opt_value(cfg, opt);
+
+    // an expanded RANGELIST value is retired along with its string
+    r = (configurator_retired_t*) malloc(sizeof(configurator_retired_t));
+    if( CONFIGURATOR_TYPE_RANGELIST == opt->type )
+        rv = (configurator_retired_t*) malloc(sizeof(configurator_retired_t));
+    if( (NULL == r) || ((CONFIGURATOR_TYPE_RANGELIST == opt->type) && (NULL == rv)) ) {
+        free(r);
+        free(rv);
+        return ENOMEM;
+    }
+
+    /* referenced options are read (and, for lazy configs, resolved) under
+       the lock, so concurrent setters cannot swap them mid-expansion */
+    lazy = (NULL != cfg->_lazy);
+    if( lazy ) {
+        memset((void*)&ctx, 0, sizeof(ctx));
+        ctx.state = cfg->_lazy;
+    }
+    cfg_lock(cfg);
+    rc = prepare_value(cfg, (lazy ? &ctx : NULL), opt, val, &new_val, &v);
+    if( rc ) {
+        cfg_unlock(cfg);
+        free(r);
+        free(rv);
+        return rc;
+    }
+
+    if( lazy )
+        old_valid = (0 == resolve_option(cfg, id, &ctx));
+    old_v = *tval;
+    __atomic_store(tval, &v, __ATOMIC_RELEASE);
+    old_val = __atomic_exchange_n(str, new_val, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&(cfg->_origin[id]), (unsigned char) origin, __ATOMIC_RELAXED);
+    if( lazy )
+        __atomic_store_n(&(cfg->_lazy[id]), RESOLVE_DONE, __ATOMIC_RELEASE);
+    if( NULL != old_val ) {
+        r->str = old_val;
+        r->next = cfg->_retired;
+        cfg->_retired = r;
+        r = NULL;
+    }
+    if( (NULL != rv) && (NULL != old_v.r) ) {
+        rv->str = (char*) old_v.r;
+        rv->next = cfg->_retired;
+        cfg->_retired = rv;
+        rv = NULL;
+    }
+    cfg_unlock(cfg);
+
+    if( NULL != r )
+        free(r);
+    if( NULL != rv )
+        free(rv);
+
+    // old_val is retired rather than freed, so stays valid for subscribers
+    if( (NULL != cfg->_subs)
+        && ((! old_valid) || value_differs(opt->type, old_val, new_val, &old_v, &v)) )
+        notify_subscribers(cfg, id, old_val, new_val);
+    return 0;
+}
+
+// validate and publish a runtime update
+static int set_value(prefix_cfg_t* cfg,
+                     int id,
+                     const char* val)
+{
+    return store_value(cfg, id, val, PREFIX_CFG_ORIGIN_RUNTIME);
+}
+
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                        \
+int prefix_config_set_##sec##_##key(prefix_cfg_t* cfg, const char* val) \
+{                                                                       \
+    return set_value(cfg, PREFIX_CFG_ID_##sec##_##key, val);            \
+}
+
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)          \
+    PREFIX_CFG(sec, key, typ, dv, desc, vfn)
+
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)
+
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)
+
+PREFIX_CONFIGS
+#undef PREFIX_CFG
+#undef PREFIX_CFG_CLI
+#undef PREFIX_CFG_MULTI
+#undef PREFIX_CFG_MULTI_CLI
+
+static void admin_quiesce(prefix_cfg_t* cfg);
+
+// free strings retired by runtime updates
+void prefix_config_reclaim(prefix_cfg_t* cfg)
+{
+    configurator_retired_t* r;
+    configurator_retired_t* next;
+
+    if( NULL == cfg )
+        return;
+
+    cfg_lock(cfg);
+    r = cfg->_retired;
+    cfg->_retired = NULL;
+    cfg_unlock(cfg);
+    admin_quiesce(cfg);
+
+    for( ; NULL != r; r = next ) {
+        next = r->next;
+        cfg_free(cfg, r->str);
+        free(r);
+    }
+}
+
+/* configuration changes */
+
+static int multi_differ(const configurator_multi_t* x,
+                        const configurator_multi_t* y)
+{
+    unsigned u;
+
+    if( x->count != y->count )
+        return 1;
+    for( u=0; u < x->count; u++ ) {
+        if( str_differ(configurator_multi_get(x, u), configurator_multi_get(y, u)) )
+            return 1;
+    }
+    return 0;
+}
+
+// list the options that differ between two configs
+unsigned prefix_config_diff(const prefix_cfg_t* a,
+                            const prefix_cfg_t* b,
+                            int* changed)
+{
+    int id;
+    unsigned n = 0;
+    configurator_value_t va, vb;
+    const prefix_cfg_option_t* opt;
+
+    if( (NULL == a) || (NULL == b) || (NULL == changed) )
+        return 0;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        configurator_lazy_check(a, id);
+        configurator_lazy_check(b, id);
+        if( opt->multi ) {
+            if( multi_differ(opt_multi(a, opt), opt_multi(b, opt)) )
+                changed[n++] = id;
+            continue;
+        }
+        // same loads as the getters, as updates may be in progress
+        __atomic_load(opt_value(a, opt), &va, __ATOMIC_RELAXED);
+        __atomic_load(opt_value(b, opt), &vb, __ATOMIC_RELAXED);
+        if( value_differs(opt->type,
+                          CONFIGURATOR_LOAD_STRING(*opt_string(a, opt), va),
+                          CONFIGURATOR_LOAD_STRING(*opt_string(b, opt), vb),
+                          &va, &vb) )
+            changed[n++] = id;
+    }
+
+    return n;
+}
+
+int prefix_config_subscribe(prefix_cfg_t* cfg,
+                            int id,
+                            prefix_cfg_subscriber_fn fn,
+                            void* arg)
+{
+    struct configurator_sub* sub;
+
+    if( (NULL == cfg) || (NULL == fn)
+        || (id < 0) || (id >= PREFIX_CFG_NUM_OPTIONS) )
+        return EINVAL;
+
+    sub = (struct configurator_sub*) malloc(sizeof(*sub));
+    if( NULL == sub )
+        return ENOMEM;
+    sub->id = id;
+    sub->fn = fn;
+    sub->arg = arg;
+
+    // updating threads may be walking the list, so only prepend
+    cfg_lock(cfg);
+    sub->next = cfg->_subs;
+    __atomic_store_n(&(cfg->_subs), sub, __ATOMIC_RELEASE);
+    cfg_unlock(cfg);
+    return 0;
+}
+
+/* stop calling fn for id (an update already in progress on another thread
+   may still call it once) */
+int prefix_config_unsubscribe(prefix_cfg_t* cfg,
+                              int id,
+                              prefix_cfg_subscriber_fn fn,
+                              void* arg)
+{
+    int rc = ENOENT;
+    struct configurator_sub* sub;
+
+    if( NULL == cfg )
+        return EINVAL;
+
+    cfg_lock(cfg);
+    for( sub = cfg->_subs; NULL != sub; sub = sub->next ) {
+        if( (id == sub->id) && (fn == sub->fn) && (arg == sub->arg) ) {
+            __atomic_store_n(&(sub->fn), NULL, __ATOMIC_RELEASE);
+            rc = 0;
+            break;
+        }
+    }
+    cfg_unlock(cfg);
+    return rc;
+}
+
+static void subscriptions_free(prefix_cfg_t* cfg)
+{
+    struct configurator_sub* sub;
+    struct configurator_sub* next;
+
+    for( sub = cfg->_subs; NULL != sub; sub = next ) {
+        next = sub->next;
+        free(sub);
+    }
+    cfg->_subs = NULL;
+}
+
+// update a single option of cfg to its value in from
+static int apply_option(prefix_cfg_t* cfg,
+                        const prefix_cfg_t* from,
+                        int id)
+{
+    const char* val;
+    prefix_cfg_origin_e origin = prefix_config_origin(from, id);
+
+    if( prefix_cfg_options[id].multi )
+        return 0;
+    // runtime updates outrank any value of a reloaded config
+    if( (PREFIX_CFG_ORIGIN_RUNTIME == prefix_config_origin(cfg, id))
+        && (PREFIX_CFG_ORIGIN_RUNTIME > origin) )
+        return 0;
+    val = __atomic_load_n(opt_string(from, prefix_cfg_options + id), __ATOMIC_ACQUIRE);
+    if( NULL == val )
+        return EINVAL;
+    return store_value(cfg, id, val, origin);
+}
+
+/* update each changed single-valued option of cfg to its value in from
+   (e.g., a freshly initialized config), returning the first failure */
+int prefix_config_apply(prefix_cfg_t* cfg,
+                        const prefix_cfg_t* from)
+{
+    int rc = 0;
+    int arc;
+    unsigned u, n;
+    int* changed;
+
+    if( (NULL == cfg) || (NULL == from) )
+        return EINVAL;
+
+    changed = (int*) malloc((PREFIX_CFG_NUM_OPTIONS + 1) * sizeof(int));
+    if( NULL == changed )
+        return ENOMEM;
+
+    n = prefix_config_diff(cfg, from, changed);
+    for( u=0; u < n; u++ ) {
+        arc = apply_option(cfg, from, changed[u]);
+        if( arc && (0 == rc) ) rc = arc;
+    }
+    free(changed);
+    return rc;
+}
+
+/* binary config snapshots
+
+   A snapshot holds the fully resolved and validated configuration in a
+   position-independent layout, so it can be used directly from a read-only
+   mapping. All offsets are relative to the start of the snapshot, and
+   an offset of zero means "unset".
+
+     snapshot_header_t
+     snapshot_entry_t [num_options]   (one per option, in option id order)
+     snapshot_file_t  [num_files]     (config files the values came from)
+     data area                        (strings, _MULTI string offset arrays)
+*/
+
+#define PREFIX_CFG_SNAPSHOT_MAGIC   0x47464350  /* "PCFG" */
+#define PREFIX_CFG_SNAPSHOT_VERSION 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t schema;      // fingerprint of PREFIX_CONFIGS
+    uint64_t inputs;      // fingerprint of environment and arguments
+    uint64_t size;        // total snapshot bytes
+    uint32_t num_options;
+    uint32_t num_files;
+} snapshot_header_t;
+
+typedef struct {
+    uint64_t str;         // value string, or string offset array for _MULTI
+    uint64_t count;       // number of _MULTI values
+    uint64_t origin;      // prefix_cfg_origin_e of the value
+    configurator_value_t val;
+} snapshot_entry_t;
+
+typedef struct {
+    uint64_t path;
+    int64_t  size;        // -1 when the file did not exist
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    uint64_t ino;
+    uint64_t dev;
+} snapshot_file_t;
+
+#define PREFIX_CFG_SNAPSHOT_MAX_FILES 64
+
+typedef struct {
+    char* buf;            // NULL when only computing the size
+    size_t off;
+} snapshot_writer_t;
+
+// fingerprint of the option schema and snapshot layout
+static uint64_t snapshot_schema_hash(void)
+{
+    int id;
+    const prefix_cfg_option_t* opt;
+    uint64_t h = FNV1A_INIT;
+    size_t sz = sizeof(prefix_cfg_t);
+
+    h = fnv1a(h, &sz, sizeof(sz));
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        h = fnv1a_str(h, opt->section);
+        h = fnv1a_str(h, opt->key);
+        h = fnv1a_str(h, type_names[opt->type]);
+        if( opt->multi )
+            h = fnv1a(h, &(opt->max_entries), sizeof(opt->max_entries));
+        else
+            h = fnv1a_str(h, opt->default_value);
+    }
+
+    return h;
+}
+
+// fingerprint of the inputs that are not files: arguments, environment, cwd
+static uint64_t snapshot_inputs_hash(int argc,
+                                     char** argv)
+{
+    extern char** environ;
+    uint64_t h = FNV1A_INIT;
+    uint64_t envh = 0;
+    char** e;
+    int i;
+    char cwd[PATH_MAX];
+
+    for( i=1; i < argc; i++ )
+        h = fnv1a_str(h, argv[i]);
+
+    // combine per-variable hashes, so environment order does not matter
+    for( e = environ; (NULL != e) && (NULL != *e); e++ ) {
+        if( 0 == strncmp(*e, "PREFIX_", 7) )
+            envh += fnv1a_str(FNV1A_INIT, *e);
+    }
+    h = fnv1a(h, &envh, sizeof(envh));
+
+    if( NULL != getcwd(cwd, sizeof(cwd)) )
+        h = fnv1a_str(h, cwd);
+
+    return h;
+}
+
+// reserve space in the data area, returning its offset
+static uint64_t snapshot_put(snapshot_writer_t* w,
+                             const void* data,
+                             size_t len)
+{
+    uint64_t off = w->off;
+
+    if( NULL != w->buf ) {
+        if( NULL != data )
+            memcpy(w->buf + off, data, len);
+        else
+            memset(w->buf + off, 0, len);
+    }
+    w->off += (len + 7) & ~((size_t)7);
+    return off;
+}
+
+static uint64_t snapshot_put_string(snapshot_writer_t* w,
+                                    const char* s)
+{
+    if( NULL == s )
+        return 0;
+    return snapshot_put(w, s, strlen(s) + 1);
+}
+
+static void snapshot_put_single(snapshot_writer_t* w,
+                                int id,
+                                const char* str,
+                                const configurator_value_t* val)
+{
+    snapshot_entry_t* ent;
+    uint64_t off = snapshot_put_string(w, str);
+
+    if( NULL != w->buf ) {
+        ent = ((snapshot_entry_t*)(w->buf + sizeof(snapshot_header_t))) + id;
+        ent->str = off;
+        ent->count = 0;
+        ent->val = *val;
+        // expanded RANGELIST values are rebuilt by snapshot_attach()
+        if( CONFIGURATOR_TYPE_RANGELIST == prefix_cfg_options[id].type )
+            memset((void*)&(ent->val), 0, sizeof(ent->val));
+    }
+}
+
+static void snapshot_put_multi(snapshot_writer_t* w,
+                               int id,
+                               const configurator_multi_t* m)
+{
+    snapshot_entry_t* ent;
+    uint64_t* offs;
+    uint64_t off;
+    unsigned u;
+    unsigned count = m->count;
+    char* const* vals = configurator_multi_values(m);
+
+    // no values is unset, as an empty array could end at the buffer end
+    off = count ? snapshot_put(w, NULL, count * sizeof(uint64_t)) : 0;
+    for( u=0; u < count; u++ ) {
+        if( NULL != w->buf ) {
+            offs = (uint64_t*)(w->buf + off);
+            offs[u] = snapshot_put_string(w, vals[u]);
+        }
+        else
+            snapshot_put_string(w, vals[u]);
+    }
+    if( NULL != w->buf ) {
+        ent = ((snapshot_entry_t*)(w->buf + sizeof(snapshot_header_t))) + id;
+        ent->str = off;
+        ent->count = count;
+        memset((void*)&(ent->val), 0, sizeof(ent->val));
+    }
+}
+
+/* write a snapshot of cfg to buf (or just compute its size if buf is NULL),
+   recording the identity of the given config files */
+static size_t snapshot_write(prefix_cfg_t* cfg,
+                             uint64_t inputs,
+                             const char** files,
+                             unsigned num_files,
+                             char* buf)
+{
+    int id;
+    unsigned u;
+    const prefix_cfg_option_t* opt;
+    struct stat st;
+    snapshot_header_t* hdr;
+    snapshot_file_t* sf;
+    snapshot_writer_t w;
+
+    w.buf = buf;
+    w.off = sizeof(snapshot_header_t)
+        + (PREFIX_CFG_NUM_OPTIONS * sizeof(snapshot_entry_t))
+        + (num_files * sizeof(snapshot_file_t));
+
+    if( NULL != buf )
+        memset((void*)buf, 0, w.off);
+
+    // offset zero means unset, so the data area must not start at zero
+    assert( w.off > 0 );
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( opt->multi )
+            snapshot_put_multi(&w, id, opt_multi(cfg, opt));
+        else
+            snapshot_put_single(&w, id, *opt_string(cfg, opt), opt_value(cfg, opt));
+        if( NULL != buf )
+            ((snapshot_entry_t*)(buf + sizeof(snapshot_header_t)))[id].origin =
+                prefix_config_origin(cfg, id);
+    }
+
+    for( u=0; u < num_files; u++ ) {
+        if( NULL == buf ) {
+            snapshot_put_string(&w, files[u]);
+            continue;
+        }
+        sf = (snapshot_file_t*)(buf + sizeof(snapshot_header_t)
+                                + (PREFIX_CFG_NUM_OPTIONS * sizeof(snapshot_entry_t)));
+        sf[u].path = snapshot_put_string(&w, files[u]);
+        if( 0 == stat(files[u], &st) ) {
+            sf[u].size = (int64_t) st.st_size;
+            sf[u].mtime_sec = (int64_t) st.st_mtim.tv_sec;
+            sf[u].mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+            sf[u].ino = (uint64_t) st.st_ino;
+            sf[u].dev = (uint64_t) st.st_dev;
+        }
+        else
+            sf[u].size = -1;
+    }
+
+    if( NULL != buf ) {
+        hdr = (snapshot_header_t*) buf;
+        hdr->magic = PREFIX_CFG_SNAPSHOT_MAGIC;
+        hdr->version = PREFIX_CFG_SNAPSHOT_VERSION;
+        hdr->schema = snapshot_schema_hash();
+        hdr->inputs = inputs;
+        hdr->size = w.off;
+        hdr->num_options = PREFIX_CFG_NUM_OPTIONS;
+        hdr->num_files = num_files;
+    }
+    return w.off;
+}
+
+// check the string offset array of a _MULTI snapshot entry
+static int snapshot_check_multi(const char* buf,
+                                size_t len,
+                                size_t fixed,
+                                const snapshot_entry_t* ent,
+                                unsigned max_entries)
+{
+    const uint64_t* offs;
+    unsigned u;
+
+    if( (0 == ent->str) && (0 == ent->count) )
+        return 0;
+    if( (ent->str < fixed) || (ent->count > max_entries)
+        || ((ent->str + (ent->count * sizeof(uint64_t))) > len) )
+        return EINVAL;
+    offs = (const uint64_t*)(buf + ent->str);
+    for( u=0; u < ent->count; u++ ) {
+        if( (0 != offs[u]) && ((offs[u] < fixed) || (offs[u] >= len)) )
+            return EINVAL;
+    }
+    return 0;
+}
+
+// check a snapshot header and its offsets against the buffer it lives in
+static int snapshot_check(const char* buf,
+                          size_t len,
+                          uint64_t inputs)
+{
+    const snapshot_header_t* hdr = (const snapshot_header_t*) buf;
+    const snapshot_entry_t* ent;
+    const snapshot_file_t* sf;
+    const prefix_cfg_option_t* opt;
+    size_t fixed;
+    unsigned u;
+
+    if( (len < sizeof(snapshot_header_t))
+        || (PREFIX_CFG_SNAPSHOT_MAGIC != hdr->magic)
+        || (PREFIX_CFG_SNAPSHOT_VERSION != hdr->version)
+        || (PREFIX_CFG_NUM_OPTIONS != hdr->num_options)
+        || (hdr->size != len)
+        || (hdr->num_files > PREFIX_CFG_SNAPSHOT_MAX_FILES)
+        || (hdr->inputs != inputs)
+        || (hdr->schema != snapshot_schema_hash()) )
+        return EINVAL;
+
+    fixed = sizeof(snapshot_header_t)
+        + (hdr->num_options * sizeof(snapshot_entry_t))
+        + (hdr->num_files * sizeof(snapshot_file_t));
+    if( (fixed > len) || ('\0' != buf[len - 1]) )
+        return EINVAL;
+
+    // all strings are NUL-terminated within the buffer, so range checks suffice
+    ent = (const snapshot_entry_t*)(buf + sizeof(snapshot_header_t));
+    for( u=0; u < hdr->num_options; u++ ) {
+        if( ((0 != ent[u].str) && ((ent[u].str < fixed) || (ent[u].str >= len)))
+            || (ent[u].origin >= PREFIX_CFG_NUM_ORIGINS) )
+            return EINVAL;
+    }
+    sf = (const snapshot_file_t*)(ent + hdr->num_options);
+    for( u=0; u < hdr->num_files; u++ ) {
+        if( (sf[u].path < fixed) || (sf[u].path >= len) )
+            return EINVAL;
+    }
+
+    // _MULTI entries refer to arrays of string offsets
+    for( u=0; u < PREFIX_CFG_NUM_OPTIONS; u++ ) {
+        opt = prefix_cfg_options + u;
+        if( opt->multi
+            && (0 != snapshot_check_multi(buf, len, fixed, ent + u,
+                                          opt->max_entries)) )
+            return EINVAL;
+    }
+
+    return 0;
+}
+
+// check that the config files recorded in a snapshot are unchanged
+static int snapshot_files_unchanged(const char* buf)
+{
+    const snapshot_header_t* hdr = (const snapshot_header_t*) buf;
+    const snapshot_file_t* sf;
+    struct stat st;
+    unsigned u;
+
+    sf = (const snapshot_file_t*)(buf + sizeof(snapshot_header_t)
+                                  + (hdr->num_options * sizeof(snapshot_entry_t)));
+    for( u=0; u < hdr->num_files; u++ ) {
+        if( 0 != stat(buf + sf[u].path, &st) ) {
+            if( -1 != sf[u].size ) return 0;
+        }
+        else if( (sf[u].size != (int64_t) st.st_size)
+                 || (sf[u].mtime_sec != (int64_t) st.st_mtim.tv_sec)
+                 || (sf[u].mtime_nsec != (int64_t) st.st_mtim.tv_nsec)
+                 || (sf[u].ino != (uint64_t) st.st_ino)
+                 || (sf[u].dev != (uint64_t) st.st_dev) )
+            return 0;
+    }
+    return 1;
+}
+
+static char* snapshot_string(char* buf,
+                             uint64_t off)
+{
+    return (0 == off) ? NULL : (buf + off);
+}
+
+/* point cfg option values into a checked snapshot buffer. Values within
+   the buffer are never freed, so the buffer must outlive cfg. RANGELIST
+   values are expanded again from their strings. */
+static int snapshot_attach(prefix_cfg_t* cfg,
+                           char* buf)
+{
+    int id;
+    const snapshot_entry_t* ent;
+    const uint64_t* offs;
+    const prefix_cfg_option_t* opt;
+    unsigned u;
+
+    ent = (const snapshot_entry_t*)(buf + sizeof(snapshot_header_t));
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        cfg->_origin[id] = (unsigned char) ent[id].origin;
+        if( ! opt->multi ) {
+            *opt_string(cfg, opt) = snapshot_string(buf, ent[id].str);
+            *opt_value(cfg, opt) = ent[id].val;
+            if( (CONFIGURATOR_TYPE_RANGELIST == opt->type)
+                && (0 != convert_value(opt, *opt_string(cfg, opt), opt_value(cfg, opt))) )
+                return ENOMEM;
+            continue;
+        }
+        offs = (const uint64_t*)(buf + ent[id].str);
+        for( u=0; u < ent[id].count; u++ ) {
+            if( 0 != multi_push(opt_multi(cfg, opt), snapshot_string(buf, offs[u])) )
+                return ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+/* map a snapshot read-only from fd and attach cfg to it, if it is current
+   (the pages are shared by all processes mapping the same snapshot) */
+static int snapshot_map(prefix_cfg_t* cfg,
+                        int fd,
+                        uint64_t inputs)
+{
+    struct stat st;
+    char* map;
+
+    if( (0 != fstat(fd, &st)) || (st.st_size <= 0) )
+        return EINVAL;
+    map = (char*) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if( MAP_FAILED == map )
+        return errno;
+
+    if( (0 != snapshot_check(map, (size_t) st.st_size, inputs))
+        || (! snapshot_files_unchanged(map)) ) {
+        munmap(map, (size_t) st.st_size);
+        return ESTALE;
+    }
+
+    memset((void*)cfg, 0, sizeof(prefix_cfg_t));
+    cfg->_map = map;
+    cfg->_map_len = (size_t) st.st_size;
+    if( 0 != snapshot_attach(cfg, map) ) {
+        prefix_config_fini(cfg);
+        return ENOMEM;
+    }
+    return 0;
+}
+
+// map a snapshot file and attach cfg to it, if it is current
+static int snapshot_load(prefix_cfg_t* cfg,
+                         const char* path,
+                         uint64_t inputs)
+{
+    int fd;
+    int rc;
+
+    fd = open(path, O_RDONLY);
+    if( -1 == fd )
+        return errno;
+    rc = snapshot_map(cfg, fd, inputs);
+    close(fd);
+    return rc;
+}
+
+// save a snapshot file, atomically replacing any previous one
+static int snapshot_save(prefix_cfg_t* cfg,
+                         const char* path,
+                         uint64_t inputs,
+                         const char** files,
+                         unsigned num_files)
+{
+    int fd;
+    int rc = 0;
+    size_t len;
+    ssize_t wlen;
+    char* buf;
+    char tmp[PATH_MAX];
+
+    len = snapshot_write(cfg, inputs, files, num_files, NULL);
+    buf = (char*) calloc(1, len);
+    if( NULL == buf )
+        return ENOMEM;
+    snapshot_write(cfg, inputs, files, num_files, buf);
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if( -1 == fd ) {
+        free(buf);
+        return errno;
+    }
+    wlen = write(fd, buf, len);
+    if( (wlen < 0) || ((size_t) wlen != len) )
+        rc = (wlen < 0) ? errno : EIO;
+    close(fd);
+    free(buf);
+
+    if( (0 == rc) && (0 != rename(tmp, path)) )
+        rc = errno;
+    if( rc )
+        unlink(tmp);
+    return rc;
+}
+
+// initialize from a current snapshot, or initialize normally and save one
+int prefix_config_init_cached(prefix_cfg_t* cfg,
+                              int argc,
+                              char** argv,
+                              const char* cache_dir)
+{
+    int rc;
+    int id;
+    unsigned u;
+    unsigned num_files = 0;
+    unsigned num_frags = 0;
+    uint64_t inputs;
+    const char* files[PREFIX_CFG_SNAPSHOT_MAX_FILES];
+    char** frags = NULL;
+    char** dir;
+    char path[PATH_MAX];
 
     if( NULL == cfg )
         return -1;
+    if( (NULL == cache_dir) || sources_registered() )
+        return prefix_config_init(cfg, argc, argv);
 
-    
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)        \
-    envval = getenv_helper(#sec, #key, 0);              \
-    if( NULL != envval ) {                              \
-        cfg->sec##_##key = strdup(envval);              \
+    inputs = snapshot_inputs_hash(argc, argv);
+    snprintf(path, sizeof(path), "%s/prefix-%016llx.snap",
+             cache_dir, (unsigned long long) inputs);
+
+    if( 0 == snapshot_load(cfg, path, inputs) )
+        return 0;
+
+    rc = prefix_config_init(cfg, argc, argv);
+    if( rc ) return rc;
+
+    // the system config file (whether or not it exists), and any from CLI
+    files[num_files++] = option_default(PREFIX_CFG_ID_prefix_configfile);
+    if( NULL != cfg->prefix_configfile )
+        files[num_files++] = cfg->prefix_configfile;
+
+    // fragments, and their directory (to detect added or removed files)
+    id = option_id("prefix", "configdir");
+    dir = (id >= 0) ? option_string(cfg, id) : NULL;
+    if( (NULL != dir) && (NULL != *dir) )
+        files[num_files++] = *dir;
+    if( 0 != fragment_list(cfg, &frags, &num_frags) )
+        return 0;
+
+    // failure to save only costs the next run a full initialization
+    if( (num_files + num_frags) <= PREFIX_CFG_SNAPSHOT_MAX_FILES ) {
+        for( u=0; u < num_frags; u++ )
+            files[num_files++] = frags[u];
+        snapshot_save(cfg, path, inputs, files, num_files);
+    }
+    fragment_list_free(frags, num_frags);
+    return 0;
+}
+
+
+/* shared-memory configs
+
+   A published config is a snapshot (with no recorded config files) in a
+   POSIX shared-memory object. Its inputs fingerprint is always zero, as
+   attaching processes use it regardless of their own environment and
+   arguments. */
+
+#define PREFIX_CFG_SHM_INPUTS 0
+
+// publish the resolved config as the read-only shared-memory object name
+int prefix_config_publish(prefix_cfg_t* cfg,
+                          const char* name)
+{
+    int fd;
+    int rc = 0;
+    size_t len;
+    char* buf;
+    char* map;
+    uint32_t magic;
+
+    if( (NULL == cfg) || (NULL == name) )
+        return EINVAL;
+
+    // lazy configs must be fully resolved first
+    if( NULL != cfg->_lazy ) {
+        rc = prefix_config_validate(cfg);
+        if( rc ) return rc;
+    }
+
+    len = snapshot_write(cfg, PREFIX_CFG_SHM_INPUTS, NULL, 0, NULL);
+    buf = (char*) calloc(1, len);
+    if( NULL == buf )
+        return ENOMEM;
+    snapshot_write(cfg, PREFIX_CFG_SHM_INPUTS, NULL, 0, buf);
+
+    // processes attached to a previous version keep using it
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0444);
+    if( -1 == fd ) {
+        free(buf);
+        return errno;
+    }
+    if( 0 != ftruncate(fd, (off_t) len) )
+        rc = errno;
+    map = rc ? (char*) MAP_FAILED
+        : (char*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( (0 == rc) && (MAP_FAILED == map) )
+        rc = errno;
+    close(fd);
+
+    if( 0 == rc ) {
+        // attachers check the magic first, so store it only once complete
+        memcpy(&magic, buf, sizeof(magic));
+        memcpy(map + sizeof(magic), buf + sizeof(magic), len - sizeof(magic));
+        __atomic_store_n((uint32_t*) map, magic, __ATOMIC_RELEASE);
+        munmap(map, len);
+    }
+    else
+        shm_unlink(name);
+    free(buf);
+    return rc;
+}
+
+// remove a published config (attached processes are unaffected)
+int prefix_config_unpublish(const char* name)
+{
+    if( NULL == name )
+        return EINVAL;
+    return (0 == shm_unlink(name)) ? 0 : errno;
+}
+
+// initialize by attaching to a config published by another process
+int prefix_config_attach(prefix_cfg_t* cfg,
+                         const char* name)
+{
+    int fd;
+    int rc;
+
+    if( (NULL == cfg) || (NULL == name) )
+        return EINVAL;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if( -1 == fd )
+        return errno;
+    rc = snapshot_map(cfg, fd, PREFIX_CFG_SHM_INPUTS);
+    close(fd);
+    return rc;
+}
+
+
+/* collective initialization
+
+   The leader initializes normally and broadcasts a header followed by a
+   snapshot (with no recorded config files) of the resolved config. The
+   snapshot's inputs fingerprint is the leader's, so followers with the
+   same environment and arguments can attach to it as-is. */
+
+typedef struct {
+    uint64_t len;         // snapshot bytes that follow, zero on failure
+    int64_t  rc;          // leader initialization result
+} collective_header_t;
+
+/* whether a follower's own values name config files or fragments other
+   than the leader's, which only a local initialization can read (values
+   from the leader's files cannot be told apart from its other values) */
+static bool overlay_reads_files(prefix_cfg_t* cfg,
+                                prefix_cfg_t* local)
+{
+    int u;
+    int id;
+    char** str;
+    const configurator_multi_t* m;
+    const int ids[3] = { PREFIX_CFG_ID_prefix_configfile,
+                         option_id("prefix", "configdir"),
+                         option_id("prefix", "fragments") };
+
+    for( u=0; u < 3; u++ ) {
+        id = ids[u];
+        if( id < 0 )
+            continue;
+        if( prefix_cfg_options[id].multi ) {
+            m = option_multi(local, id);
+            if( (0 != m->count) && multi_differ(m, option_multi(cfg, id)) )
+                return true;
+        }
+        else {
+            str = option_string(local, id);
+            if( (NULL != *str) && str_differ(*str, *option_string(cfg, id)) )
+                return true;
+        }
+    }
+    return false;
+}
+
+/* apply a follower's environment and arguments on top of the leader's
+   config, setting *reinit instead if the follower must initialize locally */
+static int collective_overlay(prefix_cfg_t* cfg,
+                              int argc,
+                              char** argv,
+                              bool* reinit)
+{
+    int id;
+    int rc;
+    int vrc;
+    char** str;
+    configurator_multi_t* m;
+    const prefix_cfg_option_t* opt;
+    prefix_cfg_t* local;
+    validate_ctx_t ctx;
+
+    local = (prefix_cfg_t*) calloc(1, sizeof(prefix_cfg_t));
+    if( NULL == local )
+        return ENOMEM;
+
+    memset((void*)&ctx, 0, sizeof(ctx));
+    ctx.state = (unsigned char*) malloc(PREFIX_CFG_NUM_OPTIONS + 1);
+    if( NULL == ctx.state ) {
+        free(local);
+        return ENOMEM;
+    }
+    memset((void*)ctx.state, RESOLVE_DONE, PREFIX_CFG_NUM_OPTIONS + 1);
+
+    rc = prefix_config_process_environ(local);
+    if( 0 == rc )
+        rc = prefix_config_process_cli_args(local, argc, argv);
+    if( rc )
+        goto overlay_done;
+    *reinit = overlay_reads_files(cfg, local);
+    if( *reinit )
+        goto overlay_done;
+
+    /* take over the values that differ, other than those the leader got
+       from a higher origin (e.g., its config file over the environment),
+       and mark them for validation */
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( local->_origin[id] < cfg->_origin[id] )
+            continue;
+        if( opt->multi ) {
+            m = opt_multi(local, opt);
+            if( (0 == m->count) || (! multi_differ(m, opt_multi(cfg, opt))) )
+                continue;
+            multi_free(cfg, opt_multi(cfg, opt));
+            *opt_multi(cfg, opt) = *m;
+            memset((void*)m, 0, sizeof(configurator_multi_t));
+            cfg->_origin[id] = local->_origin[id];
+        }
+        else {
+            str = opt_string(local, opt);
+            if( (NULL == *str) || (! str_differ(*str, *opt_string(cfg, opt))) )
+                continue;
+            cfg_free(cfg, *opt_string(cfg, opt));
+            *opt_string(cfg, opt) = *str;
+            *str = NULL;
+            cfg->_origin[id] = local->_origin[id];
+        }
+        ctx.state[id] = RESOLVE_PENDING;
+    }
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        vrc = resolve_option(cfg, id, &ctx);
+        if( vrc ) rc = vrc;
+    }
+
+overlay_done:
+    prefix_config_fini(local);
+    free(local);
+    free(ctx.state);
+    return rc;
+}
+
+// leader: initialize, then broadcast the result and resolved config
+static int collective_lead(prefix_cfg_t* cfg,
+                           int argc,
+                           char** argv,
+                           prefix_cfg_transport_t* tp)
+{
+    int rc;
+    int brc;
+    uint64_t inputs;
+    char* buf = NULL;
+    collective_header_t hdr;
+
+    inputs = snapshot_inputs_hash(argc, argv);
+    memset((void*)&hdr, 0, sizeof(hdr));
+
+    rc = prefix_config_init(cfg, argc, argv);
+    if( 0 == rc ) {
+        hdr.len = snapshot_write(cfg, inputs, NULL, 0, NULL);
+        buf = (char*) calloc(1, hdr.len);
+        if( NULL == buf )
+            rc = ENOMEM;
+        else
+            snapshot_write(cfg, inputs, NULL, 0, buf);
+    }
+    if( rc ) {
+        // followers fail with the same error
+        hdr.len = 0;
+        hdr.rc = rc;
+    }
+
+    brc = tp->bcast(tp->ctx, &hdr, sizeof(hdr));
+    if( (0 == brc) && (0 != hdr.len) )
+        brc = tp->bcast(tp->ctx, buf, hdr.len);
+    free(buf);
+    return rc ? rc : brc;
+}
+
+// follower: attach to the leader's config, then apply any local differences
+static int collective_follow(prefix_cfg_t* cfg,
+                             int argc,
+                             char** argv,
+                             prefix_cfg_transport_t* tp)
+{
+    int rc;
+    bool reinit = false;
+    uint64_t inputs;
+    char* map;
+    collective_header_t hdr;
+
+    inputs = snapshot_inputs_hash(argc, argv);
+    memset((void*)cfg, 0, sizeof(prefix_cfg_t));
+
+    rc = tp->bcast(tp->ctx, &hdr, sizeof(hdr));
+    if( rc ) return rc;
+    if( 0 != hdr.rc ) return (int) hdr.rc;
+    if( hdr.len < sizeof(snapshot_header_t) ) return EPROTO;
+
+    map = (char*) mmap(NULL, (size_t) hdr.len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if( MAP_FAILED == map )
+        return errno;
+    rc = tp->bcast(tp->ctx, map, (size_t) hdr.len);
+    if( (0 == rc) && (0 != mprotect(map, (size_t) hdr.len, PROT_READ)) )
+        rc = errno;
+    if( (0 == rc)
+        && (0 != snapshot_check(map, (size_t) hdr.len,
+                                ((snapshot_header_t*) map)->inputs)) )
+        rc = EPROTO;
+    if( rc ) {
+        munmap(map, (size_t) hdr.len);
+        return rc;
+    }
+
+    cfg->_map = map;
+    cfg->_map_len = (size_t) hdr.len;
+    if( 0 != snapshot_attach(cfg, map) )
+        return ENOMEM;
+
+    if( inputs == ((snapshot_header_t*) map)->inputs )
+        return 0;
+    rc = collective_overlay(cfg, argc, argv, &reinit);
+    if( (0 == rc) && reinit ) {
+        prefix_config_fini(cfg);
+        rc = prefix_config_init(cfg, argc, argv);
+    }
+    return rc;
+}
+
+// initialize once at the group leader, and broadcast to all followers
+int prefix_config_init_collective(prefix_cfg_t* cfg,
+                                  int argc,
+                                  char** argv,
+                                  prefix_cfg_transport_t* tp)
+{
+    if( NULL == cfg )
+        return -1;
+    if( NULL == tp )
+        return prefix_config_init(cfg, argc, argv);
+    if( NULL == tp->bcast )
+        return EINVAL;
+
+    if( tp->leader )
+        return collective_lead(cfg, argc, argv, tp);
+    return collective_follow(cfg, argc, argv, tp);
+}
+
+/* local transport over a Unix-domain socket. The leader accepts all
+   followers on its first broadcast, then writes each message to every
+   follower in turn. */
+
+#define PREFIX_CFG_LOCAL_CONNECT_TRIES 1000  // at 10ms intervals
+
+typedef struct {
+    int listen_fd;        // leader only
+    int* fds;             // leader: one per follower, follower: fds[0]
+    unsigned nfds;
+    unsigned nfollowers;
+    char* path;
+} local_transport_t;
+
+static int local_write(int fd,
+                       const char* buf,
+                       size_t len)
+{
+    ssize_t n;
+
+    while( len > 0 ) {
+        n = send(fd, buf, len, MSG_NOSIGNAL);
+        if( n < 0 ) {
+            if( EINTR == errno ) continue;
+            return errno;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+static int local_read(int fd,
+                      char* buf,
+                      size_t len)
+{
+    ssize_t n;
+
+    while( len > 0 ) {
+        n = read(fd, buf, len);
+        if( n < 0 ) {
+            if( EINTR == errno ) continue;
+            return errno;
+        }
+        if( 0 == n )
+            return ECONNRESET;
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+static int local_bcast(void* ctx,
+                       void* buf,
+                       size_t len)
+{
+    int fd;
+    int rc;
+    unsigned u;
+    local_transport_t* lt = (local_transport_t*) ctx;
+
+    if( -1 == lt->listen_fd )
+        return local_read(lt->fds[0], (char*) buf, len);
+
+    while( lt->nfds < lt->nfollowers ) {
+        fd = accept(lt->listen_fd, NULL, NULL);
+        if( -1 == fd ) {
+            if( EINTR == errno ) continue;
+            return errno;
+        }
+        lt->fds[lt->nfds++] = fd;
+    }
+    for( u=0; u < lt->nfds; u++ ) {
+        rc = local_write(lt->fds[u], (const char*) buf, len);
+        if( rc ) return rc;
+    }
+    return 0;
+}
+
+// connect a follower, waiting for the leader to start listening
+static int local_connect(const struct sockaddr_un* addr)
+{
+    int fd;
+    int rc;
+    unsigned tries;
+    struct timespec delay = { 0, 10 * 1000 * 1000 };
+
+    for( tries=0; tries < PREFIX_CFG_LOCAL_CONNECT_TRIES; tries++ ) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( -1 == fd )
+            return -1;
+        if( 0 == connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) )
+            return fd;
+        rc = errno;
+        close(fd);
+        if( (ENOENT != rc) && (ECONNREFUSED != rc) ) {
+            errno = rc;
+            return -1;
+        }
+        nanosleep(&delay, NULL);
+    }
+    errno = ETIMEDOUT;
+    return -1;
+}
+
+// create a transport among processes on this node, rendezvousing at path
+int prefix_config_transport_local(prefix_cfg_transport_t* tp,
+                                  const char* path,
+                                  bool leader,
+                                  unsigned nfollowers)
+{
+    int rc = 0;
+    local_transport_t* lt;
+    struct sockaddr_un addr;
+
+    if( (NULL == tp) || (NULL == path) )
+        return EINVAL;
+    memset((void*)tp, 0, sizeof(*tp));
+    memset((void*)&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( strlen(path) >= sizeof(addr.sun_path) )
+        return ENAMETOOLONG;
+    strcpy(addr.sun_path, path);
+
+    lt = (local_transport_t*) calloc(1, sizeof(local_transport_t));
+    if( NULL == lt )
+        return ENOMEM;
+    lt->listen_fd = -1;
+    lt->nfollowers = leader ? nfollowers : 1;
+    lt->fds = (int*) calloc((lt->nfollowers ? lt->nfollowers : 1), sizeof(int));
+    lt->path = strdup(path);
+    if( (NULL == lt->fds) || (NULL == lt->path) ) {
+        rc = ENOMEM;
+        goto local_fail;
+    }
+
+    if( leader ) {
+        unlink(path);
+        lt->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( (-1 == lt->listen_fd)
+            || (0 != bind(lt->listen_fd, (struct sockaddr*) &addr, sizeof(addr)))
+            || (0 != listen(lt->listen_fd, (int) nfollowers + 1)) ) {
+            rc = errno;
+            goto local_fail;
+        }
+    }
+    else {
+        lt->fds[0] = local_connect(&addr);
+        if( -1 == lt->fds[0] ) {
+            rc = errno;
+            goto local_fail;
+        }
+        lt->nfds = 1;
+    }
+
+    tp->leader = leader;
+    tp->ctx = lt;
+    tp->bcast = local_bcast;
+    return 0;
+
+local_fail:
+    if( -1 != lt->listen_fd ) {
+        close(lt->listen_fd);
+        unlink(path);
+    }
+    free(lt->fds);
+    free(lt->path);
+    free(lt);
+    return rc;
+}
+
+// close a local transport (the leader also removes its socket)
+void prefix_config_transport_local_fini(prefix_cfg_transport_t* tp)
+{
+    unsigned u;
+    local_transport_t* lt;
+
+    if( (NULL == tp) || (NULL == tp->ctx) )
+        return;
+    lt = (local_transport_t*) tp->ctx;
+    for( u=0; u < lt->nfds; u++ )
+        close(lt->fds[u]);
+    if( -1 != lt->listen_fd ) {
+        close(lt->listen_fd);
+        unlink(lt->path);
+    }
+    free(lt->fds);
+    free(lt->path);
+    free(lt);
+    memset((void*)tp, 0, sizeof(*tp));
+}
+
+/* admin socket. A background thread accepts one client at a time, and
+   serves its requests (one per line) until it disconnects, goes idle, or
+   the thread is stopped through stop_fds. */
+
+#define PREFIX_CFG_ADMIN_MAX_REQUEST 4096
+#define PREFIX_CFG_ADMIN_IDLE_MS 10000  // drop clients idle this long
+
+struct configurator_admin {
+    prefix_cfg_t* cfg;
+    pthread_t thread;
+    int listen_fd;
+    int stop_fds[2];            // pipe written by prefix_config_admin_stop()
+    unsigned long long interval; // minimum nanoseconds between requests
+    unsigned long long next;    // earliest time of the next request
+    unsigned char busy;         // handling a request, see prefix_config_reclaim()
+    char* path;
+};
+
+// only serve clients running as the same user (or root)
+static bool admin_peer_ok(int fd)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if( 0 != getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) )
+        return false;
+    return (cred.uid == geteuid()) || (0 == cred.uid);
+#else
+    (void) fd;
+    return true;
+#endif
+}
+
+// wait for fd to be readable, returning false if stopped (or timed out)
+static bool admin_wait(struct configurator_admin* a,
+                       int fd,
+                       int timeout_ms)
+{
+    int rc;
+    struct pollfd fds[2];
+
+    fds[0].fd = a->stop_fds[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = fd;
+    fds[1].events = POLLIN;
+    for( ;; ) {
+        rc = poll(fds, (-1 == fd) ? 1 : 2, timeout_ms);
+        if( (rc < 0) && (EINTR == errno) )
+            continue;
+        if( (rc <= 0) || (0 != fds[0].revents) )
+            return false;
+        return true;
+    }
+}
+
+// delay until the next request is allowed, returning false if stopped
+static bool admin_throttle(struct configurator_admin* a)
+{
+    unsigned long long now = profile_now();
+
+    if( now < a->next ) {
+        // round up, so the wait is never short
+        if( admin_wait(a, -1, (int)(((a->next - now) + 999999ULL) / 1000000ULL)) )
+            return false;
+        now = profile_now();
+    }
+    a->next = now + a->interval;
+    return true;
+}
+
+// find an option named <section>.<key>
+static const prefix_cfg_option_t* admin_option(const char* name)
+{
+    char section[256];
+    const char* dot = strchr(name, '.');
+
+    if( (NULL == dot) || ((size_t)(dot - name) >= sizeof(section)) )
+        return NULL;
+    memcpy(section, name, (size_t)(dot - name));
+    section[dot - name] = '\0';
+    return prefix_config_lookup(section, dot + 1);
+}
+
+static int admin_get(prefix_cfg_t* cfg,
+                     const char* name,
+                     export_writer_t* w)
+{
+    unsigned u;
+    const char* str;
+    configurator_value_t v;
+    const configurator_multi_t* m;
+    const prefix_cfg_option_t* opt = admin_option(name);
+
+    if( NULL == opt )
+        return ENOENT;
+
+    configurator_lazy_check(cfg, (int)(opt - prefix_cfg_options));
+    if( opt->multi ) {
+        m = opt_multi(cfg, opt);
+        for( u=0; u < m->count; u++ ) {
+            export_str(w, configurator_multi_get(m, u));
+            export_put(w, "\n", 1);
+        }
+        return 0;
+    }
+
+    str = CONFIGURATOR_LOAD_STRING(*opt_string(cfg, opt), v);
+    __atomic_load(opt_value(cfg, opt), &v, __ATOMIC_RELAXED);
+    if( NULL != str ) {
+        export_str(w, display_value(opt, str, &v));
+        export_put(w, "\n", 1);
+    }
+    return 0;
+}
+
+static int admin_set(prefix_cfg_t* cfg,
+                     char* args)
+{
+    char* val = strchr(args, ' ');
+    const prefix_cfg_option_t* opt;
+
+    if( NULL == val )
+        return EINVAL;
+    *val++ = '\0';
+    opt = admin_option(args);
+    if( NULL == opt )
+        return ENOENT;
+    if( opt->multi )
+        return EINVAL;  // _MULTI options have no runtime updates
+    return set_value(cfg, (int)(opt - prefix_cfg_options), val);
+}
+
+static int admin_origin(prefix_cfg_t* cfg,
+                        const char* name,
+                        export_writer_t* w)
+{
+    const prefix_cfg_option_t* opt = admin_option(name);
+
+    if( NULL == opt )
+        return ENOENT;
+    export_str(w, prefix_config_origin_name(
+                      prefix_config_origin(cfg, (int)(opt - prefix_cfg_options))));
+    export_put(w, "\n", 1);
+    return 0;
+}
+
+static void admin_list(const char* section,
+                       export_writer_t* w)
+{
+    int id;
+    char line[64];
+    const prefix_cfg_option_t* opt;
+
+    for( id=0; id < PREFIX_CFG_NUM_OPTIONS; id++ ) {
+        opt = prefix_cfg_options + id;
+        if( ('\0' != *section) && (0 != strcmp(section, opt->section)) )
+            continue;
+        export_str(w, opt->section);
+        export_put(w, ".", 1);
+        export_str(w, opt->key);
+        if( opt->multi )
+            snprintf(line, sizeof(line), " %s[%u] ",
+                     type_names[opt->type], opt->max_entries);
+        else
+            snprintf(line, sizeof(line), " %s ", type_names[opt->type]);
+        export_str(w, line);
+        export_str(w, opt->desc);
+        export_put(w, "\n", 1);
+    }
+}
+
+static int admin_dump(prefix_cfg_t* cfg,
+                      const char* format,
+                      export_writer_t* w)
+{
+    if( ('\0' == *format) || (0 == strcmp(format, "text")) )
+        w->fmt = PREFIX_CFG_FORMAT_TEXT;
+    else if( 0 == strcmp(format, "ini") )
+        w->fmt = PREFIX_CFG_FORMAT_INI;
+    else if( 0 == strcmp(format, "json") )
+        w->fmt = PREFIX_CFG_FORMAT_JSON;
+    else if( 0 == strcmp(format, "env") )
+        w->fmt = PREFIX_CFG_FORMAT_ENV;
+    else
+        return EINVAL;
+    export_render(cfg, w);
+    return w->err;
+}
+
+// handle one request line, and send its reply
+static int admin_request(struct configurator_admin* a,
+                         int fd,
+                         char* req)
+{
+    int rc;
+    char* args;
+    char hdr[PREFIX_CFG_MAX_MSG];
+    export_writer_t w;
+
+    args = strchr(req, ' ');
+    if( NULL == args )
+        args = req + strlen(req);
+    else
+        *args++ = '\0';
+
+    export_init(&w, PREFIX_CFG_FORMAT_TEXT, NULL, 0, true);
+
+    /* strings read by a request must not be reclaimed meanwhile (busy is
+       accessed with read-modify-writes, which later loads cannot pass) */
+    __atomic_exchange_n(&(a->busy), 1, __ATOMIC_SEQ_CST);
+    if( 0 == strcmp(req, "get") )
+        rc = admin_get(a->cfg, args, &w);
+    else if( 0 == strcmp(req, "set") )
+        rc = admin_set(a->cfg, args);
+    else if( 0 == strcmp(req, "origin") )
+        rc = admin_origin(a->cfg, args, &w);
+    else if( 0 == strcmp(req, "list") ) {
+        admin_list(args, &w);
+        rc = w.err;
+    }
+    else if( 0 == strcmp(req, "dump") )
+        rc = admin_dump(a->cfg, args, &w);
+    else
+        rc = ENOSYS;
+    __atomic_store_n(&(a->busy), 0, __ATOMIC_SEQ_CST);
+
+    if( 0 == rc )
+        snprintf(hdr, sizeof(hdr), "OK %zu\n", w.len);
+    else if( ENOENT == rc )
+        snprintf(hdr, sizeof(hdr), "ERR %d unknown option '%.256s'\n", rc, args);
+    else if( ENOSYS == rc )
+        snprintf(hdr, sizeof(hdr), "ERR %d unknown request '%.256s'\n", rc, req);
+    else
+        snprintf(hdr, sizeof(hdr), "ERR %d %s\n", rc, strerror(rc));
+    rc = local_write(fd, hdr, strlen(hdr));
+    if( (0 == rc) && ('O' == hdr[0]) && (w.len > 0) )
+        rc = local_write(fd, w.buf, w.len);
+    free(w.buf);
+    return rc;
+}
+
+// serve requests from a client until it disconnects
+static void admin_session(struct configurator_admin* a,
+                          int fd)
+{
+    char buf[PREFIX_CFG_ADMIN_MAX_REQUEST];
+    size_t len = 0;
+    ssize_t n;
+    char* eol;
+    char* req;
+
+    for( ;; ) {
+        if( ! admin_wait(a, fd, PREFIX_CFG_ADMIN_IDLE_MS) )
+            return;
+        n = read(fd, buf + len, sizeof(buf) - len);
+        if( (n < 0) && (EINTR == errno) )
+            continue;
+        if( n <= 0 )
+            return;
+        len += (size_t) n;
+
+        req = buf;
+        while( NULL != (eol = (char*) memchr(req, '\n', len - (size_t)(req - buf))) ) {
+            *eol = '\0';
+            if( (eol > req) && ('\r' == eol[-1]) )
+                eol[-1] = '\0';
+            if( ! admin_throttle(a) )
+                return;
+            if( 0 != admin_request(a, fd, req) )
+                return;
+            req = eol + 1;
+        }
+        len -= (size_t)(req - buf);
+        memmove(buf, req, len);
+        if( len == sizeof(buf) ) {
+            local_write(fd, "ERR 7 request too long\n", 23);  // E2BIG
+            return;
+        }
+    }
+}
+
+static void* admin_main(void* arg)
+{
+    int fd;
+    struct configurator_admin* a = (struct configurator_admin*) arg;
+
+    while( admin_wait(a, a->listen_fd, -1) ) {
+        fd = accept(a->listen_fd, NULL, NULL);
+        if( -1 == fd )
+            continue;
+        if( admin_peer_ok(fd) )
+            admin_session(a, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static void admin_free(struct configurator_admin* a)
+{
+    if( -1 != a->listen_fd ) {
+        close(a->listen_fd);
+        unlink(a->path);
+    }
+    if( -1 != a->stop_fds[0] ) {
+        close(a->stop_fds[0]);
+        close(a->stop_fds[1]);
+    }
+    free(a->path);
+    free(a);
+}
+
+// serve admin requests for cfg on a Unix-domain socket at path
+int prefix_config_admin_start(prefix_cfg_t* cfg,
+                              const char* path,
+                              unsigned rate)
+{
+    int rc;
+    struct stat st;
+    struct sockaddr_un addr;
+    struct configurator_admin* a;
+    sigset_t all, old;
+
+    if( (NULL == cfg) || (NULL == path) )
+        return EINVAL;
+    if( NULL != cfg->_admin )
+        return EBUSY;
+    memset((void*)&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( strlen(path) >= sizeof(addr.sun_path) )
+        return ENAMETOOLONG;
+    strcpy(addr.sun_path, path);
+
+    a = (struct configurator_admin*) calloc(1, sizeof(struct configurator_admin));
+    if( NULL == a )
+        return ENOMEM;
+    a->cfg = cfg;
+    a->listen_fd = -1;
+    a->stop_fds[0] = a->stop_fds[1] = -1;
+    a->interval = 1000000000ULL / (rate ? rate : PREFIX_CFG_ADMIN_RATE);
+    a->path = strdup(path);
+    if( NULL == a->path ) {
+        free(a);
+        return ENOMEM;
     }
-
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
-    envval = getenv_helper(#sec, #key, 0);                      \
-    if( NULL != envval ) {                                      \
-        cfg->sec##_##key = strdup(envval);                      \
+    if( 0 != pipe(a->stop_fds) ) {
+        rc = errno;
+        a->stop_fds[0] = a->stop_fds[1] = -1;
+        admin_free(a);
+        return rc;
     }
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)  \
-    for( u=0; u < me; u++ ) {                           \
-        envval = getenv_helper(#sec, #key, u+1);        \
-        if( NULL != envval ) {                          \
-            cfg->sec##_##key[u] = strdup(envval);       \
-            cfg->n_##sec##_##key++;                     \
-        }                                               \
+    // replace a stale socket, but nothing else
+    if( (0 == lstat(path, &st)) && S_ISSOCK(st.st_mode) )
+        unlink(path);
+    a->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( (-1 == a->listen_fd)
+        || (0 != bind(a->listen_fd, (struct sockaddr*) &addr, sizeof(addr))) ) {
+        rc = errno;
+        if( -1 != a->listen_fd ) {
+            close(a->listen_fd);
+            a->listen_fd = -1;  // path is not ours to unlink
+        }
+        admin_free(a);
+        return rc;
+    }
+    if( (0 != chmod(path, S_IRUSR | S_IWUSR))
+        || (0 != listen(a->listen_fd, 8)) ) {
+        rc = errno;
+        admin_free(a);
+        return rc;
     }
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-    for( u=0; u < me; u++ ) {                                           \
-        envval = getenv_helper(#sec, #key, u+1);                        \
-        if( NULL != envval ) {                                          \
-            cfg->sec##_##key[u] = strdup(envval);                       \
-            cfg->n_##sec##_##key++;                                     \
-        }                                                               \
+    // signals are left to the application's threads
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&(a->thread), NULL, admin_main, a);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if( rc ) {
+        admin_free(a);
+        return rc;
     }
 
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+    __atomic_store_n(&(cfg->_admin), a, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// stop serving admin requests, and remove the socket
+int prefix_config_admin_stop(prefix_cfg_t* cfg)
+{
+    ssize_t n;
+    struct configurator_admin* a;
 
+    if( NULL == cfg )
+        return EINVAL;
+    a = __atomic_exchange_n(&(cfg->_admin), NULL, __ATOMIC_ACQ_REL);
+    if( NULL == a )
+        return ENOENT;
+
+    do {
+        n = write(a->stop_fds[1], "", 1);
+    } while( (n < 0) && (EINTR == errno) );
+    pthread_join(a->thread, NULL);
+    admin_free(a);
     return 0;
 }
 
-// inih callback handler
-int inih_config_handler(void* user,
-                        const char* section,
-                        const char* kee,
-                        const char* val)
+// wait while an admin request may be reading strings about to be freed
+static void admin_quiesce(prefix_cfg_t* cfg)
 {
-    char* curval;
-    char* defval;
-    prefix_cfg_t* cfg = (prefix_cfg_t*) user;
-    assert( NULL != cfg );
+    struct configurator_admin* a;
 
-    // if not already set by CLI args, set cfg cfgs
-    if( 0 ) ;
+    a = __atomic_load_n(&(cfg->_admin), __ATOMIC_ACQUIRE);
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                        \
-    else if( (0 == strcmp(section, #sec)) && (0 == strcmp(kee, #key)) ) { \
-        curval = cfg->sec##_##key;                                      \
-        defval = stringify(dv);                                         \
-        if( (NULL == curval) || (0 == strcmp(defval, curval)) )         \
-            cfg->sec##_##key = strdup(val);                             \
-    }
+    // subscribers of admin updates run on the admin thread itself
+    if( (NULL == a) || pthread_equal(pthread_self(), a->thread) )
+        return;
+    while( __atomic_fetch_or(&(a->busy), 0, __ATOMIC_SEQ_CST) )
+        sched_yield();
+}
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)          \
-    else if( (0 == strcmp(section, #sec)) && (0 == strcmp(kee, #key)) ) { \
-        curval = cfg->sec##_##key;                                      \
-        defval = stringify(dv);                                         \
-        if( (NULL == curval) || (0 == strcmp(defval, curval)) )         \
-            cfg->sec##_##key = strdup(val);                             \
+// send a single request to the admin socket at path
+int prefix_config_admin_query(const char* path,
+                              const char* request,
+                              char** reply,
+                              size_t* len)
+{
+    int fd;
+    int rc;
+    int err = 0;
+    size_t n = 0;
+    size_t plen;
+    char hdr[PREFIX_CFG_MAX_MSG];
+    char* msg;
+    char* payload;
+    struct sockaddr_un addr;
+
+    if( (NULL == path) || (NULL == request) || (NULL == reply)
+        || (NULL != strchr(request, '\n')) )
+        return EINVAL;
+    *reply = NULL;
+    memset((void*)&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( strlen(path) >= sizeof(addr.sun_path) )
+        return ENAMETOOLONG;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( -1 == fd )
+        return errno;
+    if( 0 != connect(fd, (const struct sockaddr*) &addr, sizeof(addr)) ) {
+        rc = errno;
+        close(fd);
+        return rc;
     }
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)                  \
-    else if( (0 == strcmp(section, #sec)) && (0 == strcmp(kee, #key)) ) { \
-        cfg->sec##_##key[cfg->n_##sec##_##key++] = strdup(val);         \
+    rc = local_write(fd, request, strlen(request));
+    if( 0 == rc )
+        rc = local_write(fd, "\n", 1);
+
+    // reply header, read a byte at a time so as not to consume the payload
+    while( (0 == rc) && (n < sizeof(hdr)) ) {
+        rc = local_read(fd, hdr + n, 1);
+        if( '\n' == hdr[n] )
+            break;
+        n++;
+    }
+    if( (0 == rc) && (n == sizeof(hdr)) )
+        rc = EPROTO;
+    if( rc ) {
+        close(fd);
+        return rc;
     }
+    hdr[n] = '\0';
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-    else if( (0 == strcmp(section, #sec)) && (0 == strcmp(kee, #key)) ) { \
-        cfg->sec##_##key[cfg->n_##sec##_##key++] = strdup(val);         \
+    if( 1 == sscanf(hdr, "OK %zu", &plen) ) {
+        payload = (char*) malloc(plen + 1);
+        if( NULL == payload )
+            rc = ENOMEM;
+        else
+            rc = local_read(fd, payload, plen);
+        if( rc ) {
+            free(payload);
+            payload = NULL;
+        }
+        else {
+            payload[plen] = '\0';
+            if( NULL != len )
+                *len = plen;
+        }
+    }
+    else if( (0 == strncmp(hdr, "ERR ", 4))
+             && (1 == sscanf(hdr + 4, "%d", &err)) && (err > 0) ) {
+        // the remote error, with its message as the reply
+        msg = strchr(hdr + 4, ' ');
+        payload = strdup((NULL != msg) ? (msg + 1) : "");
+        if( NULL == payload )
+            rc = ENOMEM;
+        else {
+            rc = err;
+            if( NULL != len )
+                *len = strlen(payload);
+        }
+    }
+    else {
+        payload = NULL;
+        rc = EPROTO;
     }
 
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+    close(fd);
+    *reply = payload;
+    return rc;
+}
 
-    return 1;
+/* single-pass numeric scanning
+
+   Plain integer and float literals are converted as they are scanned
+   (floats independently of the locale), and only values that contain
+   expression operators are evaluated by tinyexpr. */
+
+typedef enum {
+    NUM_NONE = 0,         // no leading number
+    NUM_INT,
+    NUM_FLOAT
+} num_kind_e;
+
+typedef struct {
+    num_kind_e kind;
+    long i;               // NUM_INT value
+    double f;             // value as a double, for either kind
+    const char* end;      // first character after the number
+} num_scan_t;
+
+// largest mantissa that a double holds exactly
+#define NUM_EXACT_MANTISSA (1ULL << 53)
+
+// exact powers of ten for the float fast path
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+static locale_t c_locale = (locale_t) 0;
+
+static void c_locale_init(void)
+{
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
 }
 
-// json callback handler
-void json_config_handler(enum NanoJSONCError error, const char *const key, const char *const value,
-                        const char *const section, void *object)
+// strtod() in the "C" locale, whatever the program's locale
+static double strtod_c(const char* s,
+                       char** end)
 {
-    if (error != NO_ERROR)
-    {
-        return;
+    pthread_once(&c_locale_once, c_locale_init);
+    if( (locale_t) 0 != c_locale )
+        return strtod_l(s, end, c_locale);
+    return strtod(s, end);
+}
+
+// shortest %g rendering of f that reads back exactly, in the C locale
+static void format_double(char* buf,
+                          size_t len,
+                          double f)
+{
+    int prec;
+    locale_t old = (locale_t) 0;
+
+    pthread_once(&c_locale_once, c_locale_init);
+    if( (locale_t) 0 != c_locale )
+        old = uselocale(c_locale);
+    for( prec=15; prec <= 17; prec++ ) {
+        snprintf(buf, len, "%.*g", prec, f);
+        if( strtod_c(buf, NULL) == f )
+            break;
     }
-    char* simple_section = section ? strdup(section) : NULL;
+    if( (locale_t) 0 != old )
+        uselocale(old);
+}
 
-    if(simple_section)
-    {
-        simple_section[strlen(simple_section)-1] = '\0';
-        inih_config_handler(object, simple_section + sizeof(char), key, value);
+// scan a number the fast path cannot handle (inf/nan, hex floats, etc.)
+static int num_scan_slow(const char* val,
+                         num_scan_t* ns)
+{
+    char* end;
 
+    errno = 0;
+    ns->f = strtod_c(val, &end);
+    if( end == val )
+        return 0;
+    if( ERANGE == errno )
+        return EINVAL;
+    ns->kind = NUM_FLOAT;
+    ns->end = end;
+    return 0;
+}
+
+/* scan a decimal float starting at p (after any sign). Values with at
+   most 53 bits of mantissa and a power of ten within 1e22 are exact
+   operands, so one multiply or divide gives the correctly rounded result.
+   Others use strtod() in the "C" locale. */
+static int num_scan_float(const char* val,
+                          const char* p,
+                          bool neg,
+                          num_scan_t* ns)
+{
+    bool exact = true;
+    bool frac = false;
+    int exp10 = 0;
+    int exp_sign = 1;
+    int exp_val = 0;
+    unsigned ndigits = 0;
+    unsigned d;
+    unsigned long long mant = 0;
+
+    for( ; isdigit((unsigned char)*p) || (('.' == *p) && ! frac); p++ ) {
+        if( '.' == *p ) {
+            frac = true;
+            continue;
+        }
+        d = (unsigned)(*p - '0');
+        ndigits++;
+        if( mant <= (NUM_EXACT_MANTISSA - d) / 10 ) {
+            mant = (mant * 10) + d;
+            if( frac ) exp10--;
+        }
+        else {
+            // dropped digits
+            if( 0 != d ) exact = false;
+            if( ! frac ) exp10++;
+        }
     }
-    else
-    {
-        inih_config_handler(object, NULL, key, value);
+    if( 0 == ndigits )
+        return EINVAL;
+
+    if( ('e' == *p) || ('E' == *p) ) {
+        p++;
+        if( ('+' == *p) || ('-' == *p) )
+            exp_sign = ('-' == *p++) ? -1 : 1;
+        if( ! isdigit((unsigned char)*p) )
+            return EINVAL;
+        for( ; isdigit((unsigned char)*p); p++ ) {
+            if( exp_val < 100000 )
+                exp_val = (exp_val * 10) + (*p - '0');
+        }
+        exp10 += exp_sign * exp_val;
     }
 
-    free(simple_section);
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    if( exact && (exp10 >= -22) && (exp10 <= 22) ) {
+        ns->f = (double) mant;
+        if( exp10 < 0 )
+            ns->f /= pow10_exact[-exp10];
+        else
+            ns->f *= pow10_exact[exp10];
+        if( neg ) ns->f = -(ns->f);
+        ns->kind = NUM_FLOAT;
+        ns->end = p;
+        return 0;
+    }
+#endif
+    if( (0 != num_scan_slow(val, ns)) || (ns->end != p) )
+        return EINVAL;
+    return 0;
 }
 
-int json_parse(const char* filename, NanoJSONCCallback json_config_handler, prefix_cfg_t* cfg)
+/* scan a leading number from val: an integer (decimal, 0x hex, or, when
+   int_octal is set, 0 octal as for strtol() with base 0) or a float.
+   Returns EINVAL for malformed or out-of-range numbers, otherwise 0, with
+   kind NUM_NONE if val does not start with a number. Integers too large
+   for a long are scanned as floats. */
+static int num_scan(const char* val,
+                    bool int_octal,
+                    num_scan_t* ns)
 {
-    int error = -1;
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        return -1; // File could not be opened
+    const char* p = val;
+    const char* digits;
+    bool neg = false;
+    unsigned base = 10;
+    unsigned d;
+    unsigned long u = 0;
+    unsigned long limit;
+
+    memset((void*)ns, 0, sizeof(*ns));
+    ns->end = val;
+
+    while( isspace((unsigned char)*p) )
+        p++;
+    if( ('+' == *p) || ('-' == *p) )
+        neg = ('-' == *p++);
+    limit = neg ? ((unsigned long) LONG_MAX + 1) : (unsigned long) LONG_MAX;
+
+    if( ('0' == p[0]) && (('x' == p[1]) || ('X' == p[1]))
+        && isxdigit((unsigned char)p[2]) ) {
+        base = 16;
+        p += 2;
     }
 
-    // Get file size
-    struct stat sb;
-    if(stat(filename, &sb) != 0)
-    {
-        goto cleanup;
+    digits = p;
+    while( (16 == base) ? isxdigit((unsigned char)*p) : isdigit((unsigned char)*p) )
+        p++;
+
+    if( (16 == base) && (('.' == *p) || ('p' == *p) || ('P' == *p)) )
+        return num_scan_slow(val, ns);
+    if( (16 != base) && (('.' == *p) || ('e' == *p) || ('E' == *p)) )
+        return num_scan_float(val, digits, neg, ns);
+    if( p == digits )
+        return num_scan_slow(val, ns);
+
+    if( int_octal && ('0' == *digits) && ((p - digits) > 1) )
+        base = 8;
+    for( ; digits < p; digits++ ) {
+        d = isdigit((unsigned char)*digits) ? (unsigned)(*digits - '0')
+            : (unsigned)(tolower((unsigned char)*digits) - 'a' + 10);
+        if( d >= base )
+            return EINVAL;
+        if( u > (limit - d) / base )
+            return num_scan_slow(val, ns);
+        u = (u * base) + d;
     }
 
-    // Allocate buffer for file content
-    char* source = malloc(sizeof(char) * (sb.st_size + 1));
-    if (!source) {
-        goto cleanup; // Memory allocation failed
+    ns->kind = NUM_INT;
+    ns->i = neg ? (long)(0UL - u) : (long) u;
+    ns->f = (double) ns->i;
+    ns->end = p;
+    return 0;
+}
+
+// check that a number is followed only by (any of) the given suffix chars
+static int num_suffix_ok(const char* end,
+                         const char* suffixes)
+{
+    for( ; '\0' != *end; end++ ) {
+        if( NULL == strchr(suffixes, *end) )
+            return 0;
     }
+    return 1;
+}
 
-    // Read the entire file into memory
-    size_t newLen = fread(source, sizeof(char), sb.st_size, fp);
-    if (ferror(fp)) {
-        goto cleanup; // Error reading file
+int contains_expression(const char* val)
+{
+    const char* p;
+
+    for( p = val; '\0' != *p; p++ ) {
+        switch( *p ) {
+        case '(':
+        case ')':
+        case '*':
+        case '/':
+        case '%':
+        case '^':
+            return 1;
+        case '+':
+        case '-':
+            // signs in exponent notation are not operators
+            if( (p == val) || (('e' != p[-1]) && ('E' != p[-1])) )
+                return 1;
+            break;
+        default:
+            break;
+        }
     }
+    return 0;
+}
 
-    source[newLen+1] = '\0'; /* Just to be safe. */
-    error = 0;
-    nanojsonc_parse_object(source, NULL, cfg, json_config_handler);
+// evaluate an expression with tinyexpr
+static int expression_val(const char* val,
+                          double* d)
+{
+    int err = 0;
+    double teval;
 
-cleanup:
-    if (source)
-        free(source);
-    fclose(fp);
-    return error;
+    if( ! contains_expression(val) )
+        return EINVAL;
+    teval = te_interp(val, &err);
+    if( 0 != err )
+        return EINVAL;
+    *d = teval;
+    return 0;
 }
 
-int ini_error_handler(const int errcode, const char* file_path) {
-    int rc;
-    char errmsg[PREFIX_CFG_MAX_MSG];
-    switch( errcode ) {
-    case 0:
-        rc = 0;
-        break;
-    case -1:
-        snprintf(errmsg, sizeof(errmsg),
-                 "failed to open config file %s",
-                 file_path);
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
-        rc = ENOENT;
-        break;
-    case -2:
-        snprintf(errmsg, sizeof(errmsg),
-                 "failed to parse config file %s",
-                 file_path);
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
-        rc = ENOMEM;
-        break;
-    default:
-        /* > 0  indicates parse error at line */
-        if( errcode > 0 )
-            snprintf(errmsg, sizeof(errmsg),
-                     "parse error at line %d of config file %s",
-                     errcode, file_path);
-        else
-            snprintf(errmsg, sizeof(errmsg),
-                     "failed to parse config file %s",
-                     file_path);
-        rc = EINVAL;
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
-        break;
-    }
-    return rc;
-}
+/* integer expressions
+
+   INT, SIZE, and DURATION expressions are compiled to a small stack
+   bytecode and evaluated in 64-bit integer arithmetic, so values beyond
+   2^53 stay exact, and overflow is an error rather than a rounded result.
+   + - * / % ^ follow tinyexpr's rules: unary operators bind tighter than
+   ^, which is left-associative (so -2^2 is 4, and 2^3^2 is 64). Besides
+   those, they support << >> & | ~, min(a,b), max(a,b), abs(a), and the
+   size constants KB, MB, GB, TB, PB, EB (powers of 1000) and KiB .. EiB
+   (powers of 1024). Expressions the compiler does not accept (e.g., float
+   operands or other tinyexpr functions), or with a non-integer step (e.g.,
+   7/2*2 or 2^-1), are evaluated by tinyexpr instead, giving the same
+   truncated result as before. */
+
+typedef enum {
+    IX_PUSH = 0,
+    IX_NEG,
+    IX_NOT,
+    IX_ABS,
+    IX_ADD,
+    IX_SUB,
+    IX_MUL,
+    IX_DIV,
+    IX_MOD,
+    IX_POW,
+    IX_SHL,
+    IX_SHR,
+    IX_AND,
+    IX_OR,
+    IX_MIN,
+    IX_MAX
+} intexpr_op_e;
+
+// longer expressions are left to tinyexpr
+#define INTEXPR_MAX_CODE 128
+
+typedef struct {
+    unsigned char op[INTEXPR_MAX_CODE];
+    long imm[INTEXPR_MAX_CODE];     // IX_PUSH operands
+    unsigned len;
+    const char* p;                  // compile position
+    unsigned depth;                 // parenthesis and unary nesting
+} intexpr_t;
+
+typedef struct {
+    const char* name;
+    long value;
+} intexpr_const_t;
+
+static const intexpr_const_t intexpr_consts[] = {
+    { "KB", 1000L }, { "MB", 1000000L }, { "GB", 1000000000L },
+    { "TB", 1000000000000L }, { "PB", 1000000000000000L },
+    { "EB", 1000000000000000000L },
+    { "KiB", 1L << 10 }, { "MiB", 1L << 20 }, { "GiB", 1L << 30 },
+    { "TiB", 1L << 40 }, { "PiB", 1L << 50 }, { "EiB", 1L << 60 },
+    { NULL, 0 }
+};
 
-int json_error_handler(const int errcode, const char* file_path)
+/* binary operator at p, with its precedence (loosest is 1) and length,
+   where ^ binds tighter than these and is handled separately */
+static int intexpr_binop(const char* p,
+                         intexpr_op_e* op,
+                         int* len)
 {
-    int rc;
-    char errmsg[PREFIX_CFG_MAX_MSG];
-    switch( errcode ) {
-    case 0:
-            rc = 0;
-        break;
-    case -1:
-        snprintf(errmsg, sizeof(errmsg),
-                     "failed to open config file %s",
-                     file_path);
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
-        rc = ENOENT;
-        break;
-    case -2:
-        snprintf(errmsg, sizeof(errmsg),
-                     "failed to parse config file %s",
-                     file_path);
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
-        rc = ENOMEM;
-        break;
+    *len = 1;
+    switch( *p ) {
+    case '|': *op = IX_OR;  return 1;
+    case '&': *op = IX_AND; return 2;
+    case '<':
+    case '>':
+        if( p[1] != p[0] )
+            return 0;
+        *op = ('<' == *p) ? IX_SHL : IX_SHR;
+        *len = 2;
+        return 3;
+    case '+': *op = IX_ADD; return 4;
+    case '-': *op = IX_SUB; return 4;
+    case '*': *op = IX_MUL; return 5;
+    case '/': *op = IX_DIV; return 5;
+    case '%': *op = IX_MOD; return 5;
     default:
-        /* > 0  indicates parse error at line */
-        if( errcode > 0 )
-            snprintf(errmsg, sizeof(errmsg),
-                     "parse error at line %d of config file %s",
-                     errcode, file_path);
-        else
-            snprintf(errmsg, sizeof(errmsg),
-                     "failed to parse config file %s",
-                     file_path);
-        rc = EINVAL;
-        fprintf(stderr, "PREFIX CONFIG ERROR: %s\n", errmsg);
         break;
     }
-    return rc;
+    return 0;
 }
 
-//int yaml_error_handler()
-//{
-//  return 0;
-//}
+static int intexpr_expr(intexpr_t* x,
+                        int prec);
 
-// update config struct based on config file, using inih
-int prefix_config_process_file(prefix_cfg_t* cfg,
-                               const char* file)
+static int intexpr_emit(intexpr_t* x,
+                        intexpr_op_e op,
+                        long imm)
 {
-    int rc;
+    if( x->len == INTEXPR_MAX_CODE )
+        return ENOTSUP;
+    x->op[x->len] = (unsigned char) op;
+    x->imm[x->len] = imm;
+    x->len++;
+    return 0;
+}
 
-    if( NULL == cfg )
-        return rc;
-    
-    if( NULL == file )
-        return EINVAL;
+static char intexpr_peek(intexpr_t* x)
+{
+    while( isspace((unsigned char)*(x->p)) )
+        x->p++;
+    return *(x->p);
+}
 
-    // Determine the filetype based on extension
-    char* ext = strrchr(file, '.');
-    if (!ext) {
-        // no extension, so assume ini
-        ext = "ini";
-    }
-    else
-    {
-        ext++;
+// integer literal, where neg allows -(LONG_MAX + 1)
+static int intexpr_literal(intexpr_t* x,
+                           bool neg)
+{
+    const char* p = x->p;
+    unsigned base = 10;
+    unsigned d;
+    unsigned long u = 0;
+    unsigned long limit = neg ? ((unsigned long) LONG_MAX + 1) : (unsigned long) LONG_MAX;
+
+    if( ('0' == p[0]) && (('x' == p[1]) || ('X' == p[1])) ) {
+        base = 16;
+        p += 2;
+        if( ! isxdigit((unsigned char)*p) )
+            return ENOTSUP;
     }
 
-    if (strcmp(ext, "cfg") == 0 || strcmp(ext, "ini") == 0) {
-        const int ini_error = ini_parse(file, inih_config_handler, cfg);
-        rc = ini_error_handler(ini_error, file);
-    }
-    else if (strcmp(ext, "json") == 0) {
-        const int json_error = json_parse(file, json_config_handler, cfg);
-        rc = json_error_handler(json_error, file);
+    for( ; isxdigit((unsigned char)*p); p++ ) {
+        d = isdigit((unsigned char)*p) ? (unsigned)(*p - '0')
+            : (unsigned)(tolower((unsigned char)*p) - 'a' + 10);
+        if( d >= base )
+            return ENOTSUP;
+        if( u > (limit - d) / base )
+            return ERANGE;
+        u = (u * base) + d;
     }
-//    else if (strcmp(ext, "yaml") == 0 || strcmp(ext, "yml") == 0) {
-//        rc = yaml_error_handler();
-//    }
-
-    return rc;
+    // floats and suffixed numbers are left to tinyexpr
+    if( isalnum((unsigned char)*p) || ('.' == *p) || ('_' == *p) )
+        return ENOTSUP;
+    x->p = p;
+    return intexpr_emit(x, IX_PUSH, neg ? (long)(0UL - u) : (long) u);
 }
 
+// size constant or function call
+static int intexpr_name(intexpr_t* x)
+{
+    int rc;
+    size_t len;
+    intexpr_op_e op;
+    const intexpr_const_t* c;
+    const char* name = x->p;
 
-/* predefined validation functions */
+    for( len=0; isalnum((unsigned char)name[len]) || ('_' == name[len]); len++ );
+    x->p += len;
 
-// utility routine to validate a single value given function
-int validate_value(const char* section,
-                   const char* key,
-                   const char* val,
-                   const char* typ,
-                   configurator_validate_fn vfn,
-                   char** new_val)
-{
-    if( NULL != vfn ) {
-        return vfn(section, key, val, new_val);
+    for( c = intexpr_consts; NULL != c->name; c++ ) {
+        if( (strlen(c->name) == len) && (0 == strncmp(c->name, name, len)) )
+            return intexpr_emit(x, IX_PUSH, c->value);
     }
-    else if( 0 == strcmp(typ, "BOOL") ) {
-        return configurator_bool_check(section, key, val, NULL);
-    }
-    else if( 0 == strcmp(typ, "INT") ) {
-        return configurator_int_check(section, key, val, new_val);
-    }
-    else if( 0 == strcmp(typ, "FLOAT") ) {
-        return configurator_float_check(section, key, val, new_val);
+
+    if( (3 == len) && (0 == strncmp(name, "abs", 3)) )
+        op = IX_ABS;
+    else if( (3 == len) && (0 == strncmp(name, "min", 3)) )
+        op = IX_MIN;
+    else if( (3 == len) && (0 == strncmp(name, "max", 3)) )
+        op = IX_MAX;
+    else
+        return ENOTSUP;
+
+    if( '(' != intexpr_peek(x) )
+        return ENOTSUP;
+    x->p++;
+    rc = intexpr_expr(x, 1);
+    if( rc ) return rc;
+    if( IX_ABS != op ) {
+        if( ',' != intexpr_peek(x) )
+            return ENOTSUP;
+        x->p++;
+        rc = intexpr_expr(x, 1);
+        if( rc ) return rc;
     }
-    return 0;
+    if( ')' != intexpr_peek(x) )
+        return ENOTSUP;
+    x->p++;
+    return intexpr_emit(x, op, 0);
 }
 
-
-// validate configuration
-int prefix_config_validate(prefix_cfg_t* cfg)
+static int intexpr_primary(intexpr_t* x)
 {
-    unsigned u;
-    int rc = 0;
-    int vrc;
-    char* new_val = NULL;
+    int rc;
+    char c = intexpr_peek(x);
+
+    if( '(' == c ) {
+        if( ++(x->depth) > INTEXPR_MAX_CODE )
+            return ENOTSUP;
+        x->p++;
+        rc = intexpr_expr(x, 1);
+        x->depth--;
+        if( rc ) return rc;
+        if( ')' != intexpr_peek(x) )
+            return ENOTSUP;
+        x->p++;
+        return 0;
+    }
+    if( isdigit((unsigned char)c) )
+        return intexpr_literal(x, false);
+    if( isalpha((unsigned char)c) || ('_' == c) )
+        return intexpr_name(x);
+    return ENOTSUP;
+}
 
-    if( NULL == cfg )
-        return EINVAL;
+/* unary operators, then a primary (unary operators bind tighter than ^,
+   as for tinyexpr, so -2^2 is 4) */
+static int intexpr_unary(intexpr_t* x)
+{
+    int rc;
+    char c = intexpr_peek(x);
 
-#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                        \
-    vrc = validate_value(#sec, #key, cfg->sec##_##key, #typ, vfn, &new_val); \
-    if( vrc ) {                                                         \
-        rc = vrc;                                                       \
-        fprintf(stderr, "PREFIX CONFIG ERROR: value '%s' for %s.%s is INVALID %s\n", \
-                cfg->sec##_##key, #sec, #key, #typ);                    \
-    } else if( NULL != new_val ) {                                      \
-        if( NULL != cfg->sec##_##key ) free(cfg->sec##_##key);          \
-        cfg->sec##_##key = new_val;                                     \
-        new_val = NULL;                                                 \
+    if( ('-' == c) && isdigit((unsigned char)x->p[1]) ) {
+        // negative literal, allowing LONG_MIN
+        x->p++;
+        return intexpr_literal(x, true);
+    }
+    if( ('-' == c) || ('+' == c) || ('~' == c) ) {
+        if( ++(x->depth) > INTEXPR_MAX_CODE )
+            return ENOTSUP;
+        x->p++;
+        rc = intexpr_unary(x);
+        x->depth--;
+        if( rc || ('+' == c) ) return rc;
+        return intexpr_emit(x, ('-' == c) ? IX_NEG : IX_NOT, 0);
     }
+    return intexpr_primary(x);
+}
+
+// an operand and any ^ operators, left-associative as for tinyexpr
+static int intexpr_power(intexpr_t* x)
+{
+    int rc;
 
-#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)          \
-    vrc = validate_value(#sec, #key, cfg->sec##_##key, #typ, vfn, &new_val); \
-    if( vrc ) {                                                         \
-        rc = vrc;                                                       \
-        fprintf(stderr, "PREFIX CONFIG ERROR: value '%s' for %s.%s is INVALID %s\n", \
-                cfg->sec##_##key, #sec, #key, #typ);                    \
-    } else if( NULL != new_val ) {                                      \
-        if( NULL != cfg->sec##_##key ) free(cfg->sec##_##key);          \
-        cfg->sec##_##key = new_val;                                     \
-        new_val = NULL;                                                 \
+    rc = intexpr_unary(x);
+    while( (0 == rc) && ('^' == intexpr_peek(x)) ) {
+        x->p++;
+        rc = intexpr_unary(x);
+        if( 0 == rc )
+            rc = intexpr_emit(x, IX_POW, 0);
     }
+    return rc;
+}
 
-#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)                  \
-    for( u=0; u < me; u++ ) {                                           \
-        vrc = validate_value(#sec, #key, cfg->sec##_##key[u], #typ, vfn, &new_val); \
-        if( vrc ) {                                                     \
-            rc = vrc;                                                   \
-            fprintf(stderr, "PREFIX CONFIG ERROR: value[%u] '%s' for %s.%s is INVALID %s\n", \
-                    u+1, cfg->sec##_##key[u], #sec, #key, #typ);        \
-        } else if( NULL != new_val ) {                                  \
-            if( NULL != cfg->sec##_##key[u] ) free(cfg->sec##_##key[u]); \
-            cfg->sec##_##key[u] = new_val;                              \
-            new_val = NULL;                                             \
-        }                                                               \
+// binary operators of at least the given precedence
+static int intexpr_expr(intexpr_t* x,
+                        int prec)
+{
+    int rc;
+    int bprec, len;
+    intexpr_op_e op;
+
+    rc = intexpr_power(x);
+    while( 0 == rc ) {
+        intexpr_peek(x);
+        bprec = intexpr_binop(x->p, &op, &len);
+        if( (0 == bprec) || (bprec < prec) )
+            break;
+        x->p += len;
+        rc = intexpr_expr(x, bprec + 1);
+        if( 0 == rc )
+            rc = intexpr_emit(x, op, 0);
     }
+    return rc;
+}
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
-    for( u=0; u < me; u++ ) {                                           \
-        vrc = validate_value(#sec, #key, cfg->sec##_##key[u], #typ, vfn, &new_val); \
-        if( vrc ) {                                                     \
-            rc = vrc;                                                   \
-            fprintf(stderr, "PREFIX CONFIG ERROR: value[%u] '%s' for %s.%s is INVALID %s\n", \
-                    u+1, cfg->sec##_##key[u], #sec, #key, #typ);        \
-        } else if( NULL != new_val ) {                                  \
-            if( NULL != cfg->sec##_##key[u] ) free(cfg->sec##_##key[u]); \
-            cfg->sec##_##key[u] = new_val;                              \
-            new_val = NULL;                                             \
-        }                                                               \
-    }
-
-    PREFIX_CONFIGS;
-#undef PREFIX_CFG
-#undef PREFIX_CFG_CLI
-#undef PREFIX_CFG_MULTI
-#undef PREFIX_CFG_MULTI_CLI
+static int intexpr_compile(intexpr_t* x,
+                           const char* val)
+{
+    int rc;
 
+    x->len = 0;
+    x->depth = 0;
+    x->p = val;
+    rc = intexpr_expr(x, 1);
+    if( (0 == rc) && ('\0' != intexpr_peek(x)) )
+        rc = ENOTSUP;
     return rc;
 }
 
-int contains_expression(const char* val)
+// b^e, where only 1 and -1 have an integer power for e < 0
+static int intexpr_pow(long b,
+                       long e,
+                       long* r)
 {
-    static char expr_chars[8] = {'(', ')', '+', '-', '*', '/', '%', '^'};
-    size_t s;
-    char c;
-    char* match;
-    for( s=0; s < sizeof(expr_chars); s++ ) {
-        c = expr_chars[s];
-        match = strchr(val, c);
-        if( NULL != match ) {
-            if( (('+' == c) || ('-' == c)) && (match > val) ) {
-                // check for exponent notation
-                c = *(--match);
-                if( ('e' == c) || ('E' == c) )
-                   return 0; // tinyexpr can't handle exponent notation
-            }
-            return 1;
+    long acc = 1;
+
+    if( e < 0 ) {
+        if( 0 == b )
+            return EINVAL;
+        if( (1 != b) && (-1 != b) )
+            return ENOTSUP;
+        *r = ((-1 == b) && (e & 1)) ? -1 : 1;
+    }
+    else {
+        for( ; e > 0; e >>= 1 ) {
+            if( (e & 1) && __builtin_mul_overflow(acc, b, &acc) )
+                return ERANGE;
+            if( (e > 1) && __builtin_mul_overflow(b, b, &b) )
+                return ERANGE;
+        }
+        *r = acc;
+    }
+    return 0;
+}
+
+/* evaluate compiled code, returning ERANGE on overflow, EINVAL on
+   division by zero, and ENOTSUP for a non-integer / or ^ result */
+static int intexpr_eval(const intexpr_t* x,
+                        long* l)
+{
+    int rc;
+    unsigned u;
+    unsigned n = 0;
+    long a, b;
+    long stack[INTEXPR_MAX_CODE];
+
+    for( u=0; u < x->len; u++ ) {
+        if( IX_PUSH == x->op[u] ) {
+            stack[n++] = x->imm[u];
+            continue;
         }
+        if( x->op[u] <= IX_ABS ) {
+            a = stack[n-1];
+            if( (IX_NOT != x->op[u]) && (LONG_MIN == a) )
+                return ERANGE;
+            stack[n-1] = (IX_NEG == x->op[u]) ? -a
+                       : (IX_NOT == x->op[u]) ? ~a
+                       : ((a < 0) ? -a : a);
+            continue;
+        }
+
+        b = stack[--n];
+        a = stack[n-1];
+        switch( x->op[u] ) {
+        case IX_ADD:
+            if( __builtin_add_overflow(a, b, &a) ) return ERANGE;
+            break;
+        case IX_SUB:
+            if( __builtin_sub_overflow(a, b, &a) ) return ERANGE;
+            break;
+        case IX_MUL:
+            if( __builtin_mul_overflow(a, b, &a) ) return ERANGE;
+            break;
+        case IX_DIV:
+        case IX_MOD:
+            if( 0 == b ) return EINVAL;
+            if( (LONG_MIN == a) && (-1 == b) ) return ERANGE;
+            if( IX_MOD == x->op[u] )
+                a %= b;     // same as fmod() for integers
+            else if( 0 != (a % b) )
+                return ENOTSUP;
+            else
+                a /= b;
+            break;
+        case IX_POW:
+            rc = intexpr_pow(a, b, &a);
+            if( rc ) return rc;
+            break;
+        case IX_SHL:
+            if( (b < 0) || (b > 62) || (a < 0)
+                || (a > (LONG_MAX >> b)) ) return ERANGE;
+            a <<= b;
+            break;
+        case IX_SHR:
+            if( (b < 0) || (b > 63) ) return ERANGE;
+            a >>= b;
+            break;
+        case IX_AND:
+            a &= b;
+            break;
+        case IX_OR:
+            a |= b;
+            break;
+        case IX_MIN:
+            a = (b < a) ? b : a;
+            break;
+        case IX_MAX:
+            a = (b > a) ? b : a;
+            break;
+        default:
+            return EINVAL;
+        }
+        stack[n-1] = a;
     }
+    *l = stack[0];
     return 0;
 }
 
+/* evaluate an integer expression, returning ENOTSUP if it needs tinyexpr
+   (literals are decimal or 0x hex, as for tinyexpr) */
+static int intexpr_val(const char* val,
+                       long* l)
+{
+    int rc;
+    intexpr_t x;
+
+    rc = intexpr_compile(&x, val);
+    if( rc )
+        return rc;
+    return intexpr_eval(&x, l);
+}
+
 int configurator_bool_val(const char* val,
                           bool* b)
 {
@@ -942,45 +6434,30 @@ int configurator_bool_check(const char* s,
     return configurator_bool_val(val, &b);
 }
 
+static int float_parse(const char* val,
+                       double* d,
+                       bool* evaluated)
+{
+    num_scan_t ns;
+
+    *evaluated = false;
+    if( (0 == num_scan(val, false, &ns)) && (NUM_NONE != ns.kind)
+        && num_suffix_ok(ns.end, "fFlL") ) {
+        *d = ns.f;
+        return 0;
+    }
+    *evaluated = true;
+    return expression_val(val, d);
+}
+
 int configurator_float_val(const char* val,
                            double* d)
 {
-    int err;
-    double check, teval;
-    char* end = NULL;
+    bool evaluated;
 
     if( (NULL == val) || (NULL == d) )
         return EINVAL;
-
-    if( contains_expression(val) ) {
-        err = 0;
-        teval = te_interp(val, &err);
-        if( 0 == err )
-            check = teval;
-        else
-            return EINVAL;
-    }
-    else {
-        errno = 0;
-        check = strtod(val, &end);
-        err = errno;
-        if( (ERANGE == err) || (end == val) )
-            return EINVAL;
-        else if( *end != 0 ) {
-            switch( *end ) {
-            case 'f':
-            case 'l':
-            case 'F':
-            case 'L':
-                break;
-            default:
-                return EINVAL;
-            }
-        }
-    }
-
-    *d = check;
-    return 0;
+    return float_parse(val, d, &evaluated);
 }
 
 int configurator_float_check(const char* s,
@@ -991,13 +6468,14 @@ int configurator_float_check(const char* s,
     int rc;
     size_t len;
     double d;
+    bool evaluated;
     char* newval = NULL;
 
     if( NULL == val ) // unset is OK
         return 0;
 
-    rc = configurator_float_val(val, &d);
-    if( (NULL != o) && (0 == rc) && contains_expression(val) ) {
+    rc = float_parse(val, &d, &evaluated);
+    if( (NULL != o) && (0 == rc) && evaluated ) {
         // update config setting to evaluated value
         len = strlen(val) + 1; // evaluated value should be shorter
         newval = (char*) calloc(len, sizeof(char));
@@ -1009,46 +6487,38 @@ int configurator_float_check(const char* s,
     return rc;
 }
 
+static int int_parse(const char* val,
+                     long* l,
+                     bool* evaluated)
+{
+    int rc;
+    double d;
+    num_scan_t ns;
+
+    *evaluated = false;
+    if( (0 == num_scan(val, true, &ns)) && (NUM_INT == ns.kind)
+        && num_suffix_ok(ns.end, "lLuU") ) {
+        *l = ns.i;
+        return 0;
+    }
+    *evaluated = true;
+    rc = intexpr_val(val, l);
+    if( ENOTSUP != rc )
+        return rc;
+    rc = expression_val(val, &d);
+    if( 0 == rc )
+        *l = (long) d;
+    return rc;
+}
+
 int configurator_int_val(const char* val,
                          long* l)
 {
-    long check;
-    double teval;
-    int err;
-    char* end = NULL;
+    bool evaluated;
 
     if( (NULL == val) || (NULL == l) )
         return EINVAL;
-
-    if( contains_expression(val) ) {
-        err = 0;
-        teval = te_interp(val, &err);
-        if( 0 == err )
-            check = (long)teval;
-        else
-            return EINVAL;
-    }
-    else {
-        errno = 0;
-        check = strtol(val, &end, 0);
-        err = errno;
-        if( (ERANGE == err) || (end == val) )
-            return EINVAL;
-        else if( *end != 0 ) {
-            switch( *end ) {
-            case 'l':
-            case 'u':
-            case 'L':
-            case 'U':
-                break;
-            default:
-                return EINVAL;
-            }
-        }
-    }
-
-    *l = check;
-    return 0;
+    return int_parse(val, l, &evaluated);
 }
 
 int configurator_int_check(const char* s,
@@ -1059,13 +6529,14 @@ int configurator_int_check(const char* s,
     int rc;
     size_t len;
     long l;
+    bool evaluated;
     char* newval = NULL;
 
     if( NULL == val ) // unset is OK
         return 0;
 
-    rc = configurator_int_val(val, &l);
-    if( (NULL != o) && (0 == rc) && contains_expression(val) ) {
+    rc = int_parse(val, &l, &evaluated);
+    if( (NULL != o) && (0 == rc) && evaluated ) {
         // update config setting to evaluated value
         len = strlen(val) + 1; // evaluated value should be shorter
         newval = (char*) calloc(len, sizeof(char));
@@ -1076,7 +6547,412 @@ int configurator_int_check(const char* s,
     }
     return rc;
 }
+
+/* SIZE and DURATION values are non-negative integers in base units (bytes
+   and nanoseconds), with an optional unit suffix. The number may have a
+   fraction (e.g., 1.5GiB), and the result is rounded to a whole unit. */
+
+typedef struct {
+    const char* suffix;
+    long scale;
+} configurator_unit_t;
+
+static const configurator_unit_t size_units[] = {
+    { "", 1L }, { "B", 1L },
+    { "K", 1000L }, { "KB", 1000L }, { "k", 1000L }, { "kB", 1000L },
+    { "M", 1000000L }, { "MB", 1000000L },
+    { "G", 1000000000L }, { "GB", 1000000000L },
+    { "T", 1000000000000L }, { "TB", 1000000000000L },
+    { "Ki", 1L << 10 }, { "KiB", 1L << 10 },
+    { "Mi", 1L << 20 }, { "MiB", 1L << 20 },
+    { "Gi", 1L << 30 }, { "GiB", 1L << 30 },
+    { "Ti", 1L << 40 }, { "TiB", 1L << 40 },
+    { NULL, 0 }
+};
+
+static const configurator_unit_t duration_units[] = {
+    { "", 1L }, { "ns", 1L }, { "us", 1000L }, { "ms", 1000000L },
+    { "s", 1000000000L }, { "min", 60000000000L }, { "h", 3600000000000L },
+    { NULL, 0 }
+};
+
+// LONG_MAX + 1, exactly representable as a double
+#define UNIT_VALUE_LIMIT 9223372036854775808.0
+
+static int unit_parse(const char* val,
+                      const configurator_unit_t* units,
+                      long* l)
+{
+    int rc;
+    double d;
+    const char* s;
+    const configurator_unit_t* u;
+    num_scan_t ns;
+
+    if( (0 == num_scan(val, false, &ns)) && (NUM_NONE != ns.kind) ) {
+        for( s = ns.end; isspace((unsigned char)*s); s++ );
+        for( u = units; NULL != u->suffix; u++ ) {
+            if( 0 == strcmp(s, u->suffix) )
+                break;
+        }
+        if( NULL != u->suffix ) {
+            if( NUM_INT == ns.kind ) {
+                if( (ns.i < 0) || (ns.i > (LONG_MAX / u->scale)) )
+                    return EINVAL;
+                *l = ns.i * u->scale;
+                return 0;
+            }
+            d = ns.f * (double) u->scale;
+            if( !(d >= 0.0) || (d + 0.5 >= UNIT_VALUE_LIMIT) )
+                return EINVAL;
+            *l = (long)(d + 0.5);
+            return 0;
+        }
+    }
+
+    // expressions are evaluated in base units
+    rc = intexpr_val(val, l);
+    if( ENOTSUP != rc ) {
+        if( (0 == rc) && (*l < 0) )
+            rc = EINVAL;
+        return (0 == rc) ? 0 : EINVAL;
+    }
+    rc = expression_val(val, &d);
+    if( rc )
+        return rc;
+    if( !(d >= 0.0) || (d >= UNIT_VALUE_LIMIT) )
+        return EINVAL;
+    *l = (long) d;
+    return 0;
+}
+
+/* validate a SIZE or DURATION value, replacing any value that is not
+   already a plain integer with its value in base units, so that printed
+   configs, comparisons, and references see a plain integer */
+static int unit_check(const char* val,
+                      const configurator_unit_t* units,
+                      char** o)
+{
+    int rc;
+    long l;
+    char buf[32];
+
+    if( NULL == val ) // unset is OK
+        return 0;
+
+    rc = unit_parse(val, units, &l);
+    if( (NULL != o) && (0 == rc) ) {
+        snprintf(buf, sizeof(buf), "%ld", l);
+        if( 0 != strcmp(buf, val) )
+            *o = strdup(buf);
+    }
+    return rc;
+}
+
+int configurator_size_val(const char* val,
+                          long* l)
+{
+    if( (NULL == val) || (NULL == l) )
+        return EINVAL;
+    return unit_parse(val, size_units, l);
+}
+
+int configurator_size_check(const char* s,
+                            const char* k,
+                            const char* val,
+                            char** o)
+{
+    return unit_check(val, size_units, o);
+}
+
+int configurator_duration_val(const char* val,
+                              long* l)
+{
+    if( (NULL == val) || (NULL == l) )
+        return EINVAL;
+    return unit_parse(val, duration_units, l);
+}
+
+int configurator_duration_check(const char* s,
+                                const char* k,
+                                const char* val,
+                                char** o)
+{
+    return unit_check(val, duration_units, o);
+}
+
+int configurator_enum_val(configurator_enum_fn lookup,
+                          const char* val,
+                          int* e)
+{
+    if( (NULL == lookup) || (NULL == val) || (NULL == e) )
+        return EINVAL;
+    return (NULL != lookup(val, e)) ? 0 : EINVAL;
+}
+
+// check an ENUM value, listing the valid item names when it is not one
+int configurator_enum_check(configurator_enum_fn lookup,
+                            const char* s,
+                            const char* k,
+                            const char* val)
+{
+    int e;
+    size_t len = 0;
+    const char* name;
+    char names[PREFIX_CFG_MAX_MSG];
+
+    if( NULL == val ) // unset is OK
+        return 0;
+    if( 0 == configurator_enum_val(lookup, val, &e) )
+        return 0;
+
+    names[0] = '\0';
+    for( e=1; (NULL != lookup) && (NULL != (name = lookup(NULL, &e))); e++ ) {
+        if( len < sizeof(names) )
+            len += (size_t) snprintf(names + len, sizeof(names) - len, "%s%s",
+                                     ((1 == e) ? "" : ", "), name);
+    }
+    fprintf(stderr, "PREFIX CONFIG ERROR: '%s' for %s.%s is not one of: %s\n",
+            val, (NULL != s) ? s : "", (NULL != k) ? k : "", names);
+    return EINVAL;
+}
     
+/* RANGELIST values */
+
+typedef struct {
+    configurator_range_t* ranges;
+    unsigned count;
+    unsigned cap;
+} range_vec_t;
+
+static int range_push(range_vec_t* rv,
+                      long lo,
+                      long hi)
+{
+    configurator_range_t* r;
+    unsigned cap;
+
+    if( rv->count == rv->cap ) {
+        if( rv->cap >= CONFIGURATOR_RANGELIST_MAX_RANGES )
+            return ERANGE;
+        cap = (0 == rv->cap) ? 8 : (2 * rv->cap);
+        r = (configurator_range_t*) realloc(rv->ranges, cap * sizeof(*r));
+        if( NULL == r )
+            return ENOMEM;
+        rv->ranges = r;
+        rv->cap = cap;
+    }
+    rv->ranges[rv->count].lo = lo;
+    rv->ranges[rv->count].hi = hi;
+    rv->count++;
+    return 0;
+}
+
+static int range_cmp(const void* a,
+                     const void* b)
+{
+    const configurator_range_t* x = (const configurator_range_t*) a;
+    const configurator_range_t* y = (const configurator_range_t*) b;
+    return (x->lo < y->lo) ? -1 : (x->lo > y->lo);
+}
+
+// parse a non-negative decimal value (LONG_MAX is excluded, so counts fit)
+static int range_value(const char** s,
+                       long* l)
+{
+    char* end;
+
+    while( isspace((unsigned char)**s) ) (*s)++;
+    if( ! isdigit((unsigned char)**s) )
+        return EINVAL;
+    errno = 0;
+    *l = strtol(*s, &end, 10);
+    if( (0 != errno) || (LONG_MAX == *l) )
+        return ERANGE;
+    for( *s = end; isspace((unsigned char)**s); (*s)++ );
+    return 0;
+}
+
+// parse one lo[-hi[:stride]] item, appending its ranges
+static int range_item(const char** s,
+                      range_vec_t* rv)
+{
+    int rc;
+    long lo, hi, stride = 1;
+
+    rc = range_value(s, &lo);
+    if( rc ) return rc;
+    hi = lo;
+    if( '-' == **s ) {
+        (*s)++;
+        rc = range_value(s, &hi);
+        if( rc ) return rc;
+        if( hi < lo )
+            return EINVAL;
+        if( ':' == **s ) {
+            (*s)++;
+            rc = range_value(s, &stride);
+            if( rc ) return rc;
+            if( 0 == stride )
+                return EINVAL;
+        }
+    }
+
+    if( 1 == stride )
+        return range_push(rv, lo, hi);
+    for( ; ; lo += stride ) {
+        rc = range_push(rv, lo, lo);
+        if( rc || ((hi - lo) < stride) )
+            return rc;
+    }
+}
+
+// parse a range list into sorted, merged ranges (rv->count is 0 if empty)
+static int range_parse(const char* val,
+                       range_vec_t* rv)
+{
+    int rc;
+    unsigned u, n = 0;
+    const char* s = val;
+
+    memset((void*)rv, 0, sizeof(*rv));
+    while( isspace((unsigned char)*s) ) s++;
+    while( '\0' != *s ) {
+        rc = range_item(&s, rv);
+        if( (0 == rc) && (',' == *s) ) {
+            s++;
+            if( '\0' == *s ) // trailing comma
+                rc = EINVAL;
+        }
+        else if( (0 == rc) && ('\0' != *s) )
+            rc = EINVAL;
+        if( rc ) {
+            free(rv->ranges);
+            memset((void*)rv, 0, sizeof(*rv));
+            return rc;
+        }
+    }
+
+    if( rv->count > 1 )
+        qsort(rv->ranges, rv->count, sizeof(configurator_range_t), range_cmp);
+    for( u=1; u < rv->count; u++ ) {
+        if( rv->ranges[u].lo <= rv->ranges[n].hi + 1 ) {
+            if( rv->ranges[u].hi > rv->ranges[n].hi )
+                rv->ranges[n].hi = rv->ranges[u].hi;
+        } else
+            rv->ranges[++n] = rv->ranges[u];
+    }
+    if( rv->count > 0 )
+        rv->count = n + 1;
+    return 0;
+}
+
+int configurator_rangelist_val(const char* val,
+                               configurator_rangelist_t** rl)
+{
+    int rc;
+    unsigned u;
+    range_vec_t rv;
+    configurator_rangelist_t* l;
+    configurator_range_t* ranges;
+
+    if( (NULL == val) || (NULL == rl) )
+        return EINVAL;
+
+    rc = range_parse(val, &rv);
+    if( rc )
+        return rc;
+
+    // one allocation, freed as a whole
+    l = (configurator_rangelist_t*) malloc(sizeof(*l) + (rv.count * sizeof(*ranges)));
+    if( NULL == l ) {
+        free(rv.ranges);
+        return ENOMEM;
+    }
+    ranges = (configurator_range_t*)(l + 1);
+    l->ranges = ranges;
+    l->count = rv.count;
+    l->total = 0;
+    for( u=0; u < rv.count; u++ ) {
+        ranges[u] = rv.ranges[u];
+        l->total += (ranges[u].hi - ranges[u].lo) + 1;
+    }
+    free(rv.ranges);
+    *rl = l;
+    return 0;
+}
+
+/* validate a RANGELIST value, replacing it with its canonical form, so that
+   printed configs and comparisons see sorted, merged ranges */
+int configurator_rangelist_check(const char* s,
+                                 const char* k,
+                                 const char* val,
+                                 char** o)
+{
+    int rc;
+    unsigned u;
+    size_t len = 0;
+    range_vec_t rv;
+    char* buf;
+
+    if( NULL == val ) // unset is OK
+        return 0;
+
+    rc = range_parse(val, &rv);
+    if( rc || (NULL == o) ) {
+        free(rv.ranges);
+        return rc;
+    }
+
+    // at most two 19-digit values, '-', and ',' per range
+    buf = (char*) malloc((rv.count * 41) + 1);
+    if( NULL == buf ) {
+        free(rv.ranges);
+        return ENOMEM;
+    }
+    buf[0] = '\0';
+    for( u=0; u < rv.count; u++ ) {
+        if( rv.ranges[u].lo == rv.ranges[u].hi )
+            len += (size_t) sprintf(buf + len, "%s%ld", (u ? "," : ""),
+                                    rv.ranges[u].lo);
+        else
+            len += (size_t) sprintf(buf + len, "%s%ld-%ld", (u ? "," : ""),
+                                    rv.ranges[u].lo, rv.ranges[u].hi);
+    }
+    free(rv.ranges);
+
+    if( 0 != strcmp(buf, val) )
+        *o = buf;
+    else
+        free(buf);
+    return 0;
+}
+
+int configurator_rangelist_bitmap(const configurator_rangelist_t* rl,
+                                  unsigned long* bits,
+                                  size_t nbits)
+{
+    unsigned u;
+    long v, hi;
+    const size_t wbits = 8 * sizeof(unsigned long);
+
+    if( NULL == bits )
+        return EINVAL;
+
+    memset((void*)bits, 0, ((nbits + wbits - 1) / wbits) * sizeof(unsigned long));
+    for( u=0; (NULL != rl) && (u < rl->count); u++ ) {
+        hi = rl->ranges[u].hi;
+        if( (size_t) hi >= nbits )
+            hi = (long) nbits - 1;
+        for( v = rl->ranges[u].lo; v <= hi; v++ )
+            bits[v / wbits] |= (1UL << (v % wbits));
+    }
+    if( (NULL != rl) && (rl->count > 0)
+        && ((size_t) rl->ranges[rl->count - 1].hi >= nbits) )
+        return ERANGE;
+    return 0;
+}
+
 int configurator_file_check(const char* s,
                             const char* k,
                             const char* val,
@@ -1089,13 +6965,7 @@ int configurator_file_check(const char* s,
         return 0;
 
     rc = stat(val, &st);
-    if( 0 == rc ) {
-        if( st.st_mode & S_IFREG )
-            return 0;
-        else
-            return ENOENT;
-    }
-    return errno; // invalid
+    return file_check_result((0 == rc) ? 0 : errno, st.st_mode);
 }
 
 int configurator_directory_check(const char* s,
@@ -1110,11 +6980,5 @@ int configurator_directory_check(const char* s,
         return 0;
 
     rc = stat(val, &st);
-    if( 0 == rc ) {
-        if( st.st_mode & S_IFDIR )
-            return 0;
-        else
-            return ENOTDIR;
-    }
-    return errno; // invalid
+    return directory_check_result((0 == rc) ? 0 : errno, st.st_mode);
 }
@@ -29,7 +29,7 @@
 
 // NOTE: NULLSTRING is a sentinel token meaning "no default string value"
 
-// for testing
+// for testing (testenum_enumerator.[ch] are generated from ../enumerator)
 #define PI 3.141592
 #define LOG_LEVEL 0
 #define TMP_PATH /tmp
@@ -37,10 +37,21 @@
 #define FLOAT_EXPR (2.0 * PI)
 
 /* PREFIX_CONFIGS is the list of configuration settings, and should contain
-   one macro definition per setting */
+   one macro definition per setting. Defining PREFIX_CONFIGS_HEADER as a
+   quoted file name substitutes the PREFIX_CONFIGS from that file (e.g., the
+   generated schemas used by bench.c). Any replacement must still include
+   prefix.configfile and prefix.profile, and may include prefix.configdir
+   and prefix.fragments to support config fragments. */
+#ifdef PREFIX_CONFIGS_HEADER
+# include PREFIX_CONFIGS_HEADER
+#else
+#include "testenum_enumerator.h"
 #define PREFIX_CONFIGS \
     PREFIX_CFG_CLI(prefix, configfile, STRING, /etc/prefix.conf, "path to configuration file", configurator_file_check, 'c', "specify full path to config file") \
+    PREFIX_CFG_CLI(prefix, configdir, STRING, NULLSTRING, "directory of config fragment files", configurator_directory_check, 'D', "specify full path to config fragment directory") \
+    PREFIX_CFG_MULTI(prefix, fragments, STRING, "config fragment files", configurator_file_check, 16) \
     PREFIX_CFG_CLI(prefix, debug, BOOL, off, "enable debug output", NULL, 'd', "on|off") \
+    PREFIX_CFG_CLI(prefix, profile, BOOL, off, "print config startup profile", NULL, 'P', "on|off") \
     PREFIX_CFG_CLI(log, verbosity, INT, LOG_LEVEL, "log verbosity level", NULL, 'v', "specify logging verbosity level") \
     PREFIX_CFG_CLI(log, file, STRING, prefix.log, "log file name", NULL, 'l', "specify log file name") \
     PREFIX_CFG_CLI(log, dir, STRING, TMP_PATH, "log file directory", configurator_directory_check, 'L', "specify full path to directory for placing log file") \
@@ -50,27 +61,228 @@
     PREFIX_CFG(test, pi, FLOAT, PI, "test float value", NULL) \
     PREFIX_CFG(test, exponent, FLOAT, 1.23e-4, "test float value with exponent notation", NULL) \
     PREFIX_CFG(test, floatexpr, FLOAT, FLOAT_EXPR, "test float expression", NULL) \
+    PREFIX_CFG(test, intref, INT, 0, "test int expression referencing other options", NULL) \
+    PREFIX_CFG(test, size, SIZE, 64KiB, "test size with unit suffix", NULL) \
+    PREFIX_CFG(test, timeout, DURATION, 1500ms, "test duration with unit suffix", NULL) \
+    PREFIX_CFG(test, cpus, RANGELIST, 0-3, "test cpu list expanded to ranges", NULL) \
+    PREFIX_CFG(test, errcode, ENUM, NYI, "test enumerated value", CONFIGURATOR_ENUM(testenum)) \
+    PREFIX_CFG_MULTI(test, multi, INT, "test multiple int values", NULL, 4) \
+    PREFIX_CFG_MULTI(test, dirs, STRING, "test multiple directory values", configurator_directory_check, 4) \
 
+#endif /* PREFIX_CONFIGS_HEADER */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+    /* generated option identifiers, in PREFIX_CONFIGS order */
+    typedef enum {
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) \
+        PREFIX_CFG_ID_##sec##_##key,
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use) \
+        PREFIX_CFG_ID_##sec##_##key,
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) \
+        PREFIX_CFG_ID_##sec##_##key,
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
+        PREFIX_CFG_ID_##sec##_##key,
+
+        PREFIX_CONFIGS
+
+#undef PREFIX_CFG
+#undef PREFIX_CFG_CLI
+#undef PREFIX_CFG_MULTI
+#undef PREFIX_CFG_MULTI_CLI
+        PREFIX_CFG_NUM_OPTIONS
+    } prefix_cfg_id_e;
+
+    /* expanded value of a RANGELIST option, e.g. "0-15,32-47": count
+       disjoint, non-adjacent ranges of non-negative values in increasing
+       order, holding total values (ranges are in the same allocation) */
+    typedef struct {
+        long lo;
+        long hi;    // inclusive
+    } configurator_range_t;
+
+    typedef struct {
+        const configurator_range_t* ranges;
+        unsigned count;
+        long total;
+    } configurator_rangelist_t;
+
+    /* typed storage for the converted value of a single-valued option */
+    typedef union {
+        bool   b;
+        long   i;
+        double f;
+        const configurator_rangelist_t* r;
+    } configurator_value_t;
+
+    /* option types, as named in PREFIX_CONFIGS */
+    typedef enum {
+        CONFIGURATOR_TYPE_BOOL = 0,
+        CONFIGURATOR_TYPE_INT,
+        CONFIGURATOR_TYPE_FLOAT,
+        CONFIGURATOR_TYPE_SIZE,
+        CONFIGURATOR_TYPE_DURATION,
+        CONFIGURATOR_TYPE_ENUM,
+        CONFIGURATOR_TYPE_STRING,
+        CONFIGURATOR_TYPE_RANGELIST,
+        CONFIGURATOR_NUM_TYPES
+    } configurator_type_e;
+
+    /* native C type returned by the typed getter of each option type */
+    typedef bool        configurator_BOOL_t;
+    typedef long        configurator_INT_t;
+    typedef double      configurator_FLOAT_t;
+    typedef long        configurator_SIZE_t;      // bytes
+    typedef long        configurator_DURATION_t;  // nanoseconds
+    typedef int         configurator_ENUM_t;      // enumerator value
+    typedef const char* configurator_STRING_t;
+    typedef const configurator_rangelist_t* configurator_RANGELIST_t; // NULL if unset
+
+    /* strings (and expanded RANGELIST values) replaced at runtime, freed at
+       a reader-quiescent point */
+    typedef struct configurator_retired {
+        struct configurator_retired* next;
+        char* str;
+    } configurator_retired_t;
+
+    /* values of a _MULTI option, kept inline until there are more than
+       CONFIGURATOR_MULTI_INLINE, then all kept in a growable heap array */
+#define CONFIGURATOR_MULTI_INLINE 4
+    typedef struct {
+        char* small[CONFIGURATOR_MULTI_INLINE];
+        char** heap;        // NULL while values fit in small
+        unsigned count;
+        unsigned cap;       // capacity of heap
+    } configurator_multi_t;
+
+    static inline char* const* configurator_multi_values(const configurator_multi_t* m)
+    {
+        return (NULL != m->heap) ? m->heap : m->small;
+    }
+
+    static inline const char* configurator_multi_get(const configurator_multi_t* m,
+                                                     unsigned n)
+    {
+        return (n < m->count) ? configurator_multi_values(m)[n] : NULL;
+    }
+
+    /* RANGELIST values, where a NULL rl (an unset option) is empty */
+
+    // number of values in rl
+    static inline long configurator_rangelist_count(const configurator_rangelist_t* rl)
+    {
+        return (NULL != rl) ? rl->total : 0;
+    }
+
+    // check if v is in rl (binary search of its ranges)
+    static inline bool configurator_rangelist_contains(const configurator_rangelist_t* rl,
+                                                       long v)
+    {
+        unsigned lo = 0, hi, mid;
+
+        if( NULL == rl )
+            return false;
+        hi = rl->count;
+        while( lo < hi ) {
+            mid = lo + ((hi - lo) / 2);
+            if( v < rl->ranges[mid].lo )
+                hi = mid;
+            else if( v > rl->ranges[mid].hi )
+                lo = mid + 1;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    /* advance *v to the next value of rl, returning false at the end, e.g.
+         unsigned i = 0; long cpu = -1;
+         while( configurator_rangelist_next(rl, &i, &cpu) ) ... */
+    static inline bool configurator_rangelist_next(const configurator_rangelist_t* rl,
+                                                   unsigned* i,
+                                                   long* v)
+    {
+        for( ; (NULL != rl) && (*i < rl->count); (*i)++ ) {
+            if( *v < rl->ranges[*i].lo ) {
+                *v = rl->ranges[*i].lo;
+                return true;
+            }
+            if( *v < rl->ranges[*i].hi ) {
+                (*v)++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* validation state of an option, see prefix_config_init_lazy() */
+#define CONFIGURATOR_RESOLVE_PENDING 0
+#define CONFIGURATOR_RESOLVE_ACTIVE  1
+#define CONFIGURATOR_RESOLVE_DONE    2
+#define CONFIGURATOR_RESOLVE_FAILED  3
+
+    /* startup profiling, see prefix_config_profile() */
+    typedef enum {
+        PREFIX_CFG_PHASE_DEFAULTS = 0,
+        PREFIX_CFG_PHASE_SYSFILE,
+        PREFIX_CFG_PHASE_ENVIRON,
+        PREFIX_CFG_PHASE_CLI,
+        PREFIX_CFG_PHASE_CLIFILE,
+        PREFIX_CFG_PHASE_FRAGMENTS,
+        PREFIX_CFG_PHASE_VALIDATE,
+        PREFIX_CFG_NUM_PHASES
+    } prefix_cfg_phase_e;
+
+    typedef enum {
+        CONFIGURATOR_VALIDATOR_BOOL = 0,
+        CONFIGURATOR_VALIDATOR_INT,
+        CONFIGURATOR_VALIDATOR_FLOAT,
+        CONFIGURATOR_VALIDATOR_UNIT,    // SIZE and DURATION
+        CONFIGURATOR_VALIDATOR_RANGELIST,
+        CONFIGURATOR_VALIDATOR_ENUM,
+        CONFIGURATOR_VALIDATOR_PATH,    // file and directory checks
+        CONFIGURATOR_VALIDATOR_CUSTOM,
+        CONFIGURATOR_NUM_VALIDATORS
+    } configurator_validator_e;
+
+    typedef struct {
+        unsigned long long nsecs;   // wall time
+        unsigned long keys;         // values set (or checked, for validation)
+        unsigned long allocs;       // heap allocations for values
+        unsigned long long bytes;   // bytes allocated for values
+    } configurator_stats_t;
+
+    typedef struct {
+        char* file;
+        configurator_stats_t stats;
+    } configurator_file_stats_t;
+
+    typedef struct {
+        configurator_stats_t phase[PREFIX_CFG_NUM_PHASES];
+        configurator_stats_t validator[CONFIGURATOR_NUM_VALIDATORS];
+        configurator_file_stats_t* files;
+        unsigned num_files;
+
+        prefix_cfg_phase_e current;  // phase being recorded
+    } prefix_cfg_profile_t;
+
     /* prefix_cfg_t struct */
     typedef struct {
 #define PREFIX_CFG(sec, key, typ, dv, desc, vfn) \
-        char* sec##_##key;
+        char* sec##_##key; \
+        configurator_value_t sec##_##key##_val;
 
 #define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use) \
-        char* sec##_##key;
+        char* sec##_##key; \
+        configurator_value_t sec##_##key##_val;
 
-#define PREFIX_CFG_MULTI(sec, key, typ, dv, desc, vfn, me) \
-        char* sec##_##key[me]; \
-        unsigned n_##sec##_##key;
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) \
+        configurator_multi_t sec##_##key;
 
-#define PREFIX_CFG_MULTI_CLI(sec, key, typ, dv, desc, vfn, me, opt, use) \
-        char* sec##_##key[me]; \
-        unsigned n_##sec##_##key;
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
+        configurator_multi_t sec##_##key;
         
         PREFIX_CONFIGS
 
@@ -78,6 +290,32 @@ extern "C" {
 #undef PREFIX_CFG_CLI
 #undef PREFIX_CFG_MULTI
 #undef PREFIX_CFG_MULTI_CLI
+
+        /* runtime update state (see prefix_config_set_<section>_<key>) */
+        unsigned char _lock;
+        configurator_retired_t* _retired;
+
+        /* mapped snapshot that option strings may point into */
+        char* _map;
+        size_t _map_len;
+
+        /* startup profile (NULL unless profiling was enabled) */
+        prefix_cfg_profile_t* _profile;
+
+        /* per-option resolution state, see CONFIGURATOR_RESOLVE_xxx
+           (NULL unless initialized lazily) */
+        unsigned char* _lazy;
+
+        /* origin of each option's current value, and of the config file
+           values being processed, see prefix_config_origin() */
+        unsigned char _origin[PREFIX_CFG_NUM_OPTIONS + 1];
+        unsigned char _loading;
+
+        /* change subscriptions, see prefix_config_subscribe() */
+        struct configurator_sub* _subs;
+
+        /* admin socket, see prefix_config_admin_start() */
+        struct configurator_admin* _admin;
     } prefix_cfg_t;
 
     /* initialization and cleanup */
@@ -87,8 +325,153 @@ extern "C" {
                            char** argv);
 
     int prefix_config_fini(prefix_cfg_t* cfg);
+
+    /* initialize without validation. Each option is instead validated and
+       converted on first access (through its getter, or explicitly with
+       prefix_config_resolve()), and the result is kept for later reads.
+       Call prefix_config_validate() to check all remaining options up front,
+       e.g. for daemons that should fail fast. */
+    int prefix_config_init_lazy(prefix_cfg_t* cfg,
+                                int argc,
+                                char** argv);
+
+    /* initialize a batch of configs (e.g., one per tenant) on a pool of up
+       to nthreads threads (PREFIX_CFG_INIT_THREADS if zero), including the
+       caller. Each inits[n].cfg is initialized by prefix_config_init() from
+       its own argc and argv, with the result in inits[n].rc. Returns 0, or
+       the first failure in batch order. Initialization, validation, and
+       cleanup are reentrant, so configs may also be initialized by the
+       application's own threads, provided the environment is not changed
+       meanwhile. */
+#define PREFIX_CFG_INIT_THREADS 8
+
+    typedef struct {
+        prefix_cfg_t* cfg;
+        int argc;
+        char** argv;
+        int rc;
+    } prefix_cfg_init_t;
+
+    int prefix_config_init_batch(prefix_cfg_init_t* inits,
+                                 unsigned count,
+                                 unsigned nthreads);
+
+    /* validate and convert a single option of a lazily initialized config
+       (along with any options it references), if not already done. Returns
+       0 or the validation error. A no-op for non-lazy configs. */
+    int prefix_config_resolve(prefix_cfg_t* cfg,
+                              int id);
+
+    /* initialize from a binary snapshot in cache_dir when the schema,
+       PREFIX_* environment, arguments, working directory, and config files
+       are all unchanged since the snapshot was saved. Otherwise, performs
+       prefix_config_init() and saves a new snapshot for later runs. */
+    int prefix_config_init_cached(prefix_cfg_t* cfg,
+                                  int argc,
+                                  char** argv,
+                                  const char* cache_dir);
+
+    /* share a resolved config among processes on a node. The parent calls
+       prefix_config_publish() after initializing, which (re)creates the
+       read-only POSIX shared-memory object name (e.g., "/myapp-config").
+       Workers then call prefix_config_attach() in place of initializing,
+       which maps the object without parsing anything, so all workers share
+       one copy of the config pages. Attaching fails (and workers should
+       fall back to prefix_config_init()) if nothing is published, or if it
+       was published by a program with a different schema. */
+    int prefix_config_publish(prefix_cfg_t* cfg,
+                              const char* name);
+
+    int prefix_config_attach(prefix_cfg_t* cfg,
+                             const char* name);
+
+    int prefix_config_unpublish(const char* name);
+
+    /* collective initialization for large process groups
+
+       With prefix_config_init_collective(), only the leader of the group
+       reads config files and validates. It broadcasts the resolved config
+       (in snapshot format) through the given transport, and followers
+       build their config from it. A follower whose PREFIX_* environment or
+       arguments differ from the leader's then applies its own values on
+       top, validating just the options they change. A follower naming its
+       own config file, config directory, or fragments instead initializes
+       locally, reading those files. If the leader fails to initialize, all
+       followers return its error.
+
+       The transport broadcasts len bytes of buf from the leader, with
+       followers receiving into buf, e.g. using MPI_Bcast() from rank 0.
+       prefix_config_transport_local() provides one over a Unix-domain
+       socket at path, among processes on the same node. */
+    typedef struct {
+        bool leader;
+        void* ctx;
+        int (*bcast)(void* ctx, void* buf, size_t len);
+    } prefix_cfg_transport_t;
+
+    int prefix_config_init_collective(prefix_cfg_t* cfg,
+                                      int argc,
+                                      char** argv,
+                                      prefix_cfg_transport_t* tp);
+
+    int prefix_config_transport_local(prefix_cfg_transport_t* tp,
+                                      const char* path,
+                                      bool leader,
+                                      unsigned nfollowers);
+
+    void prefix_config_transport_local_fini(prefix_cfg_transport_t* tp);
+
+    /* admin socket
+
+       prefix_config_admin_start() starts a background thread that serves
+       requests for cfg on a Unix-domain socket at path (accessible only to
+       the same user), one text line per request:
+         get <section>.<key>        - current value (_MULTI values one per line)
+         set <section>.<key> <val>  - runtime update, as the typed setter
+         origin <section>.<key>     - where the value came from, as
+                                      prefix_config_origin_name()
+         list [<section>]           - option names, types, and descriptions
+         dump [text|ini|json|env]   - all set options, as prefix_config_export()
+       Each reply is either "OK <length>" followed by that many bytes, or
+       "ERR <errno> <message>", on a line of its own.
+
+       Clients are served one at a time, and at most rate requests per
+       second (PREFIX_CFG_ADMIN_RATE if zero) are handled. Requests use the
+       getters and setters, so they take no lock that readers wait on.
+       prefix_config_admin_query() sends a single request, returning 0 with
+       the reply payload, or the remote error with its message, in *reply
+       (which the caller frees). prefix_config_fini() stops the thread. */
+#define PREFIX_CFG_ADMIN_RATE 100
+
+    int prefix_config_admin_start(prefix_cfg_t* cfg,
+                                  const char* path,
+                                  unsigned rate);
+
+    int prefix_config_admin_stop(prefix_cfg_t* cfg);
+
+    int prefix_config_admin_query(const char* path,
+                                  const char* request,
+                                  char** reply,
+                                  size_t* len);
                                    
 
+    /* startup profiling
+
+       When enabled, prefix_config_init() records wall time, values set, and
+       allocations for each phase, as well as parse time for each config file
+       and time spent in each kind of validator. Profiling is enabled for all
+       later initializations by prefix_config_profiling(true), or for one
+       by setting prefix.profile (i.e., --prefix-profile or PREFIX_PROFILE),
+       which also prints the profile to stderr once initialization is done.
+
+       prefix_config_profile() returns NULL when cfg was not profiled. */
+    void prefix_config_profiling(bool enable);
+
+    const prefix_cfg_profile_t* prefix_config_profile(const prefix_cfg_t* cfg);
+
+    void prefix_config_profile_print(const prefix_cfg_t* cfg,
+                                     FILE* fp);
+
     /* print configuration to specified file (or stderr if fp==NULL) */
     void prefix_config_print(prefix_cfg_t* cfg,
                              FILE* fp);
@@ -97,6 +480,48 @@ extern "C" {
     void prefix_config_print_ini(prefix_cfg_t* cfg,
                                  FILE* inifp);
 
+    /* bulk export
+
+       Renders every set option in one pass, in schema order (with the
+       options of each section grouped at its first option):
+         TEXT - as prefix_config_print()
+         INI  - as prefix_config_print_ini(), _MULTI values as repeated keys
+         JSON - an object per section, with BOOL, INT, FLOAT, SIZE, and
+                DURATION values as JSON literals, and _MULTI values as arrays
+         ENV  - PREFIX_* assignments (_MULTI entries numbered from 1), with
+                values single-quoted for the shell
+       INI and JSON output can be read back as config files. INI has no
+       quoting, so values are written as-is, and values containing a line
+       break are reported as EINVAL (the rest is still rendered).
+
+       prefix_config_export() renders into buf, whose size is given in
+       *len, and sets *len to the length of the full rendering (excluding
+       its terminating NUL). It returns ERANGE, with the output truncated,
+       when buf is too small; call it with a NULL buf to query the size.
+       prefix_config_export_alloc() renders into a buffer grown as needed,
+       which the caller frees. prefix_config_export_fd() writes the
+       rendering to fd with a single write(). */
+    typedef enum {
+        PREFIX_CFG_FORMAT_TEXT = 0,
+        PREFIX_CFG_FORMAT_INI,
+        PREFIX_CFG_FORMAT_JSON,
+        PREFIX_CFG_FORMAT_ENV
+    } prefix_cfg_format_e;
+
+    int prefix_config_export(const prefix_cfg_t* cfg,
+                             prefix_cfg_format_e fmt,
+                             char* buf,
+                             size_t* len);
+
+    int prefix_config_export_alloc(const prefix_cfg_t* cfg,
+                                   prefix_cfg_format_e fmt,
+                                   char** buf,
+                                   size_t* len);
+
+    int prefix_config_export_fd(const prefix_cfg_t* cfg,
+                                prefix_cfg_format_e fmt,
+                                int fd);
+
     /* used internally, but may be useful externally */
 
     int prefix_config_set_defaults(prefix_cfg_t* cfg);
@@ -111,11 +536,138 @@ extern "C" {
 
     int prefix_config_process_environ(prefix_cfg_t* cfg);
 
+    // values have the SYSFILE origin, other than for the CLI config file
     int prefix_config_process_file(prefix_cfg_t* cfg,
                                    const char* file);
 
+    /* parse the files in prefix.configdir and prefix.fragments (when in
+       the schema) concurrently, then merge them in order */
+    int prefix_config_process_fragments(prefix_cfg_t* cfg);
+
     int prefix_config_validate(prefix_cfg_t* cfg);
 
+    /* runtime access to individual options
+
+       prefix_config_get_<section>_<key>(cfg) returns the validated value as
+       its native type (bool, long, double, or const char*; SIZE and
+       DURATION options are long bytes and nanoseconds, and ENUM options
+       are the int enumerator value) using a single
+       plain load, and is safe to call from any number of reader threads.
+       For _MULTI options, it returns the (validated) configurator_multi_t.
+       With lazy initialization, the first access validates the option.
+
+       prefix_config_set_<section>_<key>(cfg, val) validates and converts
+       the given string, then atomically publishes the new value.
+       Replaced strings are retired rather than freed, since readers may
+       still hold them; call prefix_config_reclaim() once no reader can
+       reference an old string (freed by prefix_config_fini() otherwise). */
+
+#define CONFIGURATOR_LOAD_BOOL(str, val) \
+    __atomic_load_n(&(val).b, __ATOMIC_RELAXED)
+#define CONFIGURATOR_LOAD_INT(str, val) \
+    __atomic_load_n(&(val).i, __ATOMIC_RELAXED)
+#define CONFIGURATOR_LOAD_FLOAT(str, val) \
+    configurator_load_float(&(val).f)
+#define CONFIGURATOR_LOAD_SIZE(str, val) \
+    __atomic_load_n(&(val).i, __ATOMIC_RELAXED)
+#define CONFIGURATOR_LOAD_DURATION(str, val) \
+    __atomic_load_n(&(val).i, __ATOMIC_RELAXED)
+#define CONFIGURATOR_LOAD_ENUM(str, val) \
+    ((int) __atomic_load_n(&(val).i, __ATOMIC_RELAXED))
+#define CONFIGURATOR_LOAD_STRING(str, val) \
+    __atomic_load_n(&(str), __ATOMIC_ACQUIRE)
+#define CONFIGURATOR_LOAD_RANGELIST(str, val) \
+    __atomic_load_n(&(val).r, __ATOMIC_ACQUIRE)
+
+    static inline double configurator_load_float(const double* d)
+    {
+        double ret;
+        __atomic_load(d, &ret, __ATOMIC_RELAXED);
+        return ret;
+    }
+
+    // resolve an option on first access when lazily initialized
+    static inline void configurator_lazy_check(const prefix_cfg_t* cfg,
+                                               int id)
+    {
+        if( (NULL != cfg->_lazy)
+            && (CONFIGURATOR_RESOLVE_DONE >
+                __atomic_load_n(&(cfg->_lazy[id]), __ATOMIC_ACQUIRE)) )
+            prefix_config_resolve((prefix_cfg_t*) cfg, id);
+    }
+
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn) \
+    static inline configurator_##typ##_t \
+    prefix_config_get_##sec##_##key(const prefix_cfg_t* cfg) \
+    { \
+        configurator_lazy_check(cfg, PREFIX_CFG_ID_##sec##_##key); \
+        return CONFIGURATOR_LOAD_##typ(cfg->sec##_##key, cfg->sec##_##key##_val); \
+    } \
+    int prefix_config_set_##sec##_##key(prefix_cfg_t* cfg, const char* val);
+
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use) \
+    PREFIX_CFG(sec, key, typ, dv, desc, vfn)
+
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me) \
+    static inline const configurator_multi_t* \
+    prefix_config_get_##sec##_##key(const prefix_cfg_t* cfg) \
+    { \
+        configurator_lazy_check(cfg, PREFIX_CFG_ID_##sec##_##key); \
+        return &(cfg->sec##_##key); \
+    }
+
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use) \
+    PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)
+
+    PREFIX_CONFIGS
+
+#undef PREFIX_CFG
+#undef PREFIX_CFG_CLI
+#undef PREFIX_CFG_MULTI
+#undef PREFIX_CFG_MULTI_CLI
+
+    /* free strings retired by runtime updates */
+    void prefix_config_reclaim(prefix_cfg_t* cfg);
+
+    /* configuration changes
+
+       prefix_config_diff() compares every option of two configs, storing
+       the ids of those that differ in changed (which must have room for
+       PREFIX_CFG_NUM_OPTIONS ids) and returning their count. Typed options
+       compare their converted values, so e.g. "0x10" and "16" are equal.
+
+       A subscriber is called after each runtime update of its option with
+       the old and new value strings (the old one stays valid until
+       prefix_config_reclaim()). Subscribers run on the updating thread,
+       outside any configurator lock, so they may use getters and setters.
+       prefix_config_apply() updates cfg to match from, so subscribers of
+       each changed single-valued option fire (_MULTI options are reported
+       by prefix_config_diff(), but have no runtime updates). Options
+       updated at runtime are kept, since a reload (a fresh config) cannot
+       have a value of that precedence. */
+    typedef void (*prefix_cfg_subscriber_fn)(prefix_cfg_t* cfg,
+                                             int id,
+                                             const char* old_val,
+                                             const char* new_val,
+                                             void* arg);
+
+    unsigned prefix_config_diff(const prefix_cfg_t* a,
+                                const prefix_cfg_t* b,
+                                int* changed);
+
+    int prefix_config_subscribe(prefix_cfg_t* cfg,
+                                int id,
+                                prefix_cfg_subscriber_fn fn,
+                                void* arg);
+
+    int prefix_config_unsubscribe(prefix_cfg_t* cfg,
+                                  int id,
+                                  prefix_cfg_subscriber_fn fn,
+                                  void* arg);
+
+    int prefix_config_apply(prefix_cfg_t* cfg,
+                            const prefix_cfg_t* from);
+
     /* validate function prototype
        -  Returns: 0 for valid input, non-zero otherwise.
        -  out_val: optionally provide an alternate value
@@ -125,6 +677,153 @@ extern "C" {
                                             const char* val,
                                             char** out_val);
 
+    /* enum lookup function prototype (see CONFIGURATOR_ENUM below)
+       -  Returns: the name of item *e, or NULL if *e is not an item
+       -  name: if non-NULL, first sets *e to the item with that name */
+    typedef const char* (*configurator_enum_fn)(const char* name,
+                                                int* e);
+
+    /* option descriptors
+
+       prefix_cfg_options[id] describes each option, in PREFIX_CONFIGS
+       order. Single-valued options are stored in prefix_cfg_t as a char*
+       at offset and a configurator_value_t at val_offset, and _MULTI
+       options as a configurator_multi_t at offset. The default is the
+       schema default string (NULL for _MULTI options), and cli_opt is 0
+       for options without a CLI flag. ENUM options have a NULL validate,
+       and their type's lookup function as enum_lookup.
+
+       prefix_config_lookup() returns the descriptor of an option by
+       section and key (NULL if unknown), using a hash table built on first
+       use; its id is the descriptor's index in prefix_cfg_options. */
+    typedef struct {
+        const char* section;
+        const char* key;
+        configurator_type_e type;
+        bool multi;
+        const char* default_value;
+        const char* desc;
+        configurator_validate_fn validate;
+        configurator_enum_fn enum_lookup;   // ENUM options only
+        size_t offset;
+        size_t val_offset;
+        int cli_opt;
+        const char* cli_name;       // "<section>-<key>"
+        const char* cli_use;
+        unsigned max_entries;       // _MULTI options only
+    } prefix_cfg_option_t;
+
+    extern const prefix_cfg_option_t prefix_cfg_options[];
+
+    const prefix_cfg_option_t* prefix_config_lookup(const char* section,
+                                                    const char* key);
+
+    /* where the current value of an option came from, in increasing order
+       of precedence: a value is only replaced by one from an origin at
+       least as high (so, e.g., a later config file line overrides an
+       earlier one, but not a CLI argument). Values of registered sources
+       have the origin of their slot (FALLBACK for PREFIX_CFG_SOURCE_FALLBACK),
+       those set by prefix_config_set_<section>_<key>() are RUNTIME, and
+       those set by prefix_config_apply() keep their origin in the applied
+       config. _MULTI options, whose values are appended from every origin,
+       report the highest. */
+    typedef enum {
+        PREFIX_CFG_ORIGIN_UNSET = 0,
+        PREFIX_CFG_ORIGIN_DEFAULT,
+        PREFIX_CFG_ORIGIN_FALLBACK,
+        PREFIX_CFG_ORIGIN_FRAGMENT,
+        PREFIX_CFG_ORIGIN_SYSFILE,
+        PREFIX_CFG_ORIGIN_ENVIRON,
+        PREFIX_CFG_ORIGIN_CLIFILE,
+        PREFIX_CFG_ORIGIN_CLI,
+        PREFIX_CFG_ORIGIN_RUNTIME,
+        PREFIX_CFG_NUM_ORIGINS
+    } prefix_cfg_origin_e;
+
+    prefix_cfg_origin_e prefix_config_origin(const prefix_cfg_t* cfg,
+                                             int id);
+
+    // name of an origin, e.g. "environment" (NULL when invalid)
+    const char* prefix_config_origin_name(prefix_cfg_origin_e origin);
+
+    /* configuration sources
+
+       A source provider supplies values from outside the built-in sources
+       (defaults, config files, environment, and command line), e.g. a
+       key-value service. Each registered source is fetched once per
+       initialization, with a single call given the descriptors of every
+       option in the schema, which passes each value it has to put (as
+       section, key, and value strings; put returns zero on failure, as
+       for an inih handler). Fetches run concurrently with the rest of
+       initialization, and their values are merged at the source's slot:
+         FALLBACK - after all other sources, setting only options still at
+                    their default values (like config files)
+         SYSFILE  - after the system config file, overriding it
+         ENVIRON  - after the environment, overriding it
+         CLI      - after the command line, overriding everything
+       Sources in the same slot are merged in order of registration.
+       Their values are validated along with all others.
+
+       A fetch that does not return within timeout_ms (if nonzero) is
+       abandoned, and fails with ETIMEDOUT; it should honor timeout_ms
+       itself, since it keeps running on a detached thread, possibly after
+       prefix_config_fini(), and its ctx must stay valid until it returns.
+       A failed source fails initialization if required, and is otherwise
+       reported and skipped.
+
+       The registry is locked, and each initialization fetches the sources
+       registered when it starts, so sources should be registered (e.g., at
+       startup) before the initializations that use them; adding or
+       removing one only affects later initializations. A registered source
+       (and its name and ctx) must stay valid until it is removed, and any
+       abandoned fetch of it has returned. Configs initialized with
+       prefix_config_init_cached() are not cached while sources are
+       registered. */
+#define PREFIX_CFG_MAX_SOURCES 8
+
+    typedef enum {
+        PREFIX_CFG_SOURCE_FALLBACK = 0,
+        PREFIX_CFG_SOURCE_SYSFILE,
+        PREFIX_CFG_SOURCE_ENVIRON,
+        PREFIX_CFG_SOURCE_CLI
+    } prefix_cfg_source_slot_e;
+
+    typedef int (*prefix_cfg_put_fn)(void* user,
+                                     const char* section,
+                                     const char* key,
+                                     const char* val);
+
+    typedef int (*prefix_cfg_fetch_fn)(void* ctx,
+                                       const prefix_cfg_option_t* options,
+                                       unsigned count,
+                                       unsigned timeout_ms,
+                                       prefix_cfg_put_fn put,
+                                       void* user);
+
+    typedef struct {
+        const char* name;
+        prefix_cfg_source_slot_e slot;
+        unsigned timeout_ms;        // zero for no timeout
+        bool required;
+        void* ctx;
+        prefix_cfg_fetch_fn fetch;
+    } prefix_cfg_source_t;
+
+    int prefix_config_add_source(const prefix_cfg_source_t* src);
+
+    int prefix_config_remove_source(const char* name);
+
+    /* local source, reading "<section>.<key> = <value>" lines from the file
+       at path (blank lines and those starting with '#' are ignored, and
+       repeated keys give _MULTI values), e.g. as an offline stand-in for a
+       key-value service. Only the requested options are put, and reading
+       stops with ETIMEDOUT once timeout_ms has passed. */
+    int prefix_config_source_file(prefix_cfg_source_t* src,
+                                  const char* path,
+                                  prefix_cfg_source_slot_e slot);
+
+    void prefix_config_source_file_fini(prefix_cfg_source_t* src);
+
     /* predefined validation functions */
     int configurator_bool_val(const char* val,
                               bool* b);
@@ -147,6 +846,56 @@ extern "C" {
                                const char* val,
                                char** oval);
 
+    /* SIZE values are bytes, with an optional K/M/G/T (powers of 1000) or
+       Ki/Mi/Gi/Ti (powers of 1024) suffix, e.g. 4KiB. DURATION values are
+       nanoseconds, with an optional ns/us/ms/s/min/h suffix, e.g. 250ms. */
+    int configurator_size_val(const char* val,
+                              long* l);
+    int configurator_size_check(const char* section,
+                                const char* key,
+                                const char* val,
+                                char** oval);
+
+    int configurator_duration_val(const char* val,
+                                  long* l);
+    int configurator_duration_check(const char* section,
+                                    const char* key,
+                                    const char* val,
+                                    char** oval);
+
+    /* ENUM options take the name of an item of an enumerator-generated
+       type, given by CONFIGURATOR_ENUM(<enumerator prefix>) in place of a
+       validate function, and store its value. The name is looked up once
+       during validation, using the type's <prefix>_enum_lookup(). */
+#define CONFIGURATOR_ENUM(eprefix) eprefix##_enum_lookup
+
+    int configurator_enum_val(configurator_enum_fn lookup,
+                              const char* val,
+                              int* e);
+    int configurator_enum_check(configurator_enum_fn lookup,
+                                const char* section,
+                                const char* key,
+                                const char* val);
+
+    /* RANGELIST values are comma-separated items, each a value, a range
+       lo-hi, or a strided range lo-hi:stride (as in Linux cpu lists), e.g.
+       0-15,32-47 or 0-31:2. The value is expanded once during validation,
+       and printed configs see its canonical form (sorted, merged ranges). */
+#define CONFIGURATOR_RANGELIST_MAX_RANGES 65536
+    int configurator_rangelist_val(const char* val,
+                                   configurator_rangelist_t** rl);
+    int configurator_rangelist_check(const char* section,
+                                     const char* key,
+                                     const char* val,
+                                     char** oval);
+
+    /* set the bits of the values of rl below nbits in the bitmap bits
+       (clearing all others), e.g. a cpu_set_t and CPU_SETSIZE, returning
+       ERANGE if some values do not fit */
+    int configurator_rangelist_bitmap(const configurator_rangelist_t* rl,
+                                      unsigned long* bits,
+                                      size_t nbits);
+
     int configurator_file_check(const char* section,
                                 const char* key,
                                 const char* val,
@@ -0,0 +1,304 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  Configurator is part of https://github.com/MichaelBrim/tedium
+ *
+ *  MIT License - See https://github.com/MichaelBrim/tedium/blob/master/LICENSE
+ */
+
+#ifndef _PREFIX_CONFIGURATOR_HPP_
+#define _PREFIX_CONFIGURATOR_HPP_
+
+/* C++ interface to configurator, generated from PREFIX_CONFIGS.
+
+   Each option has a tag type prefix::<section>::<key>, e.g.
+
+     prefix::config cfg(argc, argv);   // throws std::system_error on failure
+     long v = cfg.get<prefix::log::verbosity>();
+
+   get<T>() returns the validated value in its native type (bool, long,
+   double, or a string type; long bytes or nanoseconds for SIZE and
+   DURATION), loaded directly from the underlying
+   prefix_cfg_t. Each tag also provides its schema default as a constexpr
+   value via T::default_value(), computed by the compiler from the default
+   given in PREFIX_CONFIGS (INT and FLOAT defaults must therefore be valid
+   C++ constant expressions, and SIZE and DURATION defaults must be
+   integers with an optional unit suffix). ENUM options are int values,
+   and their T::default_value() is the default item name. RANGELIST
+   options are the expanded configurator_rangelist_t (see the
+   configurator_rangelist_*() helpers), and their T::default_value() is
+   the default string.
+
+   See README.md for instructions on usage.
+*/
+
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+#if __cplusplus >= 201703L
+# include <string_view>
+#endif
+
+// CONFIGURATOR USAGE NOTE: update following to actual .h file name/location
+#include "configurator.h"
+
+namespace prefix {
+
+#if __cplusplus >= 201703L
+    typedef std::string_view string_type;
+#else
+    typedef const char* string_type;
+#endif
+
+    /* values of a MULTI option */
+    class multi_view {
+    public:
+        typedef const char* const* iterator;
+
+        multi_view(const char* const* values, unsigned count)
+            : values_(values), count_(count) {}
+
+        std::size_t size() const { return count_; }
+        bool empty() const { return 0 == count_; }
+        const char* operator[](std::size_t n) const { return values_[n]; }
+        iterator begin() const { return values_; }
+        iterator end() const { return values_ + count_; }
+
+    private:
+        const char* const* values_;
+        unsigned count_;
+    };
+
+    namespace detail {
+
+        constexpr bool str_eq(const char* a, const char* b)
+        {
+            return (*a == *b) && ((*a == '\0') || str_eq(a + 1, b + 1));
+        }
+
+        // same spellings as configurator_bool_val()
+        constexpr bool bool_value(const char* s)
+        {
+            return str_eq(s, "1") || str_eq(s, "t") || str_eq(s, "T")
+                || str_eq(s, "y") || str_eq(s, "Y") || str_eq(s, "yes")
+                || str_eq(s, "on") || str_eq(s, "true");
+        }
+
+        constexpr string_type string_value(const char* s)
+        {
+            return str_eq(s, "NULLSTRING") ? string_type() : string_type(s);
+        }
+
+        constexpr bool is_digit(char c)
+        {
+            return (c >= '0') && (c <= '9');
+        }
+
+        constexpr const char* skip_number(const char* s)
+        {
+            return (is_digit(*s) || (*s == ' ')) ? skip_number(s + 1) : s;
+        }
+
+        constexpr long number_value(const char* s, long acc)
+        {
+            return is_digit(*s) ? number_value(s + 1, (acc * 10) + (*s - '0'))
+                 : (*s == ' ') ? number_value(s + 1, acc) : acc;
+        }
+
+        // same suffixes as configurator_size_val()
+        constexpr long size_scale(const char* u)
+        {
+            return (str_eq(u, "") || str_eq(u, "B")) ? 1L
+                 : (str_eq(u, "K") || str_eq(u, "KB") || str_eq(u, "k") || str_eq(u, "kB")) ? 1000L
+                 : (str_eq(u, "M") || str_eq(u, "MB")) ? 1000000L
+                 : (str_eq(u, "G") || str_eq(u, "GB")) ? 1000000000L
+                 : (str_eq(u, "T") || str_eq(u, "TB")) ? 1000000000000L
+                 : (str_eq(u, "Ki") || str_eq(u, "KiB")) ? (1L << 10)
+                 : (str_eq(u, "Mi") || str_eq(u, "MiB")) ? (1L << 20)
+                 : (str_eq(u, "Gi") || str_eq(u, "GiB")) ? (1L << 30)
+                 : (str_eq(u, "Ti") || str_eq(u, "TiB")) ? (1L << 40)
+                 : throw "invalid SIZE suffix";
+        }
+
+        // same suffixes as configurator_duration_val()
+        constexpr long duration_scale(const char* u)
+        {
+            return (str_eq(u, "") || str_eq(u, "ns")) ? 1L
+                 : str_eq(u, "us") ? 1000L
+                 : str_eq(u, "ms") ? 1000000L
+                 : str_eq(u, "s") ? 1000000000L
+                 : str_eq(u, "min") ? 60000000000L
+                 : str_eq(u, "h") ? 3600000000000L
+                 : throw "invalid DURATION suffix";
+        }
+
+        inline string_type to_string(const char* s)
+        {
+            return (nullptr == s) ? string_type() : string_type(s);
+        }
+
+    } // namespace detail
+
+} // namespace prefix
+
+#define PREFIX_CPP_STR_(x) #x
+#define PREFIX_CPP_STR(x) PREFIX_CPP_STR_(x)
+
+// native C++ type, constexpr default, and conversion of the C getter result
+#define PREFIX_CPP_TYPE_BOOL   bool
+#define PREFIX_CPP_TYPE_INT    long
+#define PREFIX_CPP_TYPE_FLOAT  double
+#define PREFIX_CPP_TYPE_SIZE   long
+#define PREFIX_CPP_TYPE_DURATION long
+#define PREFIX_CPP_TYPE_ENUM   int
+#define PREFIX_CPP_TYPE_STRING ::prefix::string_type
+#define PREFIX_CPP_TYPE_RANGELIST const configurator_rangelist_t*
+
+#define PREFIX_CPP_DEFAULT_BOOL(dv)   ::prefix::detail::bool_value(PREFIX_CPP_STR(dv))
+#define PREFIX_CPP_DEFAULT_INT(dv)    static_cast<long>(dv)
+#define PREFIX_CPP_DEFAULT_FLOAT(dv)  static_cast<double>(dv)
+#define PREFIX_CPP_DEFAULT_SIZE(dv)                                     \
+    (::prefix::detail::number_value(PREFIX_CPP_STR(dv), 0)              \
+     * ::prefix::detail::size_scale(::prefix::detail::skip_number(PREFIX_CPP_STR(dv))))
+#define PREFIX_CPP_DEFAULT_DURATION(dv)                                 \
+    (::prefix::detail::number_value(PREFIX_CPP_STR(dv), 0)              \
+     * ::prefix::detail::duration_scale(::prefix::detail::skip_number(PREFIX_CPP_STR(dv))))
+#define PREFIX_CPP_DEFAULT_ENUM(dv)   PREFIX_CPP_STR(dv)
+#define PREFIX_CPP_DEFAULT_STRING(dv) ::prefix::detail::string_value(PREFIX_CPP_STR(dv))
+#define PREFIX_CPP_DEFAULT_RANGELIST(dv) PREFIX_CPP_STR(dv)
+
+// type of T::default_value(), the item name for ENUM options and the
+// string for RANGELIST options
+#define PREFIX_CPP_DEFAULT_TYPE_BOOL     bool
+#define PREFIX_CPP_DEFAULT_TYPE_INT      long
+#define PREFIX_CPP_DEFAULT_TYPE_FLOAT    double
+#define PREFIX_CPP_DEFAULT_TYPE_SIZE     long
+#define PREFIX_CPP_DEFAULT_TYPE_DURATION long
+#define PREFIX_CPP_DEFAULT_TYPE_ENUM     const char*
+#define PREFIX_CPP_DEFAULT_TYPE_STRING   ::prefix::string_type
+#define PREFIX_CPP_DEFAULT_TYPE_RANGELIST const char*
+
+#define PREFIX_CPP_VALUE_BOOL(v)   (v)
+#define PREFIX_CPP_VALUE_INT(v)    (v)
+#define PREFIX_CPP_VALUE_FLOAT(v)  (v)
+#define PREFIX_CPP_VALUE_SIZE(v)   (v)
+#define PREFIX_CPP_VALUE_DURATION(v) (v)
+#define PREFIX_CPP_VALUE_ENUM(v)   (v)
+#define PREFIX_CPP_VALUE_STRING(v) ::prefix::detail::to_string(v)
+#define PREFIX_CPP_VALUE_RANGELIST(v) (v)
+
+/* option tag types */
+#define PREFIX_CFG(sec, key, typ, dv, desc, vfn)                         \
+    namespace prefix { namespace sec {                                  \
+        struct key {                                                    \
+            typedef PREFIX_CPP_TYPE_##typ type;                         \
+            static constexpr prefix_cfg_id_e id = PREFIX_CFG_ID_##sec##_##key; \
+            static constexpr const char* section() { return #sec; }     \
+            static constexpr const char* name() { return #key; }        \
+            static constexpr PREFIX_CPP_DEFAULT_TYPE_##typ default_value() \
+            { return PREFIX_CPP_DEFAULT_##typ(dv); }                    \
+            static type load(const prefix_cfg_t* cfg)                   \
+            { return PREFIX_CPP_VALUE_##typ(prefix_config_get_##sec##_##key(cfg)); } \
+            static int store(prefix_cfg_t* cfg, const char* val)        \
+            { return prefix_config_set_##sec##_##key(cfg, val); }       \
+        };                                                              \
+    } }
+
+#define PREFIX_CFG_CLI(sec, key, typ, dv, desc, vfn, opt, use)  \
+    PREFIX_CFG(sec, key, typ, dv, desc, vfn)
+
+#define PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)                  \
+    namespace prefix { namespace sec {                                  \
+        struct key {                                                    \
+            typedef ::prefix::multi_view type;                          \
+            static constexpr prefix_cfg_id_e id = PREFIX_CFG_ID_##sec##_##key; \
+            static constexpr unsigned max_entries = me;                 \
+            static constexpr const char* section() { return #sec; }     \
+            static constexpr const char* name() { return #key; }        \
+            static type load(const prefix_cfg_t* cfg)                   \
+            {                                                           \
+                const configurator_multi_t* m =                         \
+                    prefix_config_get_##sec##_##key(cfg);               \
+                return type(configurator_multi_values(m), m->count);    \
+            }                                                           \
+        };                                                              \
+    } }
+
+#define PREFIX_CFG_MULTI_CLI(sec, key, typ, desc, vfn, me, opt, use)    \
+    PREFIX_CFG_MULTI(sec, key, typ, desc, vfn, me)
+
+PREFIX_CONFIGS
+
+#undef PREFIX_CFG
+#undef PREFIX_CFG_CLI
+#undef PREFIX_CFG_MULTI
+#undef PREFIX_CFG_MULTI_CLI
+
+namespace prefix {
+
+    /* owns an initialized configuration (move-only) */
+    class config {
+    public:
+        // lazy selects prefix_config_init_lazy()
+        config(int argc, char** argv, bool lazy = false)
+            : cfg_(new prefix_cfg_t)
+        {
+            // on failure, cfg_ is still finalized by its deleter
+            int rc = lazy ? prefix_config_init_lazy(cfg_.get(), argc, argv)
+                          : prefix_config_init(cfg_.get(), argc, argv);
+            if( rc )
+                throw std::system_error((rc > 0) ? rc : EINVAL,
+                                        std::generic_category(),
+                                        "prefix_config_init");
+        }
+
+        config(config&&) = default;
+        config& operator=(config&&) = default;
+        config(const config&) = delete;
+        config& operator=(const config&) = delete;
+
+        // validated value of option T
+        template <typename T>
+        typename T::type get() const
+        {
+            return T::load(cfg_.get());
+        }
+
+        // update option T at runtime, see prefix_config_set_<sec>_<key>()
+        template <typename T>
+        void set(const char* val)
+        {
+            int rc = T::store(cfg_.get(), val);
+            if( rc )
+                throw std::system_error(rc, std::generic_category(),
+                                        "prefix_config_set");
+        }
+
+        // validate all options not yet accessed, see prefix_config_validate()
+        void validate()
+        {
+            int rc = prefix_config_validate(cfg_.get());
+            if( rc )
+                throw std::system_error(rc, std::generic_category(),
+                                        "prefix_config_validate");
+        }
+
+        // underlying C configuration
+        prefix_cfg_t* c_cfg() { return cfg_.get(); }
+        const prefix_cfg_t* c_cfg() const { return cfg_.get(); }
+
+    private:
+        struct deleter {
+            void operator()(prefix_cfg_t* cfg) const
+            {
+                prefix_config_fini(cfg);
+                delete cfg;
+            }
+        };
+
+        std::unique_ptr<prefix_cfg_t, deleter> cfg_;
+    };
+
+} // namespace prefix
+
+#endif /* _PREFIX_CONFIGURATOR_HPP_ */
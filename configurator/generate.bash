@@ -30,7 +30,9 @@ sdir=$(dirname $0)
 doth=$sdir/configurator.h
 dotc=$sdir/configurator.c
 [[ -f $doth ]] || file_error $doth
+dothpp=$sdir/configurator.hpp
 [[ -f $dotc ]] || file_error $dotc
+[[ -f $dothpp ]] || file_error $dothpp
 
 # create new files with given prefix, and substituting prefix
 sed_cmd="sed -e s/PREFIX/$upref/g -e s/prefix/$lpref/g"
@@ -42,5 +44,8 @@ $sed_cmd $doth > ./${lpref}_configurator.h || cmd_error $cmd
 cmd="$sed_cmd $dotc > ./${lpref}_configurator.c"
 $sed_cmd $dotc > ./${lpref}_configurator.c || cmd_error $cmd
 
+cmd="$sed_cmd $dothpp > ./${lpref}_configurator.hpp"
+$sed_cmd $dothpp > ./${lpref}_configurator.hpp || cmd_error $cmd
+
 exit 0
 
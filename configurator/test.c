@@ -3,16 +3,110 @@
  *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
  */
 
-#include <string.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "configurator.h"
 
+/* INT expressions with their expected value (rc 0) or error, where those
+   using float steps or operands are evaluated by tinyexpr */
+static const struct {
+    const char* expr;
+    int rc;
+    long val;
+} int_exprs[] = {
+    { "-2^2", 0, 4 },               // unary minus binds tighter than ^
+    { "-(2)^2", 0, 4 },
+    { "-2^3", 0, -8 },
+    { "2^3^2", 0, 64 },             // ^ is left-associative
+    { "2 * -3 ^ 2", 0, 18 },
+    { "6/3", 0, 2 },
+    { "7/2*2", 0, 7 },              // inexact division is left to tinyexpr
+    { "-7/2", 0, -3 },              // then truncated
+    { "2^-1*4", 0, 2 },
+    { "7%3", 0, 1 },                // % has the sign of the dividend
+    { "-7%3", 0, -1 },
+    { "-2^2.0", 0, 4 },             // float operand, left to tinyexpr
+    { "010 + 1", 0, 11 },           // literals are decimal, as in tinyexpr
+    { "0x10 | 1", 0, 17 },
+    { "1/0", EINVAL, 0 },
+    { "1%0", EINVAL, 0 },
+    { "0^-1", EINVAL, 0 },
+    { "1 << 63", ERANGE, 0 },
+    { "1 >> 64", ERANGE, 0 },
+    { "1 << -1", ERANGE, 0 },
+    { "-1 << 1", ERANGE, 0 },
+    { "-9223372036854775808 / -1", ERANGE, 0 },
+    { NULL, 0, 0 }
+};
+
+// subscriber for log.verbosity, counting changes in arg
+static void verbosity_changed(prefix_cfg_t* cfg,
+                              int id,
+                              const char* old_val,
+                              const char* new_val,
+                              void* arg)
+{
+    unsigned* count = (unsigned*) arg;
+
+    printf("TEST: log.verbosity changed from %s to %s\n", old_val, new_val);
+    (*count)++;
+}
+
+// source that takes longer than its timeout
+static int slow_fetch(void* ctx,
+                      const prefix_cfg_option_t* options,
+                      unsigned count,
+                      unsigned timeout_ms,
+                      prefix_cfg_put_fn put,
+                      void* user)
+{
+    struct timespec delay = { 0, 200 * 1000 * 1000 };
+
+    nanosleep(&delay, NULL);
+    put(user, "test", "pi", "4");
+    return 0;
+}
+
+// put function counting the values a source provides
+static int count_put(void* user,
+                     const char* section,
+                     const char* key,
+                     const char* val)
+{
+    (*(unsigned*) user)++;
+    return 1;
+}
+
 int main(int argc, char* argv[])
 {
-    int rc;
+    int rc = 0;
     long l;
     double d;
+    bool attached = false;
+    unsigned updates = 0;
+    const char* shm_name;
+    int changed[PREFIX_CFG_NUM_OPTIONS];
+    char small[16];
+    char* out;
+    char* exp;
+    size_t len;
+    size_t explen;
+    const prefix_cfg_option_t* opt;
+    const configurator_rangelist_t* cpus;
+    unsigned u;
+    long cpu, sum;
+    unsigned long bits[1];
+    char kvpath[64];
+    char* cli_argv[3];
+    FILE* kv;
+    prefix_cfg_source_t kvsrc;
+    prefix_cfg_source_t slowsrc = { "slow", PREFIX_CFG_SOURCE_CLI, 20, false, NULL, slow_fetch };
+    prefix_cfg_t srccfg;
     prefix_cfg_t mycfg;
 
     if( argc == 1 ) {
@@ -20,14 +114,33 @@ int main(int argc, char* argv[])
         return 1;
     }
     
+    // set TEST_CACHE_DIR to exercise initialization from snapshots,
+    // TEST_LAZY to exercise on-first-use validation, or TEST_SHM_NAME to
+    // attach to (or else publish) a shared-memory config
     printf("TEST: initializing config\n");
-    rc = prefix_config_init(&mycfg, argc, argv);
+    shm_name = getenv("TEST_SHM_NAME");
+    if( (NULL != shm_name) && (0 == prefix_config_attach(&mycfg, shm_name)) ) {
+        printf("TEST: attached to shared config %s\n", shm_name);
+        attached = true;
+    }
+    else if( NULL != getenv("TEST_LAZY") )
+        rc = prefix_config_init_lazy(&mycfg, argc, argv);
+    else
+        rc = prefix_config_init_cached(&mycfg, argc, argv, getenv("TEST_CACHE_DIR"));
     if( rc ) {
         fprintf(stderr, "prefix_config_init() failed - rc=%d (%s)\n",
                 rc, strerror(rc));
         return 1;
     }
 
+    if( (NULL != shm_name) && (! attached) ) {
+        rc = prefix_config_publish(&mycfg, shm_name);
+        if( rc )
+            printf("TEST FAILURE: publish shared config (rc=%d)\n", rc);
+        else
+            printf("TEST SUCCESS: published shared config %s\n", shm_name);
+    }
+
     printf("TEST: printing human format to stdout\n");
     printf("========\n");
     prefix_config_print(&mycfg, stdout);
@@ -62,6 +175,349 @@ int main(int argc, char* argv[])
     else
         printf("TEST FAILURE: test_floatexpr (cfg=%s)\n", mycfg.test_floatexpr);
 
+    if( 0 == configurator_size_val(mycfg.test_size, &l) )
+        printf("TEST SUCCESS: test_size = %ld\n", l);
+    else
+        printf("TEST FAILURE: test_size (cfg=%s)\n", mycfg.test_size);
+
+    if( 0 == configurator_duration_val(mycfg.test_timeout, &l) )
+        printf("TEST SUCCESS: test_timeout = %ld\n", l);
+    else
+        printf("TEST FAILURE: test_timeout (cfg=%s)\n", mycfg.test_timeout);
+
+    switch( prefix_config_get_test_errcode(&mycfg) ) {
+    case TESTENUM_ENUM_NYI:
+        printf("TEST SUCCESS: test_errcode = NYI\n");
+        break;
+    default:
+        printf("TEST FAILURE: test_errcode (cfg=%s)\n", mycfg.test_errcode);
+        break;
+    }
+
+    // ENUM options have a lookup function rather than a validate function
+    if( (NULL == prefix_cfg_options[PREFIX_CFG_ID_test_errcode].validate)
+        && (testenum_enum_lookup == prefix_cfg_options[PREFIX_CFG_ID_test_errcode].enum_lookup) )
+        printf("TEST SUCCESS: test_errcode descriptor\n");
+    else
+        printf("TEST FAILURE: test_errcode descriptor\n");
+
+    printf("TEST: validating all options\n");
+    if( 0 == prefix_config_validate(&mycfg) )
+        printf("TEST SUCCESS: validated all options\n");
+    else
+        printf("TEST FAILURE: validation of all options\n");
+
+    printf("TEST: runtime update of log.verbosity\n");
+    prefix_config_subscribe(&mycfg, PREFIX_CFG_ID_log_verbosity,
+                            verbosity_changed, &updates);
+    if( (0 == prefix_config_set_log_verbosity(&mycfg, "2 * 3"))
+        && (6 == prefix_config_get_log_verbosity(&mycfg)) )
+        printf("TEST SUCCESS: log_verbosity = %ld\n",
+               prefix_config_get_log_verbosity(&mycfg));
+    else
+        printf("TEST FAILURE: log_verbosity (cfg=%s)\n", mycfg.log_verbosity);
+
+    // setting an equal value is not a change
+    prefix_config_set_log_verbosity(&mycfg, "0x6");
+    if( 1 == updates )
+        printf("TEST SUCCESS: log_verbosity subscriber called once\n");
+    else
+        printf("TEST FAILURE: log_verbosity subscriber called %u times\n", updates);
+
+    // each value records where it came from
+    if( (PREFIX_CFG_ORIGIN_RUNTIME == prefix_config_origin(&mycfg, PREFIX_CFG_ID_log_verbosity))
+        && (PREFIX_CFG_ORIGIN_DEFAULT == prefix_config_origin(&mycfg, PREFIX_CFG_ID_test_pi))
+        && (PREFIX_CFG_ORIGIN_UNSET == prefix_config_origin(&mycfg, PREFIX_CFG_ID_test_nullstring))
+        && (0 == strcmp("runtime", prefix_config_origin_name(PREFIX_CFG_ORIGIN_RUNTIME))) )
+        printf("TEST SUCCESS: option origins\n");
+    else
+        printf("TEST FAILURE: option origins (verbosity from %s)\n",
+               prefix_config_origin_name(prefix_config_origin(&mycfg, PREFIX_CFG_ID_log_verbosity)));
+
+    // a reload keeps runtime updates
+    if( (0 == prefix_config_init(&srccfg, argc, argv))
+        && (0 == prefix_config_apply(&mycfg, &srccfg))
+        && (6 == prefix_config_get_log_verbosity(&mycfg)) && (1 == updates) )
+        printf("TEST SUCCESS: reload kept runtime log_verbosity\n");
+    else
+        printf("TEST FAILURE: reload replaced log_verbosity (cfg=%s)\n", mycfg.log_verbosity);
+    prefix_config_fini(&srccfg);
+
+    if( 0 == prefix_config_diff(&mycfg, &mycfg, changed) )
+        printf("TEST SUCCESS: no differences from self\n");
+    else
+        printf("TEST FAILURE: differences from self\n");
+
+    // a NaN is no different from itself
+    if( (0 == prefix_config_set_test_pi(&mycfg, "nan"))
+        && (0 == prefix_config_diff(&mycfg, &mycfg, changed)) )
+        printf("TEST SUCCESS: no differences from self with NaN test_pi\n");
+    else
+        printf("TEST FAILURE: NaN test_pi differs from itself\n");
+    prefix_config_set_test_pi(&mycfg, "3.141592");
+
+    // profiling is requested as the CLI parser sees it
+    cli_argv[0] = argv[0];
+    cli_argv[1] = (char*) "-l";
+    cli_argv[2] = (char*) "-P";
+    rc = prefix_config_init(&srccfg, 3, cli_argv);
+    if( (0 == rc) && (NULL == srccfg._profile)
+        && (0 == strcmp("-P", prefix_config_get_log_file(&srccfg))) )
+        printf("TEST SUCCESS: -P as a log_file value is not profiling\n");
+    else
+        printf("TEST FAILURE: -P as a log_file value (rc=%d)\n", rc);
+    prefix_config_fini(&srccfg);
+    cli_argv[1] = (char*) "--prefix-prof";
+    rc = prefix_config_init(&srccfg, 2, cli_argv);
+    if( (0 == rc) && (NULL != srccfg._profile) )
+        printf("TEST SUCCESS: abbreviated --prefix-profile enables profiling\n");
+    else
+        printf("TEST FAILURE: abbreviated --prefix-profile (rc=%d)\n", rc);
+    prefix_config_fini(&srccfg);
+
+    if( (0 == prefix_config_set_test_timeout(&mycfg, "2.5 s"))
+        && (2500000000L == prefix_config_get_test_timeout(&mycfg)) )
+        printf("TEST SUCCESS: test_timeout = %ld\n",
+               prefix_config_get_test_timeout(&mycfg));
+    else
+        printf("TEST FAILURE: test_timeout (cfg=%s)\n", mycfg.test_timeout);
+
+    if( (0 == prefix_config_set_test_errcode(&mycfg, "BAD_PARAM"))
+        && (TESTENUM_ENUM_BAD_PARAM == prefix_config_get_test_errcode(&mycfg)) )
+        printf("TEST SUCCESS: test_errcode = BAD_PARAM\n");
+    else
+        printf("TEST FAILURE: test_errcode (cfg=%s)\n", mycfg.test_errcode);
+
+    if( 0 != prefix_config_set_test_errcode(&mycfg, "bad_param") )
+        printf("TEST SUCCESS: rejected invalid test_errcode\n");
+    else
+        printf("TEST FAILURE: accepted invalid test_errcode\n");
+
+    if( 0 != prefix_config_set_test_size(&mycfg, "4 parsecs") )
+        printf("TEST SUCCESS: rejected invalid test_size\n");
+    else
+        printf("TEST FAILURE: accepted invalid test_size\n");
+
+    // INT expressions are exact beyond 2^53, and overflow is an error
+    if( (0 == prefix_config_set_test_maxint(&mycfg, "(1 << 62) + ((1 << 62) - 1)"))
+        && (LONG_MAX == prefix_config_get_test_maxint(&mycfg))
+        && (0 == prefix_config_set_test_intref(&mycfg, "max(9007199254740993 & ~0, 3 * GiB)"))
+        && (9007199254740993L == prefix_config_get_test_intref(&mycfg)) )
+        printf("TEST SUCCESS: test_maxint = %s\n", mycfg.test_maxint);
+    else
+        printf("TEST FAILURE: integer expressions (cfg=%s, %s)\n",
+               mycfg.test_maxint, mycfg.test_intref);
+
+    if( ERANGE == prefix_config_set_test_maxint(&mycfg, "${test.maxint} + 1") )
+        printf("TEST SUCCESS: rejected overflowing test_maxint\n");
+    else
+        printf("TEST FAILURE: accepted overflowing test_maxint\n");
+
+    for( u=0; NULL != int_exprs[u].expr; u++ ) {
+        l = 0;
+        rc = configurator_int_val(int_exprs[u].expr, &l);
+        if( (rc != int_exprs[u].rc) || ((0 == rc) && (l != int_exprs[u].val)) )
+            break;
+    }
+    if( NULL == int_exprs[u].expr )
+        printf("TEST SUCCESS: %u integer expression semantics\n", u);
+    else
+        printf("TEST FAILURE: integer expression '%s' (rc=%d, value %ld)\n",
+               int_exprs[u].expr, rc, l);
+
+    printf("TEST: range list expansion\n");
+    if( (0 == prefix_config_set_test_cpus(&mycfg, " 8-11, 0-3:2,2"))
+        && (0 == strcmp(mycfg.test_cpus, "0,2,8-11")) ) {
+        cpus = prefix_config_get_test_cpus(&mycfg);
+        sum = 0;
+        u = 0;
+        cpu = -1;
+        while( configurator_rangelist_next(cpus, &u, &cpu) )
+            sum += cpu;
+        if( (6 == configurator_rangelist_count(cpus)) && (40 == sum)
+            && configurator_rangelist_contains(cpus, 9)
+            && !configurator_rangelist_contains(cpus, 1)
+            && !configurator_rangelist_contains(cpus, 12)
+            && (ERANGE == configurator_rangelist_bitmap(cpus, bits, 10))
+            && (0x305UL == bits[0]) )
+            printf("TEST SUCCESS: test_cpus = %s\n", mycfg.test_cpus);
+        else
+            printf("TEST FAILURE: test_cpus expansion of %s\n", mycfg.test_cpus);
+    }
+    else
+        printf("TEST FAILURE: test_cpus (cfg=%s)\n", mycfg.test_cpus);
+
+    if( (0 != prefix_config_set_test_cpus(&mycfg, "3-1"))
+        && (0 != prefix_config_set_test_cpus(&mycfg, "0-3,"))
+        && (0 != prefix_config_set_test_cpus(&mycfg, "0-7:0")) )
+        printf("TEST SUCCESS: rejected invalid test_cpus\n");
+    else
+        printf("TEST FAILURE: accepted invalid test_cpus\n");
+
+    printf("TEST: option lookup\n");
+    opt = prefix_config_lookup("test", "size");
+    if( (NULL != opt)
+        && ((opt - prefix_cfg_options) == PREFIX_CFG_ID_test_size)
+        && (CONFIGURATOR_TYPE_SIZE == opt->type)
+        && (0 == strcmp(opt->default_value, "64KiB"))
+        && (prefix_config_get_test_size(&mycfg)
+            == *(const long*)((const char*)&mycfg + opt->val_offset)) )
+        printf("TEST SUCCESS: found test.size\n");
+    else
+        printf("TEST FAILURE: lookup of test.size\n");
+
+    opt = prefix_config_lookup("test", "dirs");
+    if( (NULL != opt) && opt->multi && (4 == opt->max_entries)
+        && (NULL == prefix_config_lookup("test", "nonesuch"))
+        && (NULL == prefix_config_lookup("log", "size")) )
+        printf("TEST SUCCESS: found test.dirs, not unknown options\n");
+    else
+        printf("TEST FAILURE: lookup of test.dirs or unknown options\n");
+
+    printf("TEST: bulk export\n");
+    len = 0;
+    if( (ERANGE == prefix_config_export(&mycfg, PREFIX_CFG_FORMAT_JSON, NULL, &len))
+        && (0 == prefix_config_export_alloc(&mycfg, PREFIX_CFG_FORMAT_JSON, &out, &explen))
+        && (len == explen) && (len == strlen(out)) ) {
+        exp = (char*) malloc(len + 1);
+        len++;
+        if( (0 == prefix_config_export(&mycfg, PREFIX_CFG_FORMAT_JSON, exp, &len))
+            && (0 == strcmp(exp, out))
+            && (NULL != strstr(out, "\"errcode\": \"BAD_PARAM\""))
+            && (NULL != strstr(out, "\"timeout\": 2500000000")) )
+            printf("TEST SUCCESS: JSON export (%zu bytes)\n", explen);
+        else
+            printf("TEST FAILURE: JSON export\n%s", out);
+        free(exp);
+        free(out);
+    }
+    else
+        printf("TEST FAILURE: JSON export size query\n");
+
+    len = sizeof(small);
+    if( (ERANGE == prefix_config_export(&mycfg, PREFIX_CFG_FORMAT_INI, small, &len))
+        && (len >= sizeof(small)) && (strlen(small) == (sizeof(small) - 1)) )
+        printf("TEST SUCCESS: INI export truncated to %zu bytes\n", strlen(small));
+    else
+        printf("TEST FAILURE: INI export truncation\n");
+
+    prefix_config_set_test_nullstring(&mycfg, "it's \"quoted\"");
+    if( 0 == prefix_config_export_alloc(&mycfg, PREFIX_CFG_FORMAT_ENV, &out, NULL) ) {
+        if( NULL != strstr(out, "PREFIX_TEST_NULLSTRING='it'\\''s \"quoted\"'\n") )
+            printf("TEST SUCCESS: ENV export quoting\n");
+        else
+            printf("TEST FAILURE: ENV export quoting\n%s", out);
+        free(out);
+    }
+    else
+        printf("TEST FAILURE: ENV export\n");
+
+    if( 0 == prefix_config_export_alloc(&mycfg, PREFIX_CFG_FORMAT_JSON, &out, NULL) ) {
+        if( NULL != strstr(out, "\"nullstring\": \"it's \\\"quoted\\\"\"") )
+            printf("TEST SUCCESS: JSON export escaping\n");
+        else
+            printf("TEST FAILURE: JSON export escaping\n%s", out);
+        free(out);
+    }
+    else
+        printf("TEST FAILURE: JSON export\n");
+
+    // a quoted null is a string, not a missing value
+    snprintf(kvpath, sizeof(kvpath), "/tmp/prefix-test-%d.json", (int) getpid());
+    kv = fopen(kvpath, "w");
+    if( NULL != kv ) {
+        fprintf(kv, "{ \"test\": { \"nullstring\": \"null\", \"intref\": null } }\n");
+        fclose(kv);
+    }
+    memset((void*)&srccfg, 0, sizeof(srccfg));
+    if( (0 == prefix_config_set_defaults(&srccfg))
+        && (0 == prefix_config_process_file(&srccfg, kvpath))
+        && (NULL != srccfg.test_nullstring) && (0 == strcmp("null", srccfg.test_nullstring))
+        && (0 == strcmp("0", srccfg.test_intref)) )
+        printf("TEST SUCCESS: JSON quoted null is a string\n");
+    else
+        printf("TEST FAILURE: JSON quoted null (cfg=%s)\n", srccfg.test_nullstring);
+    prefix_config_fini(&srccfg);
+    unlink(kvpath);
+
+    snprintf(kvpath, sizeof(kvpath), "/tmp/prefix-test-%d.yaml", (int) getpid());
+    kv = fopen(kvpath, "w");
+    if( NULL != kv ) {
+        fprintf(kv, "test:\n  nullstring: '~'\n  intref: null\n");
+        fclose(kv);
+    }
+    memset((void*)&srccfg, 0, sizeof(srccfg));
+    if( (0 == prefix_config_set_defaults(&srccfg))
+        && (0 == prefix_config_process_file(&srccfg, kvpath))
+        && (NULL != srccfg.test_nullstring) && (0 == strcmp("~", srccfg.test_nullstring))
+        && (0 == strcmp("0", srccfg.test_intref)) )
+        printf("TEST SUCCESS: YAML quoted null is a string\n");
+    else
+        printf("TEST FAILURE: YAML quoted null (cfg=%s)\n", srccfg.test_nullstring);
+    prefix_config_fini(&srccfg);
+    unlink(kvpath);
+
+    if( 0 != prefix_config_set_prefix_debug(&mycfg, "maybe") )
+        printf("TEST SUCCESS: rejected invalid prefix_debug\n");
+    else
+        printf("TEST FAILURE: accepted invalid prefix_debug\n");
+    prefix_config_reclaim(&mycfg);
+
+    printf("TEST: configuration sources\n");
+    snprintf(kvpath, sizeof(kvpath), "/tmp/prefix-test-%d.kv", (int) getpid());
+    kv = fopen(kvpath, "w");
+    if( NULL != kv ) {
+        fprintf(kv, "# stand-in for a key-value service\n"
+                    "test.timeout = 3s\n"
+                    "test.multi = 7\n"
+                    "no.such = option\n");
+        fclose(kv);
+    }
+    if( (0 == prefix_config_source_file(&kvsrc, kvpath, PREFIX_CFG_SOURCE_SYSFILE))
+        && (0 == prefix_config_add_source(&kvsrc))
+        && (0 == prefix_config_add_source(&slowsrc)) ) {
+        rc = prefix_config_init(&srccfg, argc, argv);
+        if( (0 == rc)
+            && (3000000000L == prefix_config_get_test_timeout(&srccfg))
+            && (1 <= srccfg.test_multi.count)
+            && (0 == strcmp("7", configurator_multi_get(&srccfg.test_multi, 0)))
+            && (4.0 != prefix_config_get_test_pi(&srccfg))
+            && (PREFIX_CFG_ORIGIN_SYSFILE == prefix_config_origin(&srccfg, PREFIX_CFG_ID_test_timeout)) )
+            printf("TEST SUCCESS: merged file source, skipped slow source\n");
+        else
+            printf("TEST FAILURE: sources (rc=%d)\n", rc);
+        prefix_config_fini(&srccfg);
+
+        // the file source only puts the options it is asked for
+        u = 0;
+        rc = kvsrc.fetch(kvsrc.ctx, prefix_cfg_options + PREFIX_CFG_ID_test_timeout, 1,
+                         1000, count_put, &u);
+        if( (0 == rc) && (1 == u) )
+            printf("TEST SUCCESS: file source put only requested options\n");
+        else
+            printf("TEST FAILURE: file source put %u values (rc=%d)\n", u, rc);
+
+        // source values go through the usual validation
+        kv = fopen(kvpath, "a");
+        if( NULL != kv ) {
+            fprintf(kv, "test.cpus = lots\n");
+            fclose(kv);
+        }
+        rc = prefix_config_init(&srccfg, argc, argv);
+        if( EINVAL == rc )
+            printf("TEST SUCCESS: rejected invalid source value\n");
+        else
+            printf("TEST FAILURE: accepted invalid source value (rc=%d)\n", rc);
+        prefix_config_fini(&srccfg);
+        rc = 0;
+    }
+    else
+        printf("TEST FAILURE: adding sources\n");
+    prefix_config_remove_source("slow");
+    prefix_config_remove_source(kvpath);
+    prefix_config_source_file_fini(&kvsrc);
+    unlink(kvpath);
+
     printf("TEST: finalizing config\n");
     rc = prefix_config_fini(&mycfg);
     if( rc ) {
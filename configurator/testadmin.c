@@ -0,0 +1,180 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
+ */
+
+/* admin socket test: the parent process serves its config on an admin
+   socket, while reclaiming retired strings as a worker would, and a forked
+   client drives get/set/origin/list/dump requests against it. The parent then
+   checks that the client's update reached its config and subscribers. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "configurator.h"
+
+#define TEST_RATE 50    // requests per second
+
+static int failures;
+
+static void check(const char* what,
+                  int rc,
+                  int expected_rc,
+                  const char* reply,
+                  const char* expected)
+{
+    if( (rc == expected_rc)
+        && ((NULL == expected) || ((NULL != reply) && (NULL != strstr(reply, expected)))) ) {
+        printf("TEST SUCCESS: %s\n", what);
+        return;
+    }
+    printf("TEST FAILURE: %s (rc=%d, reply '%s')\n",
+           what, rc, (NULL != reply) ? reply : "");
+    failures++;
+}
+
+static void query(const char* path,
+                  const char* request,
+                  int expected_rc,
+                  const char* expected)
+{
+    int rc;
+    char* reply = NULL;
+    size_t len = 0;
+
+    rc = prefix_config_admin_query(path, request, &reply, &len);
+    check(request, rc, expected_rc, reply, expected);
+    free(reply);
+}
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int client(const char* path,
+                  long verbosity)
+{
+    char expected[64];
+    unsigned long long start;
+    unsigned long long elapsed;
+
+    start = now_ns();
+    snprintf(expected, sizeof(expected), "%ld\n", verbosity);
+    query(path, "get log.verbosity", 0, expected);
+    query(path, "set log.verbosity 0x7", 0, NULL);
+    query(path, "get log.verbosity", 0, "0x7\n");
+    query(path, "origin log.verbosity", 0, "runtime\n");
+    query(path, "origin test.errcode", 0, "default\n");
+    query(path, "set log.verbosity not-a-number", EINVAL, NULL);
+    query(path, "set test.multi 1", EINVAL, NULL);
+    query(path, "get test.errcode", 0, "NYI\n");
+    query(path, "get no.such", ENOENT, "unknown option");
+    query(path, "reload", ENOSYS, "unknown request");
+    query(path, "list log", 0, "log.verbosity INT log verbosity level\n");
+    query(path, "list test", 0, "test.dirs STRING[4] ");
+    query(path, "dump json", 0, "\"verbosity\": 7");
+    query(path, "dump env", 0, "PREFIX_LOG_VERBOSITY='0x7'\n");
+    query(path, "dump xml", EINVAL, NULL);
+    elapsed = now_ns() - start;
+
+    // the 13 requests above are spaced at least 1/TEST_RATE seconds apart
+    if( elapsed < (12ULL * 1000000000ULL / TEST_RATE) ) {
+        printf("TEST FAILURE: requests not rate-limited (%llu ns)\n", elapsed);
+        failures++;
+    }
+    else
+        printf("TEST SUCCESS: requests rate-limited (%llu ns)\n", elapsed);
+
+    return failures ? 1 : 0;
+}
+
+static void verbosity_changed(prefix_cfg_t* cfg,
+                              int id,
+                              const char* old_val,
+                              const char* new_val,
+                              void* arg)
+{
+    (*(int*)arg)++;
+}
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    int status;
+    int changes = 0;
+    long verbosity;
+    pid_t pid;
+    char path[64];
+    prefix_cfg_t mycfg;
+    struct timespec delay = { 0, 1000 * 1000 };
+
+    snprintf(path, sizeof(path), "/tmp/prefix-testadmin-%d.sock", (int) getpid());
+
+    printf("TEST: initializing config\n");
+    rc = prefix_config_init(&mycfg, argc, argv);
+    if( rc ) {
+        printf("TEST FAILURE: init (rc=%d)\n", rc);
+        prefix_config_fini(&mycfg);
+        return 1;
+    }
+    verbosity = prefix_config_get_log_verbosity(&mycfg);
+    prefix_config_subscribe(&mycfg, PREFIX_CFG_ID_log_verbosity,
+                            verbosity_changed, &changes);
+
+    printf("TEST: starting admin socket\n");
+    rc = prefix_config_admin_start(&mycfg, path, TEST_RATE);
+    if( rc ) {
+        printf("TEST FAILURE: admin start (rc=%d)\n", rc);
+        prefix_config_fini(&mycfg);
+        return 1;
+    }
+    if( EBUSY != prefix_config_admin_start(&mycfg, path, TEST_RATE) ) {
+        printf("TEST FAILURE: started a second admin socket\n");
+        failures++;
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if( 0 == pid )
+        exit(client(path, verbosity));
+
+    // keep reading and reclaiming while the client updates the config
+    while( (pid > 0) && (0 == waitpid(pid, &status, WNOHANG)) ) {
+        (void) prefix_config_get_log_verbosity(&mycfg);
+        prefix_config_reclaim(&mycfg);
+        nanosleep(&delay, NULL);
+    }
+    if( (pid < 0) || (! WIFEXITED(status)) || (0 != WEXITSTATUS(status)) ) {
+        printf("TEST FAILURE: admin client failed\n");
+        failures++;
+    }
+
+    verbosity = prefix_config_get_log_verbosity(&mycfg);
+    if( (7 == verbosity) && (1 == changes) )
+        printf("TEST SUCCESS: log.verbosity = %ld, updated once\n", verbosity);
+    else {
+        printf("TEST FAILURE: log.verbosity = %ld, updated %d times\n",
+               verbosity, changes);
+        failures++;
+    }
+
+    rc = prefix_config_admin_stop(&mycfg);
+    if( rc || (0 == access(path, F_OK)) ) {
+        printf("TEST FAILURE: admin stop (rc=%d)\n", rc);
+        failures++;
+    }
+    else
+        printf("TEST SUCCESS: admin socket stopped\n");
+
+    prefix_config_fini(&mycfg);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
+ */
+
+/* batch initialization test: initializes a config per tenant on a thread
+   pool, each with its own arguments (one of them invalid), then checks
+   every config against a serial initialization from the same arguments.
+   Built with ThreadSanitizer as Configurator_batch_tsan, when available. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configurator.h"
+
+#define TEST_TENANTS 64
+#define TEST_THREADS 8
+#define TEST_BAD_TENANT 13    // gives an invalid prefix.debug
+#define TEST_MAX_ARGS 64
+
+typedef struct {
+    char verbosity[32];
+    char* argv[TEST_MAX_ARGS];
+    int argc;
+} tenant_args_t;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    int i, t;
+    int failed = 0;
+    unsigned diffs;
+    int changed[PREFIX_CFG_NUM_OPTIONS];
+    prefix_cfg_t local;
+    tenant_args_t* args;
+    prefix_cfg_t* cfgs;
+    prefix_cfg_init_t inits[TEST_TENANTS];
+
+    if( argc > (TEST_MAX_ARGS - 4) ) {
+        printf("TEST FAILURE: too many arguments\n");
+        return 1;
+    }
+
+    args = (tenant_args_t*) calloc(TEST_TENANTS, sizeof(tenant_args_t));
+    cfgs = (prefix_cfg_t*) calloc(TEST_TENANTS, sizeof(prefix_cfg_t));
+    if( (NULL == args) || (NULL == cfgs) ) {
+        printf("TEST FAILURE: out of memory\n");
+        return 1;
+    }
+
+    // each tenant gets the test's arguments, then its own (non-default) verbosity
+    for( t=0; t < TEST_TENANTS; t++ ) {
+        for( i=0; i < argc; i++ )
+            args[t].argv[i] = argv[i];
+        snprintf(args[t].verbosity, sizeof(args[t].verbosity), "%d", t + 1);
+        args[t].argv[i++] = (char*) "-v";
+        args[t].argv[i++] = args[t].verbosity;
+        if( TEST_BAD_TENANT == t )
+            args[t].argv[i++] = (char*) "--prefix-debug=maybe";
+        args[t].argc = i;
+
+        inits[t].cfg = cfgs + t;
+        inits[t].argc = args[t].argc;
+        inits[t].argv = args[t].argv;
+        inits[t].rc = 0;
+    }
+
+    printf("TEST: initializing %d configs on %d threads\n", TEST_TENANTS, TEST_THREADS);
+    rc = prefix_config_init_batch(inits, TEST_TENANTS, TEST_THREADS);
+    if( (0 != rc) && (rc == inits[TEST_BAD_TENANT].rc) )
+        printf("TEST SUCCESS: batch reported the invalid tenant (rc=%d)\n", rc);
+    else {
+        printf("TEST FAILURE: batch returned rc=%d\n", rc);
+        failed++;
+    }
+
+    for( t=0; t < TEST_TENANTS; t++ ) {
+        if( TEST_BAD_TENANT == t ) {
+            prefix_config_fini(cfgs + t);
+            continue;
+        }
+        if( inits[t].rc ) {
+            printf("TEST FAILURE: tenant %d init (rc=%d)\n", t, inits[t].rc);
+            failed++;
+        }
+        else if( (t + 1) != prefix_config_get_log_verbosity(cfgs + t) ) {
+            printf("TEST FAILURE: tenant %d log.verbosity = %ld\n",
+                   t, prefix_config_get_log_verbosity(cfgs + t));
+            failed++;
+        }
+        else if( 0 == prefix_config_init(&local, args[t].argc, args[t].argv) ) {
+            diffs = prefix_config_diff(cfgs + t, &local, changed);
+            if( diffs ) {
+                printf("TEST FAILURE: tenant %d differs from serial init in %u options\n",
+                       t, diffs);
+                failed++;
+            }
+            prefix_config_fini(&local);
+        }
+        prefix_config_fini(cfgs + t);
+    }
+    if( 0 == failed )
+        printf("TEST SUCCESS: %d tenant configs match serial initialization\n",
+               TEST_TENANTS - 1);
+
+    free(cfgs);
+    free(args);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*  Copyright (c) 2018 - Michael J. Brim
+ *
+ *  See https://github.com/MichaelBrim/tedium/blob/master/LICENSE for licensing
+ */
+
+/* collective initialization test: the parent process leads a group of
+   forked followers over the local transport. The first follower sets its
+   own log.file, and so must overlay it on the leader's config; the
+   second names its own config file, which it must read; the third sets
+   log.verbosity, which a config file given to the leader overrides. All
+   must match a normal initialization. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "configurator.h"
+
+#define TEST_FOLLOWERS 4
+
+static int follower(int rank,
+                    const char* path,
+                    int argc,
+                    char* argv[])
+{
+    int rc;
+    long l;
+    unsigned diffs;
+    int changed[PREFIX_CFG_NUM_OPTIONS];
+    char cfgpath[64];
+    char* args[4];
+    FILE* fp;
+    prefix_cfg_t mycfg;
+    prefix_cfg_t local;
+    prefix_cfg_transport_t tp;
+
+    if( 0 == rank )
+        setenv("PREFIX_LOG_FILE", "follower.log", 1);
+    else if( 1 == rank ) {
+        snprintf(cfgpath, sizeof(cfgpath), "%s.cfg", path);
+        fp = fopen(cfgpath, "w");
+        if( NULL == fp ) {
+            printf("TEST FAILURE: follower %d config file\n", rank);
+            return 1;
+        }
+        fprintf(fp, "[log]\nverbosity = 77\n");
+        fclose(fp);
+        args[0] = argv[0];
+        args[1] = (char*) "-c";
+        args[2] = cfgpath;
+        args[3] = NULL;
+        argc = 3;
+        argv = args;
+    }
+    else if( 2 == rank )
+        setenv("PREFIX_LOG_VERBOSITY", "42", 1);
+
+    rc = prefix_config_transport_local(&tp, path, false, 0);
+    if( rc ) {
+        printf("TEST FAILURE: follower %d transport (rc=%d)\n", rank, rc);
+        return 1;
+    }
+    rc = prefix_config_init_collective(&mycfg, argc, argv, &tp);
+    prefix_config_transport_local_fini(&tp);
+    if( rc ) {
+        printf("TEST FAILURE: follower %d init (rc=%d)\n", rank, rc);
+        prefix_config_fini(&mycfg);
+        return 1;
+    }
+
+    // followers with their own values also match a local init
+    if( 0 == prefix_config_init(&local, argc, argv) ) {
+        diffs = prefix_config_diff(&mycfg, &local, changed);
+        rc = (0 != diffs);
+        if( 0 == rank ) {
+            rc = rc || (0 != strcmp("follower.log", prefix_config_get_log_file(&mycfg)));
+            printf("TEST %s: follower %d log.file = %s\n",
+                   rc ? "FAILURE" : "SUCCESS", rank, prefix_config_get_log_file(&mycfg));
+        }
+        else if( 1 == rank ) {
+            l = prefix_config_get_log_verbosity(&mycfg);
+            rc = rc || (77 != l);
+            printf("TEST %s: follower %d read its config file (log.verbosity = %ld)\n",
+                   rc ? "FAILURE" : "SUCCESS", rank, l);
+        }
+        if( diffs )
+            printf("TEST FAILURE: follower %d differs in %u options\n", rank, diffs);
+        prefix_config_fini(&local);
+    }
+    if( 1 == rank )
+        unlink(cfgpath);
+
+    prefix_config_fini(&mycfg);
+    return rc;
+}
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    int i;
+    int status;
+    int failed = 0;
+    pid_t pids[TEST_FOLLOWERS];
+    char path[64];
+    prefix_cfg_t mycfg;
+    prefix_cfg_transport_t tp;
+
+    snprintf(path, sizeof(path), "/tmp/prefix-testcoll-%d.sock", (int) getpid());
+
+    // the leader must not see the followers' environment
+    unsetenv("PREFIX_LOG_FILE");
+    unsetenv("PREFIX_LOG_VERBOSITY");
+
+    printf("TEST: initializing leader transport\n");
+    rc = prefix_config_transport_local(&tp, path, true, TEST_FOLLOWERS);
+    if( rc ) {
+        printf("TEST FAILURE: leader transport (rc=%d)\n", rc);
+        return 1;
+    }
+
+    fflush(stdout);
+    for( i=0; i < TEST_FOLLOWERS; i++ ) {
+        pids[i] = fork();
+        if( 0 == pids[i] )
+            exit(follower(i, path, argc, argv));
+    }
+
+    printf("TEST: initializing collective config\n");
+    rc = prefix_config_init_collective(&mycfg, argc, argv, &tp);
+    prefix_config_transport_local_fini(&tp);
+    if( rc )
+        printf("TEST FAILURE: leader init (rc=%d)\n", rc);
+    else
+        printf("TEST SUCCESS: leader init\n");
+
+    for( i=0; i < TEST_FOLLOWERS; i++ ) {
+        if( (pids[i] < 0) || (pids[i] != waitpid(pids[i], &status, 0))
+            || (! WIFEXITED(status)) || (0 != WEXITSTATUS(status)) )
+            failed++;
+    }
+    if( failed )
+        printf("TEST FAILURE: %d followers failed\n", failed);
+    else
+        printf("TEST SUCCESS: %d followers initialized\n", TEST_FOLLOWERS);
+
+    prefix_config_fini(&mycfg);
+    return (rc || failed) ? 1 : 0;
+}
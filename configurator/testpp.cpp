@@ -5,68 +5,84 @@
 
 #include <cstring>
 #include <cstdio>
+#include <system_error>
 
-#include "configurator.h"
+#include "configurator.hpp"
+
+// schema defaults are available at compile time
+static_assert(prefix::test::intexpr::default_value() == INT_EXPR,
+              "constexpr INT default");
+static_assert(prefix::test::maxint::default_value() == LONG_MAX,
+              "constexpr INT default");
+static_assert(!prefix::prefix::debug::default_value(),
+              "constexpr BOOL default");
+static_assert(prefix::test::size::default_value() == 64 * 1024,
+              "constexpr SIZE default");
+static_assert(prefix::test::timeout::default_value() == 1500000000L,
+              "constexpr DURATION default");
+static_assert(prefix::detail::str_eq(prefix::test::errcode::default_value(), "NYI"),
+              "constexpr ENUM default");
+static_assert(prefix::detail::str_eq(prefix::test::cpus::default_value(), "0-3"),
+              "constexpr RANGELIST default");
 
 int main(int argc, char* argv[])
 {
-    int rc;
-    long l;
-    double d;
-    prefix_cfg_t mycfg;
-
     if( argc == 1 ) {
         prefix_config_cli_usage(argv[0]);
         return 1;
     }
     
-    printf("TEST: initializing config\n");
-    rc = prefix_config_init(&mycfg, argc, argv);
-    if( rc ) {
-        fprintf(stderr, "prefix_config_init() failed - rc=%d (%s)\n",
-                rc, strerror(rc));
-        return 1;
-    }
+    try {
+        printf("TEST: initializing config\n");
+        prefix::config cfg(argc, argv);
 
-    printf("TEST: printing human format to stdout\n");
-    printf("========\n");
-    prefix_config_print(&mycfg, stdout);
-    printf("========\n\n");
+        printf("TEST: printing human format to stdout\n");
+        printf("========\n");
+        prefix_config_print(cfg.c_cfg(), stdout);
+        printf("========\n\n");
 
-    printf("TEST: printing .ini format to stderr\n");
-    prefix_config_print_ini(&mycfg, stderr);
-    printf("\n\n");
+        printf("TEST: printing .ini format to stderr\n");
+        prefix_config_print_ini(cfg.c_cfg(), stderr);
+        printf("\n\n");
 
-    if( 0 == configurator_int_val(mycfg.test_maxint, &l) )
-        printf("TEST SUCCESS: test_maxint = %ld\n", l);
-    else
-        printf("TEST FAILURE: test_maxint (cfg=%s)\n", mycfg.test_maxint);
+        printf("TEST SUCCESS: test_maxint = %ld\n",
+               cfg.get<prefix::test::maxint>());
+        printf("TEST SUCCESS: test_intexpr = %ld\n",
+               cfg.get<prefix::test::intexpr>());
+        printf("TEST SUCCESS: test_pi = %.6le\n",
+               cfg.get<prefix::test::pi>());
+        printf("TEST SUCCESS: test_exponent = %.6le\n",
+               cfg.get<prefix::test::exponent>());
+        printf("TEST SUCCESS: test_floatexpr = %.6le\n",
+               cfg.get<prefix::test::floatexpr>());
+        printf("TEST SUCCESS: test_size = %ld\n",
+               cfg.get<prefix::test::size>());
+        printf("TEST SUCCESS: test_timeout = %ld\n",
+               cfg.get<prefix::test::timeout>());
+        printf("TEST SUCCESS: test_errcode = %s\n",
+               testenum_enum_str((testenum_e) cfg.get<prefix::test::errcode>()));
+        printf("TEST SUCCESS: test_cpus count = %ld\n",
+               configurator_rangelist_count(cfg.get<prefix::test::cpus>()));
 
-    if( 0 == configurator_int_val(mycfg.test_intexpr, &l) )
-        printf("TEST SUCCESS: test_intexpr = %ld\n", l);
-    else
-        printf("TEST FAILURE: test_intexpr (cfg=%s)\n", mycfg.test_intexpr);
+        prefix::multi_view multi = cfg.get<prefix::test::multi>();
+        for( const char* v : multi )
+            printf("TEST SUCCESS: test_multi value = %s\n", v);
 
-    if( 0 == configurator_float_val(mycfg.test_pi, &d) )
-        printf("TEST SUCCESS: test_pi = %.6le\n", d);
-    else
-        printf("TEST FAILURE: test_pi (cfg=%s)\n", mycfg.test_pi);
+        // moves transfer ownership, the moved-from config is not finalized
+        prefix::config moved(std::move(cfg));
+        printf("TEST: runtime update of log.verbosity\n");
+        moved.set<prefix::log::verbosity>("2 * 3");
+        if( 6 == moved.get<prefix::log::verbosity>() )
+            printf("TEST SUCCESS: log_verbosity = 6\n");
+        else
+            printf("TEST FAILURE: log_verbosity = %ld\n",
+                   moved.get<prefix::log::verbosity>());
 
-    if( 0 == configurator_float_val(mycfg.test_exponent, &d) )
-        printf("TEST SUCCESS: test_exponent = %.6le\n", d);
-    else
-        printf("TEST FAILURE: test_exponent (cfg=%s)\n", mycfg.test_exponent);
-
-    if( 0 == configurator_float_val(mycfg.test_floatexpr, &d) )
-        printf("TEST SUCCESS: test_floatexpr = %.6le\n", d);
-    else
-        printf("TEST FAILURE: test_floatexpr (cfg=%s)\n", mycfg.test_floatexpr);
-
-    printf("TEST: finalizing config\n");
-    rc = prefix_config_fini(&mycfg);
-    if( rc ) {
-        fprintf(stderr, "prefix_config_fini() failed - rc=%d (%s)\n",
-                rc, strerror(rc));
+        printf("TEST: finalizing config\n");
+    }
+    catch( const std::system_error& e ) {
+        fprintf(stderr, "TEST FAILURE: %s - rc=%d (%s)\n",
+                e.what(), e.code().value(), strerror(e.code().value()));
         return 1;
     }
 
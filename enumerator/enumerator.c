@@ -84,3 +84,16 @@ int check_valid_prefix_enum( prefix_e e )
             (NULL != prefix_enum_str(e)));
 }
 
+/* int-valued lookup */
+
+const char* prefix_enum_lookup( const char* name, int* e )
+{
+    if( NULL == e )
+        return NULL;
+    if( NULL != name )
+        *e = (int) prefix_enum_from_str(name);
+    if( (*e <= (int) PREFIX_ENUM_INVALID) || (*e >= (int) PREFIX_ENUM_MAX) )
+        return NULL;
+    return prefix_enum_str((prefix_e) *e);
+}
+
@@ -36,6 +36,12 @@ int check_valid_prefix_enum( prefix_e );
 
 prefix_e prefix_enum_from_str( const char* s );
 
+/* name/value lookup using plain int values (e.g., for configurator ENUM
+   options). For non-NULL name, first sets *e to its value (or to
+   PREFIX_ENUM_INVALID when not found). Returns the name of *e, or NULL
+   when *e is not valid. */
+const char* prefix_enum_lookup( const char* name, int* e );
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
@@ -39,8 +39,9 @@ cmd="$sed_cmd $doth > ./${lpref}_enumerator.h"
 echo "DEBUG: cmd - $cmd"
 $sed_cmd $doth > ./${lpref}_enumerator.h || cmd_error $cmd
 
-cmd="$sed_cmd $dotc > ./${lpref}_enumerator.c"
-$sed_cmd $dotc > ./${lpref}_enumerator.c || cmd_error $cmd
+# the new .c file includes the new .h file
+cmd="$sed_cmd -e s/\"enumerator.h\"/\"${lpref}_enumerator.h\"/ $dotc > ./${lpref}_enumerator.c"
+$sed_cmd -e "s/\"enumerator.h\"/\"${lpref}_enumerator.h\"/" $dotc > ./${lpref}_enumerator.c || cmd_error $cmd
 
 exit 0
 
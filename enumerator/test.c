@@ -12,6 +12,7 @@ int main(int argc, char* argv[])
 {
     prefix_e checkval;
     prefix_e testval;
+    int ival;
     const char* estr;
 
     for( checkval = PREFIX_ENUM_INVALID+1; checkval < PREFIX_ENUM_MAX; checkval++ ) {
@@ -24,11 +25,19 @@ int main(int argc, char* argv[])
             if( checkval != testval ) {
                 printf("\tERROR on reverse lookup from string '%s'\n", estr);
             } 
+            if( (estr != prefix_enum_lookup(estr, &ival)) || (checkval != ival) ) {
+                printf("\tERROR on int lookup from string '%s'\n", estr);
+            }
         }
         else {
             printf("NOT DEFINED\n");
         }
     }
 
+    if( (NULL != prefix_enum_lookup("NOT_AN_ITEM", &ival))
+        || (PREFIX_ENUM_INVALID != ival) ) {
+        printf("ERROR on int lookup of unknown name\n");
+    }
+
     return 0;
 }